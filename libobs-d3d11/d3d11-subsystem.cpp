@@ -1641,6 +1641,27 @@ void gs_texture_unmap(gs_texture_t *tex)
 	tex2d->device->context->Unmap(tex2d->texture, 0);
 }
 
+bool gs_texture_update_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize)
+{
+	if (tex->type != GS_TEXTURE_2D)
+		return false;
+
+	gs_texture_2d *tex2d = static_cast<gs_texture_2d*>(tex);
+
+	/* dynamic textures can only be written with a discarding map */
+	if (tex2d->isDynamic)
+		return false;
+	if (x + cx > tex2d->width || y + cy > tex2d->height)
+		return false;
+
+	D3D11_BOX box = {x, y, 0, x + cx, y + cy, 1};
+	tex2d->device->context->UpdateSubresource(tex2d->texture, 0, &box,
+			data, linesize, 0);
+	return true;
+}
+
 void *gs_texture_get_obj(gs_texture_t *tex)
 {
 	if (tex->type != GS_TEXTURE_2D)
@@ -142,6 +142,10 @@ static bool gl_init_extensions(struct gs_device* device)
 	else
 		device->copy_type = COPY_TYPE_FBO_BLIT;
 
+	device->persistent_upload =
+		(GLAD_GL_VERSION_4_4 || GLAD_GL_ARB_buffer_storage) &&
+		(GLAD_GL_VERSION_3_2 || GLAD_GL_ARB_sync);
+
 	return true;
 }
 
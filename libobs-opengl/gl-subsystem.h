@@ -410,6 +410,11 @@ struct gs_texture {
 	gs_samplerstate_t    *cur_sampler;
 };
 
+/* segments of the upload ring of dynamic textures.  a segment is only
+ * written again after the uploads of the other segments were queued, so
+ * waiting on its fence practically never blocks */
+#define GL_UPLOAD_RING_SIZE 3
+
 struct gs_texture_2d {
 	struct gs_texture    base;
 
@@ -417,6 +422,15 @@ struct gs_texture_2d {
 	uint32_t             height;
 	bool                 gen_mipmaps;
 	GLuint               unpack_buffer;
+	GLsizeiptr           unpack_size;
+
+	/* persistently mapped unpack buffer of GL_UPLOAD_RING_SIZE segments
+	 * of unpack_size bytes, NULL if not supported */
+	uint8_t              *upload_ring;
+	uint32_t             upload_segment;
+	GLsizeiptr           upload_used;
+	GLintptr             map_offset;
+	GLsync               upload_fences[GL_UPLOAD_RING_SIZE];
 };
 
 struct gs_texture_cube {
@@ -476,6 +490,7 @@ static inline void fbo_info_destroy(struct fbo_info *fbo)
 struct gs_device {
 	struct gl_platform   *plat;
 	enum copy_type       copy_type;
+	bool                 persistent_upload;
 
 	gs_texture_t         *cur_render_target;
 	gs_zstencil_t        *cur_zstencil_buffer;
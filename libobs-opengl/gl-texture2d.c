@@ -43,6 +43,26 @@ static bool upload_texture_2d(struct gs_texture_2d *tex, const uint8_t **data)
 	return success;
 }
 
+static bool create_upload_ring(struct gs_texture_2d *tex)
+{
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT |
+		GL_MAP_COHERENT_BIT;
+	GLsizeiptr size = tex->unpack_size * GL_UPLOAD_RING_SIZE;
+
+	glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, NULL, flags);
+	if (!gl_success("glBufferStorage"))
+		return false;
+
+	tex->upload_ring = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+			flags);
+	if (!gl_success("glMapBufferRange") || !tex->upload_ring)
+		return false;
+
+	/* start out "full" so that the first upload takes a fresh segment */
+	tex->upload_used = tex->unpack_size;
+	return true;
+}
+
 static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 {
 	GLsizeiptr size;
@@ -64,9 +84,18 @@ static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 		size /= 8;
 	}
 
-	glBufferData(GL_PIXEL_UNPACK_BUFFER, size, 0, GL_DYNAMIC_DRAW);
-	if (!gl_success("glBufferData"))
-		success = false;
+	/* keeps ring segments aligned for any texel size */
+	tex->unpack_size = (size + 63) & ~(GLsizeiptr)63;
+
+	if (tex->base.device->persistent_upload) {
+		if (!create_upload_ring(tex))
+			success = false;
+	} else {
+		glBufferData(GL_PIXEL_UNPACK_BUFFER, tex->unpack_size, 0,
+				GL_DYNAMIC_DRAW);
+		if (!gl_success("glBufferData"))
+			success = false;
+	}
 
 	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0))
 		success = false;
@@ -74,6 +103,82 @@ static bool create_pixel_unpack_buffer(struct gs_texture_2d *tex)
 	return success;
 }
 
+/* returns space for an upload in the ring, moving on to the next segment
+ * (and waiting for the GPU to be done reading it) if the current one can't
+ * hold it.  offset receives the position in the unpack buffer. */
+static uint8_t *upload_ring_alloc(struct gs_texture_2d *tex, GLsizeiptr size,
+		GLintptr *offset)
+{
+	if (tex->upload_used + size > tex->unpack_size) {
+		uint32_t idx   = (tex->upload_segment + 1) % GL_UPLOAD_RING_SIZE;
+		GLsync   fence = tex->upload_fences[idx];
+
+		if (fence) {
+			glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+					1000000000ULL);
+			glDeleteSync(fence);
+			tex->upload_fences[idx] = NULL;
+		}
+
+		tex->upload_segment = idx;
+		tex->upload_used    = 0;
+	}
+
+	*offset = (GLintptr)tex->upload_segment * tex->unpack_size +
+		tex->upload_used;
+	tex->upload_used += (size + 15) & ~(GLsizeiptr)15;
+
+	return tex->upload_ring + *offset;
+}
+
+/* queues the copy from the unpack buffer to the texture, the data has to be
+ * tightly packed rows of row_length pixels */
+static bool upload_ring_submit(struct gs_texture_2d *tex, GLintptr offset,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		uint32_t row_length, GLint alignment)
+{
+	struct gs_texture *base = &tex->base;
+	GLsync *fence = &tex->upload_fences[tex->upload_segment];
+	bool success = true;
+
+	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex->unpack_buffer))
+		return false;
+	if (!gl_bind_texture(base->gl_target, base->texture)) {
+		gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		return false;
+	}
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, row_length);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+
+	glTexSubImage2D(base->gl_target, 0, x, y, cx, cy,
+			base->gl_format, base->gl_type,
+			(const void*)offset);
+	if (!gl_success("glTexSubImage2D"))
+		success = false;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	/* fences signal in order, so the newest one covers every upload
+	 * from this segment */
+	if (*fence)
+		glDeleteSync(*fence);
+	*fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+
+	gl_bind_texture(base->gl_target, 0);
+	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	return success;
+}
+
+static void free_upload_ring(struct gs_texture_2d *tex)
+{
+	for (size_t i = 0; i < GL_UPLOAD_RING_SIZE; i++) {
+		if (tex->upload_fences[i])
+			glDeleteSync(tex->upload_fences[i]);
+	}
+}
+
 gs_texture_t *device_texture_create(gs_device_t *device, uint32_t width,
 		uint32_t height, enum gs_color_format color_format,
 		uint32_t levels, const uint8_t **data, uint32_t flags)
@@ -132,8 +237,10 @@ void gs_texture_destroy(gs_texture_t *tex)
 	if (tex->cur_sampler)
 		gs_samplerstate_destroy(tex->cur_sampler);
 
-	if (!tex->is_dummy && tex->is_dynamic && tex2d->unpack_buffer)
+	if (!tex->is_dummy && tex->is_dynamic && tex2d->unpack_buffer) {
+		free_upload_ring(tex2d);
 		gl_delete_buffers(1, &tex2d->unpack_buffer);
+	}
 
 	if (tex->texture)
 		gl_delete_textures(1, &tex->texture);
@@ -176,17 +283,28 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 		goto fail;
 	}
 
+	*linesize = tex2d->width * gs_get_format_bpp(tex->format) / 8;
+	*linesize = (*linesize + 3) & 0xFFFFFFFC;
+
+	if (tex2d->upload_ring) {
+		*ptr = upload_ring_alloc(tex2d, tex2d->unpack_size,
+				&tex2d->map_offset);
+		return true;
+	}
+
 	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
 		goto fail;
 
+	/* orphan the previous contents so mapping doesn't wait for the last
+	 * upload to finish */
+	glBufferData(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_size, 0,
+			GL_DYNAMIC_DRAW);
+
 	*ptr = glMapBuffer(GL_PIXEL_UNPACK_BUFFER, GL_WRITE_ONLY);
 	if (!gl_success("glMapBuffer"))
 		goto fail;
 
 	gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, 0);
-
-	*linesize = tex2d->width * gs_get_format_bpp(tex->format) / 8;
-	*linesize = (*linesize + 3) & 0xFFFFFFFC;
 	return true;
 
 fail:
@@ -200,6 +318,13 @@ void gs_texture_unmap(gs_texture_t *tex)
 	if (!is_texture_2d(tex, "gs_texture_unmap"))
 		goto failed;
 
+	if (tex2d->upload_ring) {
+		if (!upload_ring_submit(tex2d, tex2d->map_offset, 0, 0,
+					tex2d->width, tex2d->height, 0, 4))
+			goto failed;
+		return;
+	}
+
 	if (!gl_bind_buffer(GL_PIXEL_UNPACK_BUFFER, tex2d->unpack_buffer))
 		goto failed;
 
@@ -226,6 +351,64 @@ failed:
 	blog(LOG_ERROR, "gs_texture_unmap (GL) failed");
 }
 
+bool gs_texture_update_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize)
+{
+	struct gs_texture_2d *tex2d = (struct gs_texture_2d*)tex;
+	uint32_t pixel_size;
+	bool success = true;
+
+	if (!is_texture_2d(tex, "gs_texture_update_region"))
+		return false;
+	if (gs_is_compressed_format(tex->format))
+		return false;
+
+	pixel_size = gs_get_format_bpp(tex->format) / 8;
+	if (!pixel_size || (linesize % pixel_size) != 0)
+		return false;
+	if (x + cx > tex2d->width || y + cy > tex2d->height)
+		return false;
+
+	if (tex2d->upload_ring) {
+		size_t   row_size = (size_t)cx * pixel_size;
+		GLintptr offset;
+		uint8_t  *ptr;
+
+		ptr = upload_ring_alloc(tex2d, (GLsizeiptr)(row_size * cy),
+				&offset);
+		for (uint32_t row = 0; row < cy; row++)
+			memcpy(ptr + row * row_size, data + row * linesize,
+					row_size);
+
+		success = upload_ring_submit(tex2d, offset, x, y, cx, cy,
+				cx, 1);
+		if (!success)
+			blog(LOG_ERROR, "gs_texture_update_region (GL) failed");
+		return success;
+	}
+
+	if (!gl_bind_texture(tex->gl_target, tex->texture))
+		return false;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / pixel_size);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexSubImage2D(tex->gl_target, 0, x, y, cx, cy,
+			tex->gl_format, tex->gl_type, data);
+	if (!gl_success("glTexSubImage2D"))
+		success = false;
+
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+	gl_bind_texture(tex->gl_target, 0);
+
+	if (!success)
+		blog(LOG_ERROR, "gs_texture_update_region (GL) failed");
+	return success;
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	const struct gs_texture_2d *tex2d = (const struct gs_texture_2d*)tex;
@@ -30,8 +30,11 @@ void gs_effect_actually_destroy(gs_effect_t *effect)
 void gs_effect_destroy(gs_effect_t *effect)
 {
 	if (effect) {
-		if (!effect->effect_path)
+		if (!effect->effect_path) {
+			if (effect->graphics->sprite_batch.effect == effect)
+				flush_sprites(effect->graphics);
 			gs_effect_actually_destroy(effect);
+		}
 	}
 }
 
@@ -98,8 +101,14 @@ bool gs_effect_loop(gs_effect_t *effect, const char *name)
 
 size_t gs_technique_begin(gs_technique_t *tech)
 {
+	graphics_t *graphics;
+
 	if (!tech) return 0;
 
+	graphics = tech->effect->graphics;
+	if (graphics->sprite_batch.tech != tech)
+		flush_sprites(graphics);
+
 	tech->effect->cur_technique = tech;
 	tech->effect->graphics->cur_effect = tech->effect;
 
@@ -196,6 +205,9 @@ bool gs_technique_begin_pass(gs_technique_t *tech, size_t idx)
 	passes = tech->passes.array;
 	cur_pass = passes+idx;
 
+	if (tech->effect->graphics->sprite_batch.pass != cur_pass)
+		flush_sprites(tech->effect->graphics);
+
 	tech->effect->cur_pass = cur_pass;
 	gs_load_vertexshader(cur_pass->vertshader);
 	gs_load_pixelshader(cur_pass->pixelshader);
@@ -157,6 +157,9 @@ struct gs_exports {
 	bool     (*gs_texture_map)(gs_texture_t *tex, uint8_t **ptr,
 			uint32_t *linesize);
 	void     (*gs_texture_unmap)(gs_texture_t *tex);
+	bool     (*gs_texture_update_region)(gs_texture_t *tex,
+			uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+			const uint8_t *data, uint32_t linesize);
 	bool     (*gs_texture_is_rect)(const gs_texture_t *tex);
 	void    *(*gs_texture_get_obj)(const gs_texture_t *tex);
 
@@ -262,6 +265,58 @@ struct blend_state {
 	enum gs_blend_type dest;
 };
 
+enum gs_pool_type {
+	GS_POOL_TEXTURE,
+	GS_POOL_STAGESURF
+};
+
+struct gs_pool_entry {
+	enum gs_pool_type      type;
+	void                   *object;
+	uint32_t               width;
+	uint32_t               height;
+	enum gs_color_format   format;
+	uint32_t               flags;
+	size_t                 size;
+};
+
+struct gs_resource_pool {
+	/* released objects, least recently released first */
+	DARRAY(struct gs_pool_entry) entries;
+	/* pooled objects currently in use */
+	DARRAY(struct gs_pool_entry) loans;
+	size_t                 size;
+	size_t                 budget;
+};
+
+#define GS_POOL_DEFAULT_BUDGET (128 * 1024 * 1024)
+
+extern void gs_resource_pool_free(graphics_t *graphics);
+
+#define GS_SPRITE_BATCH_MAX 256
+
+struct gs_sprite_batch {
+	gs_vertbuffer_t        *vertbuffer;
+	size_t                 num;
+	long                   depth;
+
+	/* effect state the queued sprites were drawn with */
+	struct gs_effect       *effect;
+	gs_technique_t         *tech;
+	struct gs_effect_pass  *pass;
+	DARRAY(uint8_t)        values;
+	DARRAY(size_t)         sizes;
+
+	/* live parameter values, held while the queue is submitted */
+	DARRAY(struct darray)  saved;
+};
+
+extern bool gs_sprite_batch_init(graphics_t *graphics);
+extern void gs_sprite_batch_free(graphics_t *graphics);
+extern bool gs_sprite_batch_add(graphics_t *graphics,
+		const struct vec3 *points, const struct vec2 *uvs);
+extern void gs_sprite_batch_submit(graphics_t *graphics);
+
 struct graphics_subsystem {
 	void                   *module;
 	gs_device_t            *device;
@@ -276,6 +331,10 @@ struct graphics_subsystem {
 	struct gs_effect       *cur_effect;
 
 	gs_vertbuffer_t        *sprite_buffer;
+	struct gs_sprite_batch sprite_batch;
+
+	gs_vertbuffer_t        *cur_vertbuffer;
+	gs_indexbuffer_t       *cur_indexbuffer;
 
 	bool                   using_immediate;
 	struct gs_vb_data      *vbd;
@@ -293,4 +352,13 @@ struct graphics_subsystem {
 
 	struct blend_state     cur_blend_state;
 	DARRAY(struct blend_state) blend_state_stack;
+
+	struct gs_resource_pool pool;
 };
+
+/* draws any queued sprites before device state they depend on changes */
+static inline void flush_sprites(graphics_t *graphics)
+{
+	if (graphics->sprite_batch.num)
+		gs_sprite_batch_submit(graphics);
+}
@@ -122,6 +122,8 @@ static bool graphics_init(struct graphics_subsystem *graphics)
 		return false;
 	if (!graphics_init_sprite_vb(graphics))
 		return false;
+	if (!gs_sprite_batch_init(graphics))
+		return false;
 	if (pthread_mutex_init(&graphics->mutex, NULL) != 0)
 		return false;
 	if (pthread_mutex_init(&graphics->effect_mutex, NULL) != 0)
@@ -147,6 +149,7 @@ int gs_create(graphics_t **pgraphics, const char *module,
 
 	graphics_t *graphics = bzalloc(sizeof(struct graphics_subsystem));
 	pthread_mutex_init_value(&graphics->mutex);
+	graphics->pool.budget = GS_POOL_DEFAULT_BUDGET;
 
 	if (!new_data.num_backbuffers)
 		new_data.num_backbuffers = 1;
@@ -194,12 +197,15 @@ void gs_destroy(graphics_t *graphics)
 		thread_graphics = graphics;
 		graphics->exports.device_enter_context(graphics->device);
 
+		gs_resource_pool_free(graphics);
+
 		while (effect) {
 			struct gs_effect *next = effect->next;
 			gs_effect_actually_destroy(effect);
 			effect = next;
 		}
 
+		gs_sprite_batch_free(graphics);
 		graphics->exports.gs_vertexbuffer_destroy(
 				graphics->sprite_buffer);
 		graphics->exports.gs_vertexbuffer_destroy(
@@ -246,6 +252,7 @@ void gs_leave_context(void)
 		if (!os_atomic_dec_long(&thread_graphics->ref)) {
 			graphics_t *graphics = thread_graphics;
 
+			flush_sprites(graphics);
 			graphics->exports.device_leave_context(
 					graphics->device);
 			pthread_mutex_unlock(&graphics->mutex);
@@ -807,33 +814,33 @@ static inline void assign_sprite_uv(float *start, float *end, bool flip)
 	}
 }
 
-static void build_sprite(struct gs_vb_data *data, float fcx, float fcy,
+static void build_sprite(struct vec3 *points, struct vec2 *tvarray,
+		float fcx, float fcy,
 		float start_u, float end_u, float start_v, float end_v)
 {
-	struct vec2 *tvarray = data->tvarray[0].array;
-
-	vec3_zero(data->points);
-	vec3_set(data->points+1,  fcx, 0.0f, 0.0f);
-	vec3_set(data->points+2, 0.0f,  fcy, 0.0f);
-	vec3_set(data->points+3,  fcx,  fcy, 0.0f);
+	vec3_zero(points);
+	vec3_set(points+1,  fcx, 0.0f, 0.0f);
+	vec3_set(points+2, 0.0f,  fcy, 0.0f);
+	vec3_set(points+3,  fcx,  fcy, 0.0f);
 	vec2_set(tvarray,   start_u, start_v);
 	vec2_set(tvarray+1, end_u,   start_v);
 	vec2_set(tvarray+2, start_u, end_v);
 	vec2_set(tvarray+3, end_u,   end_v);
 }
 
-static inline void build_sprite_norm(struct gs_vb_data *data, float fcx,
-		float fcy, uint32_t flip)
+static inline void build_sprite_norm(struct vec3 *points,
+		struct vec2 *tvarray, float fcx, float fcy, uint32_t flip)
 {
 	float start_u, end_u;
 	float start_v, end_v;
 
 	assign_sprite_uv(&start_u, &end_u, (flip & GS_FLIP_U) != 0);
 	assign_sprite_uv(&start_v, &end_v, (flip & GS_FLIP_V) != 0);
-	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
+	build_sprite(points, tvarray, fcx, fcy, start_u, end_u, start_v, end_v);
 }
 
-static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
+static inline void build_sprite_rect(struct vec3 *points,
+		struct vec2 *tvarray, gs_texture_t *tex,
 		float fcx, float fcy, uint32_t flip)
 {
 	float start_u, end_u;
@@ -843,7 +850,7 @@ static inline void build_sprite_rect(struct gs_vb_data *data, gs_texture_t *tex,
 
 	assign_sprite_rect(&start_u, &end_u, width,  (flip & GS_FLIP_U) != 0);
 	assign_sprite_rect(&start_v, &end_v, height, (flip & GS_FLIP_V) != 0);
-	build_sprite(data, fcx, fcy, start_u, end_u, start_v, end_v);
+	build_sprite(points, tvarray, fcx, fcy, start_u, end_u, start_v, end_v);
 }
 
 void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
@@ -852,6 +859,8 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	graphics_t *graphics = thread_graphics;
 	float fcx, fcy;
 	struct gs_vb_data *data;
+	struct vec3 points[4];
+	struct vec2 tvarray[4];
 
 	assert(tex);
 	if (!tex || !thread_graphics)
@@ -865,11 +874,17 @@ void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 	fcx = width  ? (float)width  : (float)gs_texture_get_width(tex);
 	fcy = height ? (float)height : (float)gs_texture_get_height(tex);
 
-	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
 	if (gs_texture_is_rect(tex))
-		build_sprite_rect(data, tex, fcx, fcy, flip);
+		build_sprite_rect(points, tvarray, tex, fcx, fcy, flip);
 	else
-		build_sprite_norm(data, fcx, fcy, flip);
+		build_sprite_norm(points, tvarray, fcx, fcy, flip);
+
+	if (gs_sprite_batch_add(graphics, points, tvarray))
+		return;
+
+	data = gs_vertexbuffer_get_data(graphics->sprite_buffer);
+	memcpy(data->points, points, sizeof(points));
+	memcpy(data->tvarray[0].array, tvarray, sizeof(tvarray));
 
 	gs_vertexbuffer_flush(graphics->sprite_buffer);
 	gs_load_vertexbuffer(graphics->sprite_buffer);
@@ -999,6 +1014,7 @@ void gs_perspective(float angle, float aspect, float near, float far)
 	xmin = ymin * aspect;
 	xmax = ymax * aspect;
 
+	flush_sprites(graphics);
 	graphics->exports.device_frustum(graphics->device, xmin, xmax,
 			ymin, ymax, near, far);
 }
@@ -1070,6 +1086,7 @@ void gs_resize(uint32_t x, uint32_t y)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_resize(graphics->device, x, y);
 }
 
@@ -1261,6 +1278,7 @@ void gs_load_vertexbuffer(gs_vertbuffer_t *vertbuffer)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	graphics->cur_vertbuffer = vertbuffer;
 	graphics->exports.device_load_vertexbuffer(graphics->device,
 			vertbuffer);
 }
@@ -1270,6 +1288,7 @@ void gs_load_indexbuffer(gs_indexbuffer_t *indexbuffer)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	graphics->cur_indexbuffer = indexbuffer;
 	graphics->exports.device_load_indexbuffer(graphics->device,
 			indexbuffer);
 }
@@ -1279,6 +1298,7 @@ void gs_load_texture(gs_texture_t *tex, int unit)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_load_texture(graphics->device, tex, unit);
 }
 
@@ -1287,6 +1307,7 @@ void gs_load_samplerstate(gs_samplerstate_t *samplerstate, int unit)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_load_samplerstate(graphics->device,
 			samplerstate, unit);
 }
@@ -1314,6 +1335,7 @@ void gs_load_default_samplerstate(bool b_3d, int unit)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_load_default_samplerstate(graphics->device,
 			b_3d, unit);
 }
@@ -1355,6 +1377,7 @@ void gs_set_render_target(gs_texture_t *tex, gs_zstencil_t *zstencil)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_set_render_target(graphics->device, tex,
 			zstencil);
 }
@@ -1365,6 +1388,7 @@ void gs_set_cube_render_target(gs_texture_t *cubetex, int side,
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_set_cube_render_target(graphics->device,
 			cubetex, side, zstencil);
 }
@@ -1374,6 +1398,7 @@ void gs_copy_texture(gs_texture_t *dst, gs_texture_t *src)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_copy_texture(graphics->device, dst, src);
 }
 
@@ -1384,6 +1409,7 @@ void gs_copy_texture_region(gs_texture_t *dst, uint32_t dst_x, uint32_t dst_y,
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_copy_texture_region(graphics->device,
 			dst, dst_x, dst_y,
 			src, src_x, src_y, src_w, src_h);
@@ -1394,6 +1420,7 @@ void gs_stage_texture(gs_stagesurf_t *dst, gs_texture_t *src)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_stage_texture(graphics->device, dst, src);
 }
 
@@ -1402,6 +1429,7 @@ void gs_begin_scene(void)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_begin_scene(graphics->device);
 }
 
@@ -1411,6 +1439,7 @@ void gs_draw(enum gs_draw_mode draw_mode, uint32_t start_vert,
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_draw(graphics->device, draw_mode,
 			start_vert, num_verts);
 }
@@ -1420,6 +1449,7 @@ void gs_end_scene(void)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_end_scene(graphics->device);
 }
 
@@ -1428,6 +1458,7 @@ void gs_load_swapchain(gs_swapchain_t *swapchain)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_load_swapchain(graphics->device, swapchain);
 }
 
@@ -1435,6 +1466,7 @@ void gs_clear(uint32_t clear_flags, const struct vec4 *color, float depth,
 		uint8_t stencil)
 {
 	graphics_t *graphics = thread_graphics;
+	flush_sprites(graphics);
 	graphics->exports.device_clear(graphics->device, clear_flags, color,
 			depth, stencil);
 }
@@ -1444,6 +1476,7 @@ void gs_present(void)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_present(graphics->device);
 }
 
@@ -1452,6 +1485,7 @@ void gs_flush(void)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_flush(graphics->device);
 }
 
@@ -1460,6 +1494,7 @@ void gs_set_cull_mode(enum gs_cull_mode mode)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_set_cull_mode(graphics->device, mode);
 }
 
@@ -1476,6 +1511,9 @@ void gs_enable_blending(bool enable)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	if (graphics->cur_blend_state.enabled != enable)
+		flush_sprites(graphics);
+
 	graphics->cur_blend_state.enabled = enable;
 	graphics->exports.device_enable_blending(graphics->device, enable);
 }
@@ -1485,6 +1523,7 @@ void gs_enable_depth_test(bool enable)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_enable_depth_test(graphics->device, enable);
 }
 
@@ -1493,6 +1532,7 @@ void gs_enable_stencil_test(bool enable)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_enable_stencil_test(graphics->device, enable);
 }
 
@@ -1501,6 +1541,7 @@ void gs_enable_stencil_write(bool enable)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_enable_stencil_write(graphics->device, enable);
 }
 
@@ -1509,6 +1550,7 @@ void gs_enable_color(bool red, bool green, bool blue, bool alpha)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_enable_color(graphics->device, red, green,
 			blue, alpha);
 }
@@ -1518,6 +1560,10 @@ void gs_blend_function(enum gs_blend_type src, enum gs_blend_type dest)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	if (graphics->cur_blend_state.src  != src ||
+	    graphics->cur_blend_state.dest != dest)
+		flush_sprites(graphics);
+
 	graphics->cur_blend_state.src  = src;
 	graphics->cur_blend_state.dest = dest;
 	graphics->exports.device_blend_function(graphics->device, src, dest);
@@ -1528,6 +1574,7 @@ void gs_depth_function(enum gs_depth_test test)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_depth_function(graphics->device, test);
 }
 
@@ -1536,6 +1583,7 @@ void gs_stencil_function(enum gs_stencil_side side, enum gs_depth_test test)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_stencil_function(graphics->device, side, test);
 }
 
@@ -1545,6 +1593,7 @@ void gs_stencil_op(enum gs_stencil_side side, enum gs_stencil_op_type fail,
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_stencil_op(graphics->device, side, fail, zfail,
 			zpass);
 }
@@ -1554,6 +1603,7 @@ void gs_set_viewport(int x, int y, int width, int height)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_set_viewport(graphics->device, x, y, width,
 			height);
 }
@@ -1571,6 +1621,7 @@ void gs_set_scissor_rect(const struct gs_rect *rect)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_set_scissor_rect(graphics->device, rect);
 }
 
@@ -1580,6 +1631,7 @@ void gs_ortho(float left, float right, float top, float bottom, float znear,
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_ortho(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1590,6 +1642,7 @@ void gs_frustum(float left, float right, float top, float bottom, float znear,
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_frustum(graphics->device, left, right, top,
 			bottom, znear, zfar);
 }
@@ -1607,6 +1660,7 @@ void gs_projection_pop(void)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics) return;
 
+	flush_sprites(graphics);
 	graphics->exports.device_projection_pop(graphics->device);
 }
 
@@ -1768,6 +1822,7 @@ void gs_texture_destroy(gs_texture_t *tex)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !tex) return;
 
+	flush_sprites(graphics);
 	graphics->exports.gs_texture_destroy(tex);
 }
 
@@ -1800,6 +1855,7 @@ bool gs_texture_map(gs_texture_t *tex, uint8_t **ptr, uint32_t *linesize)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !tex) return false;
 
+	flush_sprites(graphics);
 	return graphics->exports.gs_texture_map(tex, ptr, linesize);
 }
 
@@ -1811,6 +1867,21 @@ void gs_texture_unmap(gs_texture_t *tex)
 	graphics->exports.gs_texture_unmap(tex);
 }
 
+bool gs_texture_update_region(gs_texture_t *tex, uint32_t x, uint32_t y,
+		uint32_t cx, uint32_t cy, const uint8_t *data,
+		uint32_t linesize)
+{
+	graphics_t *graphics = thread_graphics;
+	if (!graphics || !tex || !data) return false;
+
+	if (!graphics->exports.gs_texture_update_region)
+		return false;
+
+	flush_sprites(graphics);
+	return graphics->exports.gs_texture_update_region(tex, x, y, cx, cy,
+			data, linesize);
+}
+
 bool gs_texture_is_rect(const gs_texture_t *tex)
 {
 	graphics_t *graphics = thread_graphics;
@@ -1835,6 +1906,7 @@ void gs_cubetexture_destroy(gs_texture_t *cubetex)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !cubetex) return;
 
+	flush_sprites(graphics);
 	graphics->exports.gs_cubetexture_destroy(cubetex);
 }
 
@@ -1860,6 +1932,7 @@ void gs_voltexture_destroy(gs_texture_t *voltex)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !voltex) return;
 
+	flush_sprites(graphics);
 	graphics->exports.gs_voltexture_destroy(voltex);
 }
 
@@ -1964,6 +2037,8 @@ void gs_vertexbuffer_destroy(gs_vertbuffer_t *vertbuffer)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !vertbuffer) return;
 
+	if (graphics->cur_vertbuffer == vertbuffer)
+		graphics->cur_vertbuffer = NULL;
 	graphics->exports.gs_vertexbuffer_destroy(vertbuffer);
 }
 
@@ -1986,6 +2061,8 @@ void gs_indexbuffer_destroy(gs_indexbuffer_t *indexbuffer)
 	graphics_t *graphics = thread_graphics;
 	if (!graphics || !indexbuffer) return;
 
+	if (graphics->cur_indexbuffer == indexbuffer)
+		graphics->cur_indexbuffer = NULL;
 	graphics->exports.gs_indexbuffer_destroy(indexbuffer);
 }
 
@@ -2039,6 +2116,7 @@ bool gs_texture_rebind_iosurface(gs_texture_t *texture, void *iosurf)
 	    !graphics->exports.gs_texture_rebind_iosurface)
 		return false;
 
+	flush_sprites(graphics);
 	return graphics->exports.gs_texture_rebind_iosurface(texture, iosurf);
 }
 
@@ -2101,6 +2179,7 @@ bool gs_duplicator_update_frame(gs_duplicator_t *duplicator)
 	if (!thread_graphics->exports.gs_duplicator_get_texture)
 		return true;
 
+	flush_sprites(thread_graphics);
 	return thread_graphics->exports.gs_duplicator_update_frame(duplicator);
 }
 
@@ -2131,6 +2210,7 @@ void *gs_texture_get_dc(gs_texture_t *gdi_tex)
 	if (!thread_graphics || !gdi_tex)
 		return NULL;
 
+	flush_sprites(thread_graphics);
 	if (thread_graphics->exports.gs_texture_get_dc)
 		return thread_graphics->exports.gs_texture_get_dc(gdi_tex);
 	return NULL;
@@ -404,6 +404,36 @@ EXPORT void gs_texrender_end(gs_texrender_t *texrender);
 EXPORT void gs_texrender_reset(gs_texrender_t *texrender);
 EXPORT gs_texture_t *gs_texrender_get_texture(const gs_texrender_t *texrender);
 
+/* ---------------------------------------------------
+ * resource pool functions
+ * --------------------------------------------------- */
+
+/**
+ * Gets a texture from the graphics context's resource pool, or creates one if
+ * none with the same size, format and flags is available.  Recycled textures
+ * are cleared to zero.  Only single-level dynamic and render target textures
+ * are recycled.
+ */
+EXPORT gs_texture_t *gs_texture_pool_acquire(uint32_t width, uint32_t height,
+		enum gs_color_format color_format, uint32_t flags);
+
+/**
+ * Returns a texture to the resource pool.  Textures that did not come from
+ * the pool are destroyed.
+ */
+EXPORT void gs_texture_pool_release(gs_texture_t *tex);
+
+EXPORT gs_stagesurf_t *gs_stagesurface_pool_acquire(uint32_t width,
+		uint32_t height, enum gs_color_format color_format);
+EXPORT void gs_stagesurface_pool_release(gs_stagesurf_t *stagesurf);
+
+/**
+ * Sets the maximum amount of video memory (in bytes) held by released pool
+ * objects.  The least recently released objects are destroyed first.
+ */
+EXPORT void gs_resource_pool_set_budget(size_t bytes);
+EXPORT size_t gs_resource_pool_get_size(void);
+
 /* ---------------------------------------------------
  * graphics subsystem
  * --------------------------------------------------- */
@@ -516,6 +546,19 @@ EXPORT gs_texture_t *gs_texture_create_from_file(const char *file);
 EXPORT void gs_draw_sprite(gs_texture_t *tex, uint32_t flip, uint32_t width,
 		uint32_t height);
 
+/**
+ * Begins batching sprites
+ *
+ *   Until the matching gs_sprite_batch_end, sprites drawn with gs_draw_sprite
+ * inside an effect pass are queued rather than drawn, and consecutive sprites
+ * that use the same effect pass and parameter values are drawn with a single
+ * draw call.  Sprites are transformed by the current matrix when they are
+ * queued.  Queued sprites are drawn before any other drawing or state change,
+ * so rendering is unaffected.  Calls may be nested.
+ */
+EXPORT void gs_sprite_batch_begin(void);
+EXPORT void gs_sprite_batch_end(void);
+
 EXPORT void gs_draw_cube_backdrop(gs_texture_t *cubetex, const struct quat *rot,
 		float left, float right, float top, float bottom, float znear);
 
@@ -664,6 +707,15 @@ EXPORT enum gs_color_format gs_texture_get_color_format(
 EXPORT bool     gs_texture_map(gs_texture_t *tex, uint8_t **ptr,
 		uint32_t *linesize);
 EXPORT void     gs_texture_unmap(gs_texture_t *tex);
+/**
+ * Updates a sub-rectangle of a texture.  data points to the first pixel of
+ * the region and linesize is the row pitch of the source data.  Returns false
+ * if the renderer or texture does not support partial updates, in which case
+ * the entire image must be uploaded with gs_texture_set_image instead.
+ */
+EXPORT bool     gs_texture_update_region(gs_texture_t *tex,
+		uint32_t x, uint32_t y, uint32_t cx, uint32_t cy,
+		const uint8_t *data, uint32_t linesize);
 /** special-case function (GL only) - specifies whether the texture is a
  * GL_TEXTURE_RECTANGLE type, which doesn't use normalized texture
  * coordinates, doesn't support mipmapping, and requires address clamping */
@@ -0,0 +1,284 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ *   Recycles textures and staging surfaces by size, format and flags so that
+ * resolution changes don't need a driver allocation every time.  Released
+ * objects are kept in least-recently-released order and the oldest are
+ * destroyed once the pool exceeds its budget.  The pool belongs to the
+ * graphics context and must only be used while the context is entered.
+ */
+
+#include <string.h>
+#include "../util/base.h"
+#include "vec4.h"
+#include "graphics-internal.h"
+
+static inline size_t object_size(uint32_t width, uint32_t height,
+		enum gs_color_format format)
+{
+	return (size_t)width * (size_t)height * gs_get_format_bpp(format) / 8;
+}
+
+static inline bool poolable_texture(enum gs_color_format format,
+		uint32_t flags)
+{
+	/* static textures can't be cleared and mipmapped textures would need
+	 * their chain regenerated, so those are never recycled */
+	if (flags & (GS_BUILD_MIPMAPS | GS_GL_DUMMYTEX))
+		return false;
+	if ((flags & (GS_DYNAMIC | GS_RENDER_TARGET)) == 0)
+		return false;
+
+	return !gs_is_compressed_format(format);
+}
+
+static size_t find_entry(struct gs_resource_pool *pool,
+		enum gs_pool_type type, uint32_t width, uint32_t height,
+		enum gs_color_format format, uint32_t flags)
+{
+	/* search from the most recently released object */
+	for (size_t i = pool->entries.num; i > 0; i--) {
+		struct gs_pool_entry *entry = pool->entries.array + (i - 1);
+
+		if (entry->type   == type   &&
+		    entry->width  == width  &&
+		    entry->height == height &&
+		    entry->format == format &&
+		    entry->flags  == flags)
+			return i - 1;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static size_t find_loan(struct gs_resource_pool *pool, const void *object)
+{
+	for (size_t i = 0; i < pool->loans.num; i++) {
+		if (pool->loans.array[i].object == object)
+			return i;
+	}
+
+	return DARRAY_INVALID;
+}
+
+static void destroy_entry(graphics_t *graphics, struct gs_pool_entry *entry)
+{
+	if (entry->type == GS_POOL_TEXTURE)
+		graphics->exports.gs_texture_destroy(entry->object);
+	else
+		graphics->exports.gs_stagesurface_destroy(entry->object);
+}
+
+static void pool_trim(graphics_t *graphics)
+{
+	struct gs_resource_pool *pool = &graphics->pool;
+
+	while (pool->entries.num && pool->size > pool->budget) {
+		struct gs_pool_entry *entry = pool->entries.array;
+
+		pool->size -= entry->size;
+		destroy_entry(graphics, entry);
+		da_erase(pool->entries, 0);
+	}
+}
+
+static void *pool_take(graphics_t *graphics, enum gs_pool_type type,
+		uint32_t width, uint32_t height, enum gs_color_format format,
+		uint32_t flags)
+{
+	struct gs_resource_pool *pool = &graphics->pool;
+	struct gs_pool_entry entry;
+	size_t idx;
+
+	idx = find_entry(pool, type, width, height, format, flags);
+	if (idx == DARRAY_INVALID)
+		return NULL;
+
+	entry = pool->entries.array[idx];
+	pool->size -= entry.size;
+	da_erase(pool->entries, idx);
+
+	da_push_back(pool->loans, &entry);
+	return entry.object;
+}
+
+static void pool_loan(graphics_t *graphics, enum gs_pool_type type,
+		void *object, uint32_t width, uint32_t height,
+		enum gs_color_format format, uint32_t flags)
+{
+	struct gs_pool_entry entry;
+
+	entry.type   = type;
+	entry.object = object;
+	entry.width  = width;
+	entry.height = height;
+	entry.format = format;
+	entry.flags  = flags;
+	entry.size   = object_size(width, height, format);
+
+	da_push_back(graphics->pool.loans, &entry);
+}
+
+/* returns false if the object wasn't acquired from the pool */
+static bool pool_return(graphics_t *graphics, void *object)
+{
+	struct gs_resource_pool *pool = &graphics->pool;
+	struct gs_pool_entry entry;
+	size_t idx = find_loan(pool, object);
+
+	if (idx == DARRAY_INVALID)
+		return false;
+
+	entry = pool->loans.array[idx];
+	da_erase(pool->loans, idx);
+
+	da_push_back(pool->entries, &entry);
+	pool->size += entry.size;
+
+	pool_trim(graphics);
+	return true;
+}
+
+static void clear_texture(gs_texture_t *tex, uint32_t height, uint32_t flags)
+{
+	if (flags & GS_RENDER_TARGET) {
+		gs_texture_t  *prev_target = gs_get_render_target();
+		gs_zstencil_t *prev_zs     = gs_get_zstencil_target();
+		struct vec4   clear_color;
+
+		vec4_zero(&clear_color);
+		gs_set_render_target(tex, NULL);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 1.0f, 0);
+		gs_set_render_target(prev_target, prev_zs);
+
+	} else {
+		uint8_t  *ptr;
+		uint32_t linesize;
+
+		if (gs_texture_map(tex, &ptr, &linesize)) {
+			memset(ptr, 0, (size_t)linesize * height);
+			gs_texture_unmap(tex);
+		}
+	}
+}
+
+gs_texture_t *gs_texture_pool_acquire(uint32_t width, uint32_t height,
+		enum gs_color_format color_format, uint32_t flags)
+{
+	graphics_t   *graphics = gs_get_context();
+	gs_texture_t *tex;
+
+	if (!graphics)
+		return NULL;
+
+	if (!poolable_texture(color_format, flags))
+		return gs_texture_create(width, height, color_format, 1, NULL,
+				flags);
+
+	tex = pool_take(graphics, GS_POOL_TEXTURE, width, height,
+			color_format, flags);
+	if (tex) {
+		clear_texture(tex, height, flags);
+		return tex;
+	}
+
+	tex = gs_texture_create(width, height, color_format, 1, NULL, flags);
+	if (tex)
+		pool_loan(graphics, GS_POOL_TEXTURE, tex, width, height,
+				color_format, flags);
+	return tex;
+}
+
+void gs_texture_pool_release(gs_texture_t *tex)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!graphics || !tex)
+		return;
+
+	if (!pool_return(graphics, tex))
+		gs_texture_destroy(tex);
+}
+
+gs_stagesurf_t *gs_stagesurface_pool_acquire(uint32_t width, uint32_t height,
+		enum gs_color_format color_format)
+{
+	graphics_t     *graphics = gs_get_context();
+	gs_stagesurf_t *surf;
+
+	if (!graphics)
+		return NULL;
+
+	/* staging surfaces are always fully overwritten by gs_stage_texture,
+	 * so they aren't cleared */
+	surf = pool_take(graphics, GS_POOL_STAGESURF, width, height,
+			color_format, 0);
+	if (surf)
+		return surf;
+
+	surf = gs_stagesurface_create(width, height, color_format);
+	if (surf)
+		pool_loan(graphics, GS_POOL_STAGESURF, surf, width, height,
+				color_format, 0);
+	return surf;
+}
+
+void gs_stagesurface_pool_release(gs_stagesurf_t *stagesurf)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!graphics || !stagesurf)
+		return;
+
+	if (!pool_return(graphics, stagesurf))
+		gs_stagesurface_destroy(stagesurf);
+}
+
+void gs_resource_pool_set_budget(size_t bytes)
+{
+	graphics_t *graphics = gs_get_context();
+
+	if (!graphics)
+		return;
+
+	graphics->pool.budget = bytes;
+	pool_trim(graphics);
+}
+
+size_t gs_resource_pool_get_size(void)
+{
+	graphics_t *graphics = gs_get_context();
+	return graphics ? graphics->pool.size : 0;
+}
+
+void gs_resource_pool_free(graphics_t *graphics)
+{
+	struct gs_resource_pool *pool = &graphics->pool;
+
+	for (size_t i = 0; i < pool->entries.num; i++)
+		destroy_entry(graphics, pool->entries.array + i);
+
+	if (pool->loans.num)
+		blog(LOG_DEBUG, "gs_resource_pool_free: %u pooled objects "
+		                "were never released",
+		                (unsigned int)pool->loans.num);
+
+	da_free(pool->entries);
+	da_free(pool->loans);
+	pool->size = 0;
+}
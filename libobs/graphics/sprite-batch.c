@@ -0,0 +1,314 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+/*
+ *   Queues sprites drawn between gs_sprite_batch_begin and gs_sprite_batch_end
+ * and draws runs of them that share an effect pass and parameter values as a
+ * single triangle list.  Sprite corners are transformed by the current matrix
+ * as they're queued, so sprites with different transforms (scene items, for
+ * example) can still share a draw call.
+ *
+ *   The queue is submitted whenever a sprite with different effect state is
+ * drawn, and before anything else that would draw or change device state.
+ * Because the effect may have moved on by then, the parameter values each
+ * queue was drawn with are kept and put back into the effect while it's
+ * submitted.
+ */
+
+#include <string.h>
+#include "../util/base.h"
+#include "vec2.h"
+#include "vec3.h"
+#include "effect.h"
+#include "graphics-internal.h"
+
+#define SPRITE_VERTS 6
+
+/* the two triangles of a sprite's triangle strip */
+static const size_t sprite_order[SPRITE_VERTS] = {0, 1, 2, 2, 1, 3};
+
+bool gs_sprite_batch_init(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	size_t num_verts = GS_SPRITE_BATCH_MAX * SPRITE_VERTS;
+	struct gs_vb_data *vbd;
+
+	vbd = gs_vbdata_create();
+	vbd->num     = num_verts;
+	vbd->points  = bzalloc(sizeof(struct vec3) * num_verts);
+	vbd->num_tex = 1;
+	vbd->tvarray = bmalloc(sizeof(struct gs_tvertarray));
+	vbd->tvarray[0].width = 2;
+	vbd->tvarray[0].array = bzalloc(sizeof(struct vec2) * num_verts);
+
+	batch->vertbuffer = graphics->exports.
+		device_vertexbuffer_create(graphics->device, vbd, GS_DYNAMIC);
+	if (!batch->vertbuffer)
+		return false;
+
+	return true;
+}
+
+void gs_sprite_batch_free(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+
+	if (batch->vertbuffer)
+		graphics->exports.gs_vertexbuffer_destroy(batch->vertbuffer);
+
+	da_free(batch->values);
+	da_free(batch->sizes);
+	da_free(batch->saved);
+	batch->num = 0;
+}
+
+/* the value a parameter will be uploaded with */
+static inline const struct darray *param_value(
+		const struct gs_effect_param *param)
+{
+	return param->cur_val.num ? &param->cur_val.da : &param->default_val.da;
+}
+
+static void save_params(struct gs_sprite_batch *batch,
+		const struct gs_effect *effect)
+{
+	da_resize(batch->values, 0);
+	da_resize(batch->sizes, 0);
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		const struct darray *val = param_value(effect->params.array+i);
+
+		if (val->num)
+			da_push_back_array(batch->values, val->array,
+					val->num);
+		da_push_back(batch->sizes, &val->num);
+	}
+}
+
+static bool params_match(const struct gs_sprite_batch *batch,
+		const struct gs_effect *effect)
+{
+	const uint8_t *values = batch->values.array;
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		const struct darray *val = param_value(effect->params.array+i);
+		size_t size = batch->sizes.array[i];
+
+		if (val->num != size || memcmp(val->array, values, size) != 0)
+			return false;
+
+		values += size;
+	}
+
+	return true;
+}
+
+static inline bool state_matches(const struct gs_sprite_batch *batch,
+		const struct gs_effect *effect)
+{
+	return batch->effect == effect &&
+	       batch->tech   == effect->cur_technique &&
+	       batch->pass   == effect->cur_pass &&
+	       params_match(batch, effect);
+}
+
+/* projective transforms can't be applied to the vertices ahead of time */
+static inline bool is_affine(const struct matrix4 *m)
+{
+	return m->x.w == 0.0f && m->y.w == 0.0f && m->z.w == 0.0f &&
+	       m->t.w == 1.0f;
+}
+
+bool gs_sprite_batch_add(graphics_t *graphics, const struct vec3 *points,
+		const struct vec2 *uvs)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_effect *effect = graphics->cur_effect;
+	struct matrix4 matrix;
+	struct gs_vb_data *data;
+	struct vec3 corners[4];
+	struct vec3 *out_points;
+	struct vec2 *out_uvs;
+
+	if (!batch->depth || !batch->vertbuffer)
+		return false;
+
+	/* copied, submitting can reallocate the matrix stack */
+	gs_matrix_get(&matrix);
+
+	if (!effect || !effect->cur_pass || !is_affine(&matrix)) {
+		flush_sprites(graphics);
+		return false;
+	}
+
+	if (batch->num == GS_SPRITE_BATCH_MAX ||
+	    (batch->num && !state_matches(batch, effect)))
+		gs_sprite_batch_submit(graphics);
+
+	if (!batch->num) {
+		batch->effect = effect;
+		batch->tech   = effect->cur_technique;
+		batch->pass   = effect->cur_pass;
+		save_params(batch, effect);
+	}
+
+	for (size_t i = 0; i < 4; i++)
+		vec3_transform(corners + i, points + i, &matrix);
+
+	data = graphics->exports.gs_vertexbuffer_get_data(batch->vertbuffer);
+	out_points = data->points + batch->num * SPRITE_VERTS;
+	out_uvs    = (struct vec2*)data->tvarray[0].array +
+	             batch->num * SPRITE_VERTS;
+
+	for (size_t i = 0; i < SPRITE_VERTS; i++) {
+		vec3_copy(out_points + i, corners + sprite_order[i]);
+		vec2_copy(out_uvs + i, uvs + sprite_order[i]);
+	}
+
+	batch->num++;
+	return true;
+}
+
+/* swaps the values the queue was drawn with into the effect */
+static void swap_in_params(struct gs_sprite_batch *batch)
+{
+	struct gs_effect *effect = batch->effect;
+	const uint8_t *values = batch->values.array;
+
+	da_resize(batch->saved, effect->params.num);
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		struct gs_effect_param *param = effect->params.array+i;
+		size_t size = batch->sizes.array[i];
+
+		batch->saved.array[i] = param->cur_val.da;
+		da_init(param->cur_val);
+		if (size)
+			da_push_back_array(param->cur_val, values, size);
+		param->changed = true;
+
+		values += size;
+	}
+}
+
+static void swap_out_params(struct gs_sprite_batch *batch)
+{
+	struct gs_effect *effect = batch->effect;
+
+	for (size_t i = 0; i < effect->params.num; i++) {
+		struct gs_effect_param *param = effect->params.array+i;
+
+		da_free(param->cur_val);
+		param->cur_val.da = batch->saved.array[i];
+		param->changed = true;
+	}
+}
+
+static void draw_queue(graphics_t *graphics, size_t num)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_exports *exports = &graphics->exports;
+	struct gs_vb_data *data;
+	uint32_t num_verts = (uint32_t)(num * SPRITE_VERTS);
+
+	/* only upload the queued part of the buffer */
+	data = exports->gs_vertexbuffer_get_data(batch->vertbuffer);
+	data->num = num_verts;
+	exports->gs_vertexbuffer_flush(batch->vertbuffer);
+	data->num = GS_SPRITE_BATCH_MAX * SPRITE_VERTS;
+
+	exports->device_load_vertexbuffer(graphics->device, batch->vertbuffer);
+	exports->device_load_indexbuffer(graphics->device, NULL);
+
+	/* the vertices are already transformed */
+	gs_matrix_push();
+	gs_matrix_identity();
+	exports->device_draw(graphics->device, GS_TRIS, 0, num_verts);
+	gs_matrix_pop();
+
+	exports->device_load_vertexbuffer(graphics->device,
+			graphics->cur_vertbuffer);
+	exports->device_load_indexbuffer(graphics->device,
+			graphics->cur_indexbuffer);
+}
+
+void gs_sprite_batch_submit(graphics_t *graphics)
+{
+	struct gs_sprite_batch *batch = &graphics->sprite_batch;
+	struct gs_effect *effect = batch->effect;
+	struct gs_effect *prev_effect = graphics->cur_effect;
+	gs_shader_t *prev_vs = NULL, *prev_ps = NULL;
+	size_t num = batch->num;
+	size_t pass_idx;
+	bool tech_live, pass_live;
+
+	if (!num)
+		return;
+
+	/* beginning the technique below must not submit the queue again */
+	batch->num = 0;
+
+	tech_live = prev_effect == effect &&
+	            effect->cur_technique == batch->tech;
+	pass_live = tech_live && effect->cur_pass == batch->pass;
+	pass_idx  = batch->pass - batch->tech->passes.array;
+
+	swap_in_params(batch);
+
+	if (!pass_live) {
+		prev_vs = graphics->exports.device_get_vertex_shader(
+				graphics->device);
+		prev_ps = graphics->exports.device_get_pixel_shader(
+				graphics->device);
+
+		if (!tech_live)
+			gs_technique_begin(batch->tech);
+		gs_technique_begin_pass(batch->tech, pass_idx);
+	}
+
+	draw_queue(graphics, num);
+
+	if (!pass_live) {
+		gs_technique_end_pass(batch->tech);
+		if (!tech_live) {
+			gs_technique_end(batch->tech);
+			graphics->cur_effect = prev_effect;
+		}
+
+		gs_load_vertexshader(prev_vs);
+		gs_load_pixelshader(prev_ps);
+	}
+
+	swap_out_params(batch);
+}
+
+void gs_sprite_batch_begin(void)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics) return;
+
+	graphics->sprite_batch.depth++;
+}
+
+void gs_sprite_batch_end(void)
+{
+	graphics_t *graphics = gs_get_context();
+	if (!graphics || !graphics->sprite_batch.depth) return;
+
+	if (--graphics->sprite_batch.depth == 0)
+		flush_sprites(graphics);
+}
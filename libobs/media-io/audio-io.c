@@ -20,7 +20,6 @@
 
 #include "../util/threading.h"
 #include "../util/darray.h"
-#include "../util/circlebuf.h"
 #include "../util/platform.h"
 
 #include "audio-io.h"
@@ -43,13 +42,153 @@ static inline void audio_input_free(struct audio_input *input)
 	audio_resampler_destroy(input->resampler);
 }
 
+/* ------------------------------------------------------------------------- */
+/* fixed size ring buffer holding one plane of an audio line.  the capacity
+ * is a multiple of the block size, so samples never straddle the wrap point
+ * and the data can be mixed straight out of the ring. */
+
+/* audio_line_output accepts data starting up to this far past the buffering
+ * time */
+#define MAX_DELAY_NS 6000000000ULL
+
+/* room for the length of the data placed at the latest accepted timestamp */
+#define AUDIO_RING_EXTRA_MS 1000
+
+struct audio_ring {
+	uint8_t *data;
+	size_t  capacity;
+	size_t  start;
+	size_t  size;
+};
+
+static inline void audio_ring_init(struct audio_ring *ring, size_t capacity)
+{
+	ring->data     = bmalloc_tagged(capacity, BMEM_TAG_AUDIO);
+	ring->capacity = capacity;
+	ring->start    = 0;
+	ring->size     = 0;
+}
+
+static inline void audio_ring_free(struct audio_ring *ring)
+{
+	bfree(ring->data);
+	memset(ring, 0, sizeof(*ring));
+}
+
+static inline size_t audio_ring_offset(const struct audio_ring *ring,
+		size_t position)
+{
+	position += ring->start;
+	return (position >= ring->capacity) ?
+		position - ring->capacity : position;
+}
+
+static inline void audio_ring_pop(struct audio_ring *ring, size_t size)
+{
+	if (size > ring->size)
+		size = ring->size;
+
+	ring->start = audio_ring_offset(ring, size);
+	ring->size -= size;
+	if (!ring->size)
+		ring->start = 0;
+}
+
+/* returns up to two contiguous spans covering the first 'size' bytes */
+static inline size_t audio_ring_peek(const struct audio_ring *ring,
+		size_t size, uint8_t *spans[2], size_t span_sizes[2])
+{
+	size_t back_size;
+
+	if (size > ring->size)
+		size = ring->size;
+
+	back_size     = ring->capacity - ring->start;
+	spans[0]      = ring->data + ring->start;
+	span_sizes[0] = (size < back_size) ? size : back_size;
+	spans[1]      = ring->data;
+	span_sizes[1] = size - span_sizes[0];
+	return size;
+}
+
+static inline void audio_ring_zero(struct audio_ring *ring, size_t position,
+		size_t size)
+{
+	while (size) {
+		size_t offset = audio_ring_offset(ring, position);
+		size_t count  = ring->capacity - offset;
+
+		if (count > size)
+			count = size;
+
+		memset(ring->data + offset, 0, count);
+		position += count;
+		size     -= count;
+	}
+}
+
+static inline void copy_vol_float(float *dst, const float *src,
+		float volume, size_t count)
+{
+	if (volume == 1.0f) {
+		memcpy(dst, src, count * sizeof(float));
+		return;
+	}
+
+	for (size_t i = 0; i < count; i++)
+		dst[i] = src[i] * volume;
+}
+
+/* writes data at a position relative to the start of the ring, applying the
+ * volume on the way in and zero filling any gap after the current data.
+ * returns the number of bytes that did not fit and were dropped. */
+static size_t audio_ring_place(struct audio_ring *ring, size_t position,
+		const uint8_t *data, size_t size, bool is_float, float volume)
+{
+	size_t dropped = 0;
+
+	if (position >= ring->capacity)
+		return size;
+	if (position + size > ring->capacity) {
+		dropped = position + size - ring->capacity;
+		size   -= dropped;
+	}
+
+	if (position > ring->size)
+		audio_ring_zero(ring, ring->size, position - ring->size);
+	if (position + size > ring->size)
+		ring->size = position + size;
+
+	while (size) {
+		size_t offset = audio_ring_offset(ring, position);
+		size_t count  = ring->capacity - offset;
+
+		if (count > size)
+			count = size;
+
+		if (is_float)
+			copy_vol_float((float*)(ring->data + offset),
+					(const float*)data, volume,
+					count / sizeof(float));
+		else
+			memcpy(ring->data + offset, data, count);
+
+		data     += count;
+		position += count;
+		size     -= count;
+	}
+
+	return dropped;
+}
+
+/* ------------------------------------------------------------------------- */
+
 struct audio_line {
 	char                       *name;
 
 	struct audio_output        *audio;
-	struct circlebuf           buffers[MAX_AV_PLANES];
+	struct audio_ring          buffers[MAX_AV_PLANES];
 	pthread_mutex_t            mutex;
-	DARRAY(uint8_t)            volume_buffers[MAX_AV_PLANES];
 	uint64_t                   base_timestamp;
 	uint64_t                   last_timestamp;
 
@@ -68,10 +207,8 @@ struct audio_line {
 
 static inline void audio_line_destroy_data(struct audio_line *line)
 {
-	for (size_t i = 0; i < MAX_AV_PLANES; i++) {
-		circlebuf_free(&line->buffers[i]);
-		da_free(line->volume_buffers[i]);
-	}
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		audio_ring_free(&line->buffers[i]);
 
 	pthread_mutex_destroy(&line->mutex);
 	bfree(line->name);
@@ -173,7 +310,7 @@ static inline void clear_excess_audio_data(struct audio_line *line,
 		size_t clear_size = (size < line->buffers[i].size) ?
 			size : line->buffers[i].size;
 
-		circlebuf_pop_front(&line->buffers[i], NULL, clear_size);
+		audio_ring_pop(&line->buffers[i], clear_size);
 	}
 }
 
@@ -192,38 +329,36 @@ static inline size_t min_size(size_t a, size_t b)
 	((val > maxval) ? maxval : ((val < minval) ? minval : val))
 #endif
 
-#define MIX_BUFFER_SIZE 256
-
-/* TODO: optimize mixing */
+/* mixes directly out of the line's ring, volume was applied on insertion */
 static void mix_float(struct audio_output *audio, struct audio_line *line,
 		size_t size, size_t time_offset, size_t plane)
 {
-	float *mixes[MAX_AUDIO_MIXES];
-	float vals[MIX_BUFFER_SIZE];
+	struct audio_ring *ring = &line->buffers[plane];
+	uint8_t *spans[2];
+	size_t span_sizes[2];
+
+	size = audio_ring_peek(ring, size, spans, span_sizes);
 
 	for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
 		uint8_t *bytes = audio->mixes[mix_idx].mix_buffers[plane].array;
-		mixes[mix_idx] = (float*)&bytes[time_offset];
-	}
+		float   *mix   = (float*)&bytes[time_offset];
 
-	while (size) {
-		size_t pop_count = min_size(size, sizeof(vals));
-		size -= pop_count;
+		/* only include this audio line in this mix if it's set
+		 * via the line's 'mixes' variable */
+		if ((line->mixers & (1 << mix_idx)) == 0)
+			continue;
 
-		circlebuf_pop_front(&line->buffers[plane], vals, pop_count);
-		pop_count /= sizeof(float);
+		for (size_t span = 0; span < 2; span++) {
+			const float *vals  = (const float*)spans[span];
+			size_t       count = span_sizes[span] / sizeof(float);
 
-		for (size_t mix_idx = 0; mix_idx < MAX_AUDIO_MIXES; mix_idx++) {
-			/* only include this audio line in this mix if it's set
-			 * via the line's 'mixes' variable */
-			if ((line->mixers & (1 << mix_idx)) == 0)
-				continue;
-
-			for (size_t i = 0; i < pop_count; i++) {
-				*(mixes[mix_idx]++) += vals[i];
-			}
+			for (size_t i = 0; i < count; i++)
+				mix[i] += vals[i];
+			mix += count;
 		}
 	}
+
+	audio_ring_pop(ring, size);
 }
 
 static inline bool mix_audio_line(struct audio_output *audio,
@@ -616,13 +751,27 @@ audio_line_t *audio_output_create_line(audio_t *audio, const char *name,
 	if (!audio) return NULL;
 
 	struct audio_line *line = bzalloc(sizeof(struct audio_line));
+	uint64_t ring_ms = audio->info.buffer_ms * 2 + MAX_DELAY_NS / 1000000 +
+		AUDIO_RING_EXTRA_MS;
+	size_t   ring_frames;
+
 	line->alive = true;
 	line->audio = audio;
 	line->mixers = mixers;
 
+	/* the rings are allocated once with room for every timestamp that
+	 * valid_timestamp_range accepts, so placing data never has to grow or
+	 * move the buffers */
+	ring_frames = (size_t)(ring_ms * audio->info.samples_per_sec / 1000);
+	for (size_t i = 0; i < audio->planes; i++)
+		audio_ring_init(&line->buffers[i],
+				ring_frames * audio->block_size);
+
 	if (pthread_mutex_init(&line->mutex, NULL) != 0) {
 		blog(LOG_ERROR, "audio_output_createline: Failed to create "
 		                "mutex");
+		for (size_t i = 0; i < MAX_AV_PLANES; i++)
+			audio_ring_free(&line->buffers[i]);
 		bfree(line);
 		return NULL;
 	}
@@ -692,40 +841,33 @@ uint32_t audio_output_get_sample_rate(const audio_t *audio)
 	return audio ? audio->info.samples_per_sec : 0;
 }
 
-/* TODO: optimize these two functions */
-static inline void mul_vol_float(float *array, float volume, size_t count)
-{
-	for (size_t i = 0; i < count; i++)
-		array[i] *= volume;
-}
-
 static void audio_line_place_data_pos(struct audio_line *line,
 		const struct audio_data *data, size_t position)
 {
-	bool   planar     = line->audio->planes > 1;
-	size_t total_num  = data->frames * (planar ? 1 : line->audio->channels);
 	size_t total_size = data->frames * line->audio->block_size;
+	size_t dropped    = 0;
+	bool   is_float;
+
+	switch (line->audio->info.format) {
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		is_float = true;
+		break;
+	default:
+		blog(LOG_ERROR, "audio_line_place_data_pos: "
+		                "Unsupported or unknown format");
+		is_float = false;
+		break;
+	}
 
-	for (size_t i = 0; i < line->audio->planes; i++) {
-		da_copy_array(line->volume_buffers[i], data->data[i],
-				total_size);
-
-		uint8_t *array = line->volume_buffers[i].array;
-
-		switch (line->audio->info.format) {
-		case AUDIO_FORMAT_FLOAT:
-		case AUDIO_FORMAT_FLOAT_PLANAR:
-			mul_vol_float((float*)array, data->volume, total_num);
-			break;
-		default:
-			blog(LOG_ERROR, "audio_line_place_data_pos: "
-			                "Unsupported or unknown format");
-			break;
-		}
+	for (size_t i = 0; i < line->audio->planes; i++)
+		dropped = audio_ring_place(&line->buffers[i], position,
+				data->data[i], total_size, is_float,
+				data->volume);
 
-		circlebuf_place(&line->buffers[i], position,
-				line->volume_buffers[i].array, total_size);
-	}
+	if (dropped)
+		blog(LOG_WARNING, "Audio line '%s' is full, dropped %"PRIu64
+		                " bytes", line->name, (uint64_t)dropped);
 }
 
 static inline uint64_t smooth_ts(struct audio_line *line, uint64_t timestamp)
@@ -768,8 +910,6 @@ static void audio_line_place_data(struct audio_line *line,
 	audio_line_place_data_pos(line, data, pos);
 }
 
-#define MAX_DELAY_NS 6000000000ULL
-
 /* prevent insertation of data too far away from expected audio timing */
 static inline bool valid_timestamp_range(struct audio_line *line, uint64_t ts)
 {
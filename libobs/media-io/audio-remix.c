@@ -0,0 +1,491 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <string.h>
+#include <xmmintrin.h>
+#include <emmintrin.h>
+
+#include "../util/bmem.h"
+#include "audio-remix.h"
+
+/* frames converted per pass, small enough for the scratch planes to stay in
+ * the L1 cache between conversion and mixing */
+#define REMIX_BLOCK 256
+
+#define SQRT1_2 0.70710678118654752440f
+
+/* speaker positions, the channel order of each layout is the one the audio
+ * resampler uses */
+enum speaker {
+	SPK_FL,
+	SPK_FR,
+	SPK_FC,
+	SPK_LFE,
+	SPK_BL,
+	SPK_BR,
+	SPK_FLC,
+	SPK_FRC,
+	SPK_BC,
+	SPK_SL,
+	SPK_SR,
+	SPK_COUNT
+};
+
+struct remix_row {
+	size_t count;
+	size_t src[MAX_AV_PLANES];
+	float  coef[MAX_AV_PLANES];
+};
+
+struct audio_remixer {
+	enum audio_format format;
+	size_t            in_channels;
+	size_t            out_channels;
+	bool              planar;
+	bool              direct;
+
+	struct remix_row  rows[MAX_AV_PLANES];
+
+	float             scratch[MAX_AV_PLANES][REMIX_BLOCK];
+	float             interleaved[MAX_AV_PLANES * REMIX_BLOCK];
+};
+
+static size_t get_speakers(enum speaker_layout layout, enum speaker *spk)
+{
+	static const enum speaker mono[]      = {SPK_FC};
+	static const enum speaker stereo[]    = {SPK_FL, SPK_FR};
+	static const enum speaker two_one[]   = {SPK_FL, SPK_FR, SPK_BC};
+	static const enum speaker surround[]  = {SPK_FL, SPK_FR, SPK_FC};
+	static const enum speaker quad[]      = {SPK_FL, SPK_FR, SPK_BL,
+	                                         SPK_BR};
+	static const enum speaker four_one[]  = {SPK_FL, SPK_FR, SPK_FC,
+	                                         SPK_LFE, SPK_BC};
+	static const enum speaker five_one[]  = {SPK_FL, SPK_FR, SPK_FC,
+	                                         SPK_LFE, SPK_SL, SPK_SR};
+	static const enum speaker five_one_back[] = {SPK_FL, SPK_FR, SPK_FC,
+	                                         SPK_LFE, SPK_BL, SPK_BR};
+	static const enum speaker seven_one[] = {SPK_FL, SPK_FR, SPK_FC,
+	                                         SPK_LFE, SPK_BL, SPK_BR,
+	                                         SPK_SL, SPK_SR};
+	static const enum speaker seven_one_wide[] = {SPK_FL, SPK_FR, SPK_FC,
+	                                         SPK_LFE, SPK_BL, SPK_BR,
+	                                         SPK_FLC, SPK_FRC};
+
+	const enum speaker *list;
+	size_t count;
+
+#define SET_LIST(l) list = l; count = sizeof(l) / sizeof(l[0]); break
+	switch (layout) {
+	case SPEAKERS_MONO:             SET_LIST(mono);
+	case SPEAKERS_STEREO:           SET_LIST(stereo);
+	case SPEAKERS_2POINT1:          SET_LIST(two_one);
+	case SPEAKERS_SURROUND:         SET_LIST(surround);
+	case SPEAKERS_QUAD:             SET_LIST(quad);
+	case SPEAKERS_4POINT1:          SET_LIST(four_one);
+	case SPEAKERS_5POINT1:          SET_LIST(five_one);
+	case SPEAKERS_5POINT1_SURROUND: SET_LIST(five_one_back);
+	case SPEAKERS_7POINT1:          SET_LIST(seven_one);
+	case SPEAKERS_7POINT1_SURROUND: SET_LIST(seven_one_wide);
+	default:                        return 0;
+	}
+#undef SET_LIST
+
+	memcpy(spk, list, count * sizeof(enum speaker));
+	return count;
+}
+
+/* ------------------------------------------------------------------------- */
+/* mixing matrix, using the same default coefficients as swresample (centre
+ * and surrounds folded in at -3 dB, LFE dropped, no normalization for float
+ * output) so switching between the two isn't audible */
+
+struct remix_matrix {
+	int   dst_idx[SPK_COUNT];
+	float coef[MAX_AV_PLANES][MAX_AV_PLANES];
+};
+
+static inline bool has_spk(const struct remix_matrix *m, enum speaker spk)
+{
+	return m->dst_idx[spk] >= 0;
+}
+
+static inline void add_spk(struct remix_matrix *m, enum speaker dst,
+		size_t src, float coef)
+{
+	m->coef[m->dst_idx[dst]][src] += coef;
+}
+
+/* adds to the matching side of a left/right pair if both exist */
+static bool add_pair(struct remix_matrix *m, enum speaker left,
+		enum speaker right, size_t src, bool src_left, float coef)
+{
+	if (has_spk(m, left) && has_spk(m, right)) {
+		add_spk(m, src_left ? left : right, src, coef);
+		return true;
+	}
+
+	return false;
+}
+
+static bool add_to_both(struct remix_matrix *m, enum speaker left,
+		enum speaker right, size_t src, float coef)
+{
+	if (has_spk(m, left) && has_spk(m, right)) {
+		add_spk(m, left,  src, coef);
+		add_spk(m, right, src, coef);
+		return true;
+	}
+
+	return false;
+}
+
+static void map_missing_speaker(struct remix_matrix *m, enum speaker spk,
+		size_t src)
+{
+	bool left = true;
+
+	switch (spk) {
+	case SPK_FC:
+		if (!add_to_both(m, SPK_FL, SPK_FR, src, SQRT1_2))
+			add_to_both(m, SPK_SL, SPK_SR, src, SQRT1_2);
+		break;
+
+	case SPK_FR:
+	case SPK_FRC:
+		left = false;
+		/* fall through */
+	case SPK_FL:
+	case SPK_FLC:
+		if (!add_pair(m, SPK_FL, SPK_FR, src, left, 1.0f) &&
+		    has_spk(m, SPK_FC))
+			add_spk(m, SPK_FC, src, SQRT1_2);
+		break;
+
+	case SPK_BC:
+		if (!add_to_both(m, SPK_BL, SPK_BR, src, SQRT1_2) &&
+		    !add_to_both(m, SPK_SL, SPK_SR, src, SQRT1_2) &&
+		    !add_to_both(m, SPK_FL, SPK_FR, src, 0.5f) &&
+		    has_spk(m, SPK_FC))
+			add_spk(m, SPK_FC, src, SQRT1_2);
+		break;
+
+	case SPK_BR:
+	case SPK_SR:
+		left = false;
+		/* fall through */
+	case SPK_BL:
+	case SPK_SL:
+		if (add_pair(m, SPK_BL, SPK_BR, src, left, 1.0f) ||
+		    add_pair(m, SPK_SL, SPK_SR, src, left, 1.0f))
+			break;
+		if (has_spk(m, SPK_BC))
+			add_spk(m, SPK_BC, src, SQRT1_2);
+		else if (!add_pair(m, SPK_FL, SPK_FR, src, left, SQRT1_2) &&
+		         has_spk(m, SPK_FC))
+			add_spk(m, SPK_FC, src, SQRT1_2);
+		break;
+
+	case SPK_LFE:
+	case SPK_COUNT:
+		break;
+	}
+}
+
+static void build_rows(struct audio_remixer *rm,
+		const enum speaker *src_spk, const enum speaker *dst_spk)
+{
+	struct remix_matrix m;
+
+	memset(&m, 0, sizeof(m));
+	for (size_t i = 0; i < SPK_COUNT; i++)
+		m.dst_idx[i] = -1;
+	for (size_t i = 0; i < rm->out_channels; i++)
+		m.dst_idx[dst_spk[i]] = (int)i;
+
+	for (size_t src = 0; src < rm->in_channels; src++) {
+		if (has_spk(&m, src_spk[src]))
+			add_spk(&m, src_spk[src], src, 1.0f);
+		else
+			map_missing_speaker(&m, src_spk[src], src);
+	}
+
+	rm->direct = rm->planar && rm->in_channels == rm->out_channels;
+
+	for (size_t dst = 0; dst < rm->out_channels; dst++) {
+		struct remix_row *row = &rm->rows[dst];
+
+		for (size_t src = 0; src < rm->in_channels; src++) {
+			if (m.coef[dst][src] == 0.0f)
+				continue;
+
+			row->src[row->count]  = src;
+			row->coef[row->count] = m.coef[dst][src];
+			row->count++;
+		}
+
+		if (row->count != 1 || row->src[0] != dst ||
+		    row->coef[0] != 1.0f)
+			rm->direct = false;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+/* sample conversion kernels, all writing n contiguous floats */
+
+static void convert_u8(float *out, const uint8_t *in, size_t n)
+{
+	for (size_t i = 0; i < n; i++)
+		out[i] = ((float)in[i] - 128.0f) * (1.0f / 128.0f);
+}
+
+static void convert_s16(float *out, const int16_t *in, size_t n)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+	size_t i = 0;
+
+	for (; i + 8 <= n; i += 8) {
+		__m128i val = _mm_loadu_si128((const __m128i*)(in + i));
+		__m128i lo  = _mm_srai_epi32(_mm_unpacklo_epi16(val, val), 16);
+		__m128i hi  = _mm_srai_epi32(_mm_unpackhi_epi16(val, val), 16);
+
+		_mm_storeu_ps(out + i,     _mm_mul_ps(_mm_cvtepi32_ps(lo), scale));
+		_mm_storeu_ps(out + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(hi), scale));
+	}
+
+	for (; i < n; i++)
+		out[i] = (float)in[i] * (1.0f / 32768.0f);
+}
+
+static void convert_s32(float *out, const int32_t *in, size_t n)
+{
+	const __m128 scale = _mm_set1_ps(1.0f / 2147483648.0f);
+	size_t i = 0;
+
+	for (; i + 4 <= n; i += 4) {
+		__m128i val = _mm_loadu_si128((const __m128i*)(in + i));
+		_mm_storeu_ps(out + i, _mm_mul_ps(_mm_cvtepi32_ps(val), scale));
+	}
+
+	for (; i < n; i++)
+		out[i] = (float)in[i] * (1.0f / 2147483648.0f);
+}
+
+static void convert_samples(enum audio_format format, float *out,
+		const uint8_t *in, size_t n)
+{
+	switch (format) {
+	case AUDIO_FORMAT_U8BIT:
+	case AUDIO_FORMAT_U8BIT_PLANAR:
+		convert_u8(out, in, n);
+		break;
+	case AUDIO_FORMAT_16BIT:
+	case AUDIO_FORMAT_16BIT_PLANAR:
+		convert_s16(out, (const int16_t*)in, n);
+		break;
+	case AUDIO_FORMAT_32BIT:
+	case AUDIO_FORMAT_32BIT_PLANAR:
+		convert_s32(out, (const int32_t*)in, n);
+		break;
+	case AUDIO_FORMAT_FLOAT:
+	case AUDIO_FORMAT_FLOAT_PLANAR:
+		memcpy(out, in, n * sizeof(float));
+		break;
+	case AUDIO_FORMAT_UNKNOWN:
+		break;
+	}
+}
+
+static inline bool is_float_format(enum audio_format format)
+{
+	return format == AUDIO_FORMAT_FLOAT ||
+	       format == AUDIO_FORMAT_FLOAT_PLANAR;
+}
+
+/* points src at n float frames of each input channel starting at offset,
+ * converting into the scratch planes where needed */
+static void get_source_block(struct audio_remixer *rm,
+		const uint8_t *const input[], size_t offset, size_t n,
+		const float *src[])
+{
+	const size_t bpc = get_audio_bytes_per_channel(rm->format);
+	const size_t channels = rm->in_channels;
+	const float *interleaved;
+
+	if (rm->planar) {
+		for (size_t c = 0; c < channels; c++) {
+			const uint8_t *in = input[c] + offset * bpc;
+
+			if (is_float_format(rm->format)) {
+				src[c] = (const float*)in;
+			} else {
+				convert_samples(rm->format, rm->scratch[c],
+						in, n);
+				src[c] = rm->scratch[c];
+			}
+		}
+		return;
+	}
+
+	if (is_float_format(rm->format)) {
+		interleaved = (const float*)(input[0] + offset * channels * bpc);
+	} else {
+		convert_samples(rm->format, rm->interleaved,
+				input[0] + offset * channels * bpc,
+				n * channels);
+		interleaved = rm->interleaved;
+	}
+
+	for (size_t c = 0; c < channels; c++) {
+		float *plane = rm->scratch[c];
+
+		for (size_t i = 0; i < n; i++)
+			plane[i] = interleaved[i * channels + c];
+		src[c] = plane;
+	}
+}
+
+static void mix_row(const struct remix_row *row, const float *const src[],
+		float *out, size_t n)
+{
+	size_t i = 0;
+
+	if (!row->count) {
+		memset(out, 0, n * sizeof(float));
+		return;
+	}
+
+	if (row->count == 1 && row->coef[0] == 1.0f) {
+		memcpy(out, src[row->src[0]], n * sizeof(float));
+		return;
+	}
+
+	for (; i + 4 <= n; i += 4) {
+		__m128 sum = _mm_mul_ps(_mm_loadu_ps(src[row->src[0]] + i),
+				_mm_set1_ps(row->coef[0]));
+
+		for (size_t k = 1; k < row->count; k++)
+			sum = _mm_add_ps(sum, _mm_mul_ps(
+					_mm_loadu_ps(src[row->src[k]] + i),
+					_mm_set1_ps(row->coef[k])));
+
+		_mm_storeu_ps(out + i, sum);
+	}
+
+	for (; i < n; i++) {
+		float sum = 0.0f;
+
+		for (size_t k = 0; k < row->count; k++)
+			sum += src[row->src[k]][i] * row->coef[k];
+		out[i] = sum;
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+audio_remixer_t *audio_remixer_create(const struct resample_info *dst,
+		const struct resample_info *src)
+{
+	struct audio_remixer *rm;
+	enum speaker src_spk[MAX_AV_PLANES];
+	enum speaker dst_spk[MAX_AV_PLANES];
+	size_t in_channels, out_channels;
+
+	if (src->samples_per_sec != dst->samples_per_sec ||
+	    src->format == AUDIO_FORMAT_UNKNOWN ||
+	    dst->format != AUDIO_FORMAT_FLOAT_PLANAR)
+		return NULL;
+
+	in_channels  = get_speakers(src->speakers, src_spk);
+	out_channels = get_speakers(dst->speakers, dst_spk);
+	if (!in_channels || !out_channels)
+		return NULL;
+
+	rm = bzalloc(sizeof(struct audio_remixer));
+	rm->format       = src->format;
+	rm->planar       = is_audio_planar(src->format);
+	rm->in_channels  = in_channels;
+	rm->out_channels = out_channels;
+
+	build_rows(rm, src_spk, dst_spk);
+	return rm;
+}
+
+void audio_remixer_destroy(audio_remixer_t *rm)
+{
+	bfree(rm);
+}
+
+void audio_remixer_remix(audio_remixer_t *rm, uint8_t *const output[],
+		const uint8_t *const input[], uint32_t frames)
+{
+	if (!rm)
+		return;
+
+	/* same layout from planar input: convert straight into the output */
+	if (rm->direct) {
+		for (size_t c = 0; c < rm->out_channels; c++)
+			convert_samples(rm->format, (float*)output[c],
+					input[c], frames);
+		return;
+	}
+
+	for (size_t offset = 0; offset < frames; offset += REMIX_BLOCK) {
+		const float *src[MAX_AV_PLANES];
+		size_t n = frames - offset;
+
+		if (n > REMIX_BLOCK)
+			n = REMIX_BLOCK;
+
+		get_source_block(rm, input, offset, n, src);
+
+		for (size_t c = 0; c < rm->out_channels; c++)
+			mix_row(&rm->rows[c], src,
+					(float*)output[c] + offset, n);
+	}
+}
+
+void audio_downmix_to_mono_planar(float *const data[], size_t channels,
+		uint32_t frames)
+{
+	const float channels_i = 1.0f / (float)channels;
+	const __m128 scale = _mm_set1_ps(channels_i);
+	uint32_t frame = 0;
+
+	for (; frame + 4 <= frames; frame += 4) {
+		__m128 sum = _mm_loadu_ps(data[0] + frame);
+
+		for (size_t c = 1; c < channels; c++)
+			sum = _mm_add_ps(sum, _mm_loadu_ps(data[c] + frame));
+
+		sum = _mm_mul_ps(sum, scale);
+
+		for (size_t c = 0; c < channels; c++)
+			_mm_storeu_ps(data[c] + frame, sum);
+	}
+
+	for (; frame < frames; frame++) {
+		float sum = data[0][frame];
+
+		for (size_t c = 1; c < channels; c++)
+			sum += data[c][frame];
+
+		sum *= channels_i;
+
+		for (size_t c = 0; c < channels; c++)
+			data[c][frame] = sum;
+	}
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include "../util/c99defs.h"
+#include "audio-resampler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*
+ * Channel layout and sample format conversion without resampling.  Used in
+ * place of the audio resampler when only the layout or the format differs,
+ * converting to float and remixing in a single pass.
+ */
+
+struct audio_remixer;
+typedef struct audio_remixer audio_remixer_t;
+
+/**
+ * Creates a remixer, or returns NULL if the conversion isn't supported (the
+ * sample rates differ, a layout is unknown, or the destination format isn't
+ * planar float), in which case the audio resampler should be used instead.
+ */
+EXPORT audio_remixer_t *audio_remixer_create(const struct resample_info *dst,
+		const struct resample_info *src);
+EXPORT void audio_remixer_destroy(audio_remixer_t *remixer);
+
+/** Converts frames of input into the caller's output planes */
+EXPORT void audio_remixer_remix(audio_remixer_t *remixer,
+		uint8_t *const output[], const uint8_t *const input[],
+		uint32_t frames);
+
+/** Averages all planes of planar float audio and writes it to every plane */
+EXPORT void audio_downmix_to_mono_planar(float *const data[], size_t channels,
+		uint32_t frames);
+
+#ifdef __cplusplus
+}
+#endif
@@ -32,6 +32,14 @@
 struct cached_frame_info {
 	struct video_data frame;
 	int count;
+
+	/* frame memory owned by the cache */
+	struct video_frame buffer;
+
+	/* set if the frame data is lent by the caller instead of copied into
+	 * the buffer; called once every input has received the frame */
+	void (*release)(void *param);
+	void *release_param;
 };
 
 struct video_input {
@@ -107,6 +115,15 @@ static inline bool scale_video_output(struct video_input *input,
 	return success;
 }
 
+static inline void release_lent_frame(struct cached_frame_info *frame_info)
+{
+	if (frame_info->release) {
+		frame_info->release(frame_info->release_param);
+		frame_info->release = NULL;
+		frame_info->release_param = NULL;
+	}
+}
+
 static inline bool video_output_cur_frame(struct video_output *video)
 {
 	struct cached_frame_info *frame_info;
@@ -142,6 +159,8 @@ static inline bool video_output_cur_frame(struct video_output *video)
 	complete = --frame_info->count == 0;
 
 	if (complete) {
+		release_lent_frame(frame_info);
+
 		if (++video->first_added == video->info.cache_size)
 			video->first_added = 0;
 
@@ -191,10 +210,9 @@ static inline void init_cache(struct video_output *video)
 		video->info.cache_size = MAX_CACHE_SIZE;
 
 	for (size_t i = 0; i < video->info.cache_size; i++) {
-		struct video_frame *frame;
-		frame = (struct video_frame*)&video->cache[i];
+		struct cached_frame_info *cfi = &video->cache[i];
 
-		video_frame_init(frame, video->info.format,
+		video_frame_init(&cfi->buffer, video->info.format,
 				video->info.width, video->info.height);
 	}
 
@@ -253,8 +271,10 @@ void video_output_close(video_t *video)
 		video_input_free(&video->inputs.array[i]);
 	da_free(video->inputs);
 
-	for (size_t i = 0; i < video->info.cache_size; i++)
-		video_frame_free((struct video_frame*)&video->cache[i]);
+	for (size_t i = 0; i < video->info.cache_size; i++) {
+		release_lent_frame(&video->cache[i]);
+		video_frame_free(&video->cache[i].buffer);
+	}
 
 	os_sem_destroy(video->update_semaphore);
 	pthread_mutex_destroy(&video->data_mutex);
@@ -382,38 +402,79 @@ const struct video_output_info *video_output_get_info(const video_t *video)
 	return video ? &video->info : NULL;
 }
 
+/* must be called with data_mutex locked */
+static struct cached_frame_info *next_cache_entry(struct video_output *video,
+		int count, uint64_t timestamp)
+{
+	struct cached_frame_info *cfi;
+
+	if (video->available_frames == 0) {
+		video->cache[video->last_added].count += count;
+		return NULL;
+	}
+
+	if (video->available_frames != video->info.cache_size) {
+		if (++video->last_added == video->info.cache_size)
+			video->last_added = 0;
+	}
+
+	cfi = &video->cache[video->last_added];
+	cfi->frame.timestamp = timestamp;
+	cfi->count = count;
+	return cfi;
+}
+
 bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		int count, uint64_t timestamp)
 {
 	struct cached_frame_info *cfi;
-	bool locked;
 
 	if (!video) return false;
 
 	pthread_mutex_lock(&video->data_mutex);
 
-	if (video->available_frames == 0) {
-		video->cache[video->last_added].count += count;
-		locked = false;
-
-	} else {
-		if (video->available_frames != video->info.cache_size) {
-			if (++video->last_added == video->info.cache_size)
-				video->last_added = 0;
+	cfi = next_cache_entry(video, count, timestamp);
+	if (cfi) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			cfi->frame.data[i]     = cfi->buffer.data[i];
+			cfi->frame.linesize[i] = cfi->buffer.linesize[i];
 		}
 
-		cfi = &video->cache[video->last_added];
-		cfi->frame.timestamp = timestamp;
-		cfi->count = count;
-
 		memcpy(frame, &cfi->frame, sizeof(*frame));
+	}
+
+	pthread_mutex_unlock(&video->data_mutex);
+
+	return cfi != NULL;
+}
 
-		locked = true;
+bool video_output_lend_frame(video_t *video, const struct video_frame *frame,
+		int count, uint64_t timestamp,
+		void (*release)(void *param), void *param)
+{
+	struct cached_frame_info *cfi;
+
+	if (!video || !release) return false;
+
+	pthread_mutex_lock(&video->data_mutex);
+
+	cfi = next_cache_entry(video, count, timestamp);
+	if (cfi) {
+		for (size_t i = 0; i < MAX_AV_PLANES; i++) {
+			cfi->frame.data[i]     = frame->data[i];
+			cfi->frame.linesize[i] = frame->linesize[i];
+		}
+
+		cfi->release       = release;
+		cfi->release_param = param;
+
+		video->available_frames--;
+		os_sem_post(video->update_semaphore);
 	}
 
 	pthread_mutex_unlock(&video->data_mutex);
 
-	return locked;
+	return cfi != NULL;
 }
 
 void video_output_unlock_frame(video_t *video)
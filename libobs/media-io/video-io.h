@@ -143,6 +143,19 @@ EXPORT const struct video_output_info *video_output_get_info(
 EXPORT bool video_output_lock_frame(video_t *video, struct video_frame *frame,
 		int count, uint64_t timestamp);
 EXPORT void video_output_unlock_frame(video_t *video);
+
+/**
+ * Queues a frame without copying it.  The frame's planes must stay valid
+ * until release is called, which happens on the video thread once every
+ * input has received the frame, or when the output is closed.
+ *
+ * Returns false if the cache is full, in which case the frame was not
+ * queued (the previous frame is repeated instead) and release will not be
+ * called.
+ */
+EXPORT bool video_output_lend_frame(video_t *video,
+		const struct video_frame *frame, int count, uint64_t timestamp,
+		void (*release)(void *param), void *param);
 EXPORT uint64_t video_output_get_frame_time(const video_t *video);
 EXPORT void video_output_stop(video_t *video);
 EXPORT bool video_output_stopped(video_t *video);
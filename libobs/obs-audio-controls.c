@@ -16,6 +16,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 */
 
 #include <math.h>
+#include <string.h>
+#include <xmmintrin.h>
 
 #include "util/threading.h"
 #include "util/bmem.h"
@@ -33,6 +35,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 typedef float (*obs_fader_conversion_t)(const float val);
 
+/* momentary loudness is measured over 400 ms, see ITU-R BS.1770 */
+#define LOUDNESS_WINDOW_MS  400
+#define MAX_LOUDNESS_BLOCKS 40
+#define KW_PI               3.14159265358979323846
+
+struct volmeter_biquad {
+	double b0, b1, b2;
+	double a1, a2;
+};
+
 struct obs_fader {
 	pthread_mutex_t        mutex;
 	signal_handler_t       *signals;
@@ -55,6 +67,9 @@ struct obs_volmeter {
 	enum obs_fader_type    type;
 	float                  cur_db;
 
+	bool                   mix_attached;
+	size_t                 mix_idx;
+
 	unsigned int           channels;
 	unsigned int           update_ms;
 	unsigned int           update_frames;
@@ -65,10 +80,27 @@ struct obs_volmeter {
 	unsigned int           ival_frames;
 	float                  ival_sum;
 	float                  ival_max;
+	double                 ival_loud;
 
 	float                  vol_peak;
 	float                  vol_mag;
 	float                  vol_max;
+	float                  vol_loudness;
+
+	/* K-weighting: shelf and high pass stage with per channel state */
+	struct volmeter_biquad kw_filter[2];
+	double                 kw_state[MAX_AV_PLANES][2][2];
+	float                  kw_weight[MAX_AV_PLANES];
+
+	unsigned int           loudness_blocks;
+	unsigned int           loudness_idx;
+	double                 loudness_block[MAX_LOUDNESS_BLOCKS];
+
+	/* double buffered levels for obs_volmeter_get_levels, the writer
+	 * fills the slot readers aren't looking at and then bumps the
+	 * sequence to publish it */
+	volatile long          levels_seq;
+	volatile struct obs_volmeter_levels levels[2];
 };
 
 static const char *fader_signals[] = {
@@ -283,26 +315,103 @@ static void volmeter_source_destroyed(void *vptr, calldata_t *calldata)
 	obs_volmeter_detach_source(volmeter);
 }
 
-/* TODO: Separate for individual channels */
-static void volmeter_sum_and_max(float *data[MAX_AV_PLANES], size_t frames,
+static inline void sum_and_max_plane(const float *data, size_t frames,
 		float *sum, float *max)
 {
-	float s  = *sum;
-	float m  = *max;
+	__m128 vsum = _mm_setzero_ps();
+	__m128 vmax = _mm_setzero_ps();
+	float  vals[4];
+	float  s, m;
+	size_t i = 0;
+
+	for (; i + 4 <= frames; i += 4) {
+		__m128 pow = _mm_loadu_ps(data + i);
+		pow  = _mm_mul_ps(pow, pow);
+		vsum = _mm_add_ps(vsum, pow);
+		vmax = _mm_max_ps(vmax, pow);
+	}
+
+	_mm_storeu_ps(vals, vsum);
+	s = vals[0] + vals[1] + vals[2] + vals[3];
+	_mm_storeu_ps(vals, vmax);
+	m = fmaxf(fmaxf(vals[0], vals[1]), fmaxf(vals[2], vals[3]));
+
+	for (; i < frames; i++) {
+		const float pow = data[i] * data[i];
+		s += pow;
+		m  = (m > pow) ? m : pow;
+	}
+
+	*sum += s;
+	*max  = (*max > m) ? *max : m;
+}
+
+static inline double biquad_process(const struct volmeter_biquad *f,
+		double z[2], double x)
+{
+	const double y = f->b0 * x + z[0];
+	z[0] = f->b1 * x - f->a1 * y + z[1];
+	z[1] = f->b2 * x - f->a2 * y;
+	return y;
+}
+
+/* returns the sum of squares of the K-weighted signal of one channel */
+static double kweight_sum(obs_volmeter_t *volmeter, size_t channel,
+		const float *data, size_t frames)
+{
+	double (*z)[2] = volmeter->kw_state[channel];
+	double sum = 0.0;
+
+	for (size_t i = 0; i < frames; i++) {
+		double y = biquad_process(&volmeter->kw_filter[0], z[0],
+				data[i]);
+		y = biquad_process(&volmeter->kw_filter[1], z[1], y);
+		sum += y * y;
+	}
+
+	/* keep silence from decaying the state into denormals */
+	for (size_t i = 0; i < 2; i++) {
+		if (fabs(z[i][0]) < 1e-20) z[i][0] = 0.0;
+		if (fabs(z[i][1]) < 1e-20) z[i][1] = 0.0;
+	}
+
+	return sum;
+}
 
+/* TODO: Separate for individual channels */
+static void volmeter_sum_and_max(obs_volmeter_t *volmeter,
+		float *data[MAX_AV_PLANES], size_t frames)
+{
 	for (size_t plane = 0; plane < MAX_AV_PLANES; plane++) {
 		if (!data[plane])
 			break;
 
-		for (float *c = data[plane]; c < data[plane] + frames; ++c) {
-			const float pow = *c * *c;
-			s += pow;
-			m  = (m > pow) ? m : pow;
-		}
+		sum_and_max_plane(data[plane], frames, &volmeter->ival_sum,
+				&volmeter->ival_max);
+
+		if (plane < volmeter->channels && volmeter->kw_weight[plane])
+			volmeter->ival_loud += volmeter->kw_weight[plane] *
+				kweight_sum(volmeter, plane, data[plane],
+						frames);
 	}
+}
+
+static void volmeter_calc_loudness(obs_volmeter_t *volmeter)
+{
+	double mean = 0.0;
+
+	volmeter->loudness_block[volmeter->loudness_idx] =
+		volmeter->ival_loud / (double)volmeter->ival_frames;
+	volmeter->loudness_idx =
+		(volmeter->loudness_idx + 1) % volmeter->loudness_blocks;
 
-	*sum = s;
-	*max = m;
+	for (unsigned int i = 0; i < volmeter->loudness_blocks; i++)
+		mean += volmeter->loudness_block[i];
+	mean /= (double)volmeter->loudness_blocks;
+
+	volmeter->vol_loudness = (mean > 0.0)
+		? (float)(-0.691 + 10.0 * log10(mean))
+		: -INFINITY;
 }
 
 /**
@@ -335,10 +444,13 @@ static void volmeter_calc_ival_levels(obs_volmeter_t *volmeter)
 	volmeter->vol_mag = alpha * ival_rms +
 			volmeter->vol_mag * (1.0f - alpha);
 
+	volmeter_calc_loudness(volmeter);
+
 	/* reset interval data */
 	volmeter->ival_frames = 0;
 	volmeter->ival_sum    = 0.0f;
 	volmeter->ival_max    = 0.0f;
+	volmeter->ival_loud   = 0.0;
 }
 
 static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
@@ -358,8 +470,7 @@ static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
 			? volmeter->update_frames - volmeter->ival_frames
 			: left;
 
-		volmeter_sum_and_max(adata, frames, &volmeter->ival_sum,
-				&volmeter->ival_max);
+		volmeter_sum_and_max(volmeter, adata, frames);
 
 		volmeter->ival_frames += (unsigned int)frames;
 		left                  -= frames;
@@ -381,16 +492,31 @@ static bool volmeter_process_audio_data(obs_volmeter_t *volmeter,
 	return updated;
 }
 
-static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
+static void volmeter_publish_levels(obs_volmeter_t *volmeter,
+		float level, float mag, float peak, float loudness)
+{
+	const long seq = volmeter->levels_seq;
+	volatile struct obs_volmeter_levels *levels =
+		&volmeter->levels[(seq + 1) & 1];
+
+	levels->level     = level;
+	levels->magnitude = mag;
+	levels->peak      = peak;
+	levels->loudness  = loudness;
+	levels->updates   = (uint64_t)seq + 1;
+
+	os_atomic_inc_long(&volmeter->levels_seq);
+}
+
+static void volmeter_audio_data(obs_volmeter_t *volmeter,
+		struct audio_data *data)
 {
-	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
 	bool updated = false;
 	float mul, level, mag, peak;
 	signal_handler_t *sh;
 
 	pthread_mutex_lock(&volmeter->mutex);
 
-	struct audio_data *data = calldata_ptr(calldata, "data");
 	updated = volmeter_process_audio_data(volmeter, data);
 
 	if (updated) {
@@ -401,6 +527,9 @@ static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
 		peak  = volmeter->db_to_pos(
 				mul_to_db(volmeter->vol_peak * mul));
 		sh    = volmeter->signals;
+
+		volmeter_publish_levels(volmeter, level, mag, peak,
+				volmeter->vol_loudness + volmeter->cur_db);
 	}
 
 	pthread_mutex_unlock(&volmeter->mutex);
@@ -409,14 +538,116 @@ static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
 		signal_levels_updated(sh, volmeter, level, mag, peak);
 }
 
+static void volmeter_source_data_received(void *vptr, calldata_t *calldata)
+{
+	struct obs_volmeter *volmeter = (struct obs_volmeter *) vptr;
+	volmeter_audio_data(volmeter, calldata_ptr(calldata, "data"));
+}
+
+static void volmeter_mix_data_received(void *param, size_t mix_idx,
+		struct audio_data *data)
+{
+	UNUSED_PARAMETER(mix_idx);
+	volmeter_audio_data(param, data);
+}
+
+/* filter coefficients of the two K-weighting stages from ITU-R BS.1770,
+ * re-derived for the output sample rate */
+static void volmeter_init_kweighting(obs_volmeter_t *volmeter,
+		unsigned int sample_rate)
+{
+	struct volmeter_biquad *shelf = &volmeter->kw_filter[0];
+	struct volmeter_biquad *hpf   = &volmeter->kw_filter[1];
+	const double fs = (double)sample_rate;
+	double K, Q, a0;
+
+	/* stage 1: high shelf, +4 dB above ~1.7 kHz */
+	const double vh = pow(10.0, 3.999843853973347 / 20.0);
+	const double vb = pow(vh, 0.4996667741545416);
+
+	K  = tan(KW_PI * 1681.974450955533 / fs);
+	Q  = 0.7071752369554196;
+	a0 = 1.0 + K / Q + K * K;
+
+	shelf->b0 = (vh + vb * K / Q + K * K) / a0;
+	shelf->b1 = 2.0 * (K * K - vh) / a0;
+	shelf->b2 = (vh - vb * K / Q + K * K) / a0;
+	shelf->a1 = 2.0 * (K * K - 1.0) / a0;
+	shelf->a2 = (1.0 - K / Q + K * K) / a0;
+
+	/* stage 2: RLB high pass at ~38 Hz */
+	K  = tan(KW_PI * 38.13547087602444 / fs);
+	Q  = 0.5003270373238773;
+	a0 = 1.0 + K / Q + K * K;
+
+	hpf->b0 = 1.0;
+	hpf->b1 = -2.0;
+	hpf->b2 = 1.0;
+	hpf->a1 = 2.0 * (K * K - 1.0) / a0;
+	hpf->a2 = (1.0 - K / Q + K * K) / a0;
+
+	memset(volmeter->kw_state, 0, sizeof(volmeter->kw_state));
+}
+
+/* LFE doesn't count towards loudness and surrounds are weighted +1.5 dB */
+static void volmeter_init_channel_weights(obs_volmeter_t *volmeter,
+		enum speaker_layout speakers)
+{
+	float *w = volmeter->kw_weight;
+
+	for (size_t i = 0; i < MAX_AV_PLANES; i++)
+		w[i] = 1.0f;
+
+	switch (speakers) {
+	case SPEAKERS_2POINT1:
+		/* FL/FR/BC, the third channel is back center, not LFE */
+		w[2] = 1.41f;
+		break;
+	case SPEAKERS_QUAD:
+		w[2] = w[3] = 1.41f;
+		break;
+	case SPEAKERS_4POINT1:
+		w[3] = 0.0f;
+		w[4] = 1.41f;
+		break;
+	case SPEAKERS_5POINT1:
+	case SPEAKERS_5POINT1_SURROUND:
+	case SPEAKERS_7POINT1:
+	case SPEAKERS_7POINT1_SURROUND:
+		w[3] = 0.0f;
+		for (size_t i = 4; i < MAX_AV_PLANES; i++)
+			w[i] = 1.41f;
+		break;
+	default:
+		break;
+	}
+}
+
 static void volmeter_update_audio_settings(obs_volmeter_t *volmeter)
 {
 	audio_t *audio            = obs_get_audio();
+	const struct audio_output_info *info = audio_output_get_info(audio);
 	const unsigned int sr     = audio_output_get_sample_rate(audio);
+	unsigned int blocks;
 
 	volmeter->channels        = (uint32_t)audio_output_get_channels(audio);
 	volmeter->update_frames   = volmeter->update_ms * sr / 1000;
 	volmeter->peakhold_frames = volmeter->peakhold_ms * sr / 1000;
+
+	blocks = LOUDNESS_WINDOW_MS / volmeter->update_ms;
+	if (blocks < 1)
+		blocks = 1;
+	else if (blocks > MAX_LOUDNESS_BLOCKS)
+		blocks = MAX_LOUDNESS_BLOCKS;
+
+	volmeter->loudness_blocks = blocks;
+	volmeter->loudness_idx    = 0;
+	volmeter->vol_loudness    = -INFINITY;
+	memset(volmeter->loudness_block, 0, sizeof(volmeter->loudness_block));
+
+	volmeter_init_kweighting(volmeter, sr);
+	volmeter_init_channel_weights(volmeter,
+			info ? info->speakers : SPEAKERS_UNKNOWN);
 }
 
 obs_fader_t *obs_fader_create(enum obs_fader_type type)
@@ -700,12 +931,20 @@ bool obs_volmeter_attach_source(obs_volmeter_t *volmeter, obs_source_t *source)
 void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 {
 	signal_handler_t *sh;
+	bool detach_mix = false;
+	size_t mix_idx = 0;
 
 	if (!volmeter)
 		return;
 
 	pthread_mutex_lock(&volmeter->mutex);
 
+	if (volmeter->mix_attached) {
+		detach_mix = true;
+		mix_idx    = volmeter->mix_idx;
+		volmeter->mix_attached = false;
+	}
+
 	if (!volmeter->source)
 		goto exit;
 
@@ -721,6 +960,38 @@ void obs_volmeter_detach_source(obs_volmeter_t *volmeter)
 
 exit:
 	pthread_mutex_unlock(&volmeter->mutex);
+
+	/* mix data is delivered with the output's input mutex held, so this
+	 * must not be called with the volume meter locked */
+	if (detach_mix)
+		audio_output_disconnect(obs_get_audio(), mix_idx,
+				volmeter_mix_data_received, volmeter);
+}
+
+bool obs_volmeter_attach_mix(obs_volmeter_t *volmeter, size_t mix_idx)
+{
+	bool success;
+
+	if (!volmeter || mix_idx >= MAX_AUDIO_MIXES)
+		return false;
+
+	obs_volmeter_detach_source(volmeter);
+
+	pthread_mutex_lock(&volmeter->mutex);
+	volmeter->cur_db       = 0.0f;
+	volmeter->mix_idx      = mix_idx;
+	volmeter->mix_attached = true;
+	pthread_mutex_unlock(&volmeter->mutex);
+
+	success = audio_output_connect(obs_get_audio(), mix_idx, NULL,
+			volmeter_mix_data_received, volmeter);
+	if (!success) {
+		pthread_mutex_lock(&volmeter->mutex);
+		volmeter->mix_attached = false;
+		pthread_mutex_unlock(&volmeter->mutex);
+	}
+
+	return success;
 }
 
 signal_handler_t *obs_volmeter_get_signal_handler(obs_volmeter_t *volmeter)
@@ -728,6 +999,27 @@ signal_handler_t *obs_volmeter_get_signal_handler(obs_volmeter_t *volmeter)
 	return (volmeter) ? volmeter->signals : NULL;
 }
 
+bool obs_volmeter_get_levels(obs_volmeter_t *volmeter,
+		struct obs_volmeter_levels *levels)
+{
+	long seq;
+
+	if (!volmeter || !levels)
+		return false;
+
+	/* the slot being read only gets rewritten after the writer has
+	 * published the other one, so retry if the sequence moved */
+	do {
+		seq = volmeter->levels_seq;
+		if (!seq)
+			return false;
+
+		*levels = volmeter->levels[seq & 1];
+	} while (seq != volmeter->levels_seq);
+
+	return true;
+}
+
 void obs_volmeter_set_update_interval(obs_volmeter_t *volmeter,
 		const unsigned int ms)
 {
@@ -200,6 +200,18 @@ EXPORT bool obs_volmeter_attach_source(obs_volmeter_t *volmeter,
  */
 EXPORT void obs_volmeter_detach_source(obs_volmeter_t *volmeter);
 
+/**
+ * @brief Attach the volume meter to one of the audio output mixes
+ * @param volmeter pointer to the volume meter object
+ * @param mix_idx index of the mix
+ * @return true on success
+ *
+ * The meter then measures the mixed audio of all sources assigned to the
+ * mix.  obs_volmeter_detach_source detaches it again.  Like an output, an
+ * attached meter keeps the audio settings from being reset.
+ */
+EXPORT bool obs_volmeter_attach_mix(obs_volmeter_t *volmeter, size_t mix_idx);
+
 /**
  * @brief Get signal handler for the volume meter object
  * @param volmeter pointer to the volume meter object
@@ -251,6 +263,37 @@ EXPORT void obs_volmeter_set_peak_hold(obs_volmeter_t *volmeter,
  */
 EXPORT unsigned int obs_volmeter_get_peak_hold(obs_volmeter_t *volmeter);
 
+/**
+ * @brief Levels published by a volume meter
+ *
+ * level, magnitude and peak are the values sent with the levels_updated
+ * signal, already mapped to [0.0f, 1.0f].  loudness is the momentary
+ * loudness (ITU-R BS.1770, 400 ms window) in LUFS including the source
+ * volume, or -INFINITY for silence.
+ */
+struct obs_volmeter_levels {
+	float    level;
+	float    magnitude;
+	float    peak;
+	float    loudness;
+
+	/** incremented every time new levels are published */
+	uint64_t updates;
+};
+
+/**
+ * @brief Get the most recent levels of the volume meter
+ * @param volmeter pointer to the volume meter object
+ * @param levels receives the levels
+ * @return true on success, false if there are no levels yet
+ *
+ * This does not lock and can be called from any thread at any rate, which
+ * makes it the preferred way of driving a meter from a GUI timer instead of
+ * handling the levels_updated signal.
+ */
+EXPORT bool obs_volmeter_get_levels(obs_volmeter_t *volmeter,
+		struct obs_volmeter_levels *levels);
+
 #ifdef __cplusplus
 }
 #endif
@@ -132,6 +132,34 @@ static void serialize_avc_data(struct serializer *s, const uint8_t *data,
 	}
 }
 
+/* the encoder already told us where its NAL units are, so there's no need to
+ * look for start codes, and the exact output size is known up front */
+static void serialize_avc_nals(struct serializer *s,
+		struct array_output_data *output,
+		const struct encoder_packet *src,
+		bool *is_keyframe, int *priority)
+{
+	size_t total = 0;
+
+	for (size_t i = 0; i < src->num_nals; i++)
+		total += src->nals[i].size + 4;
+
+	da_reserve(output->bytes, total);
+
+	for (size_t i = 0; i < src->num_nals; i++) {
+		const struct encoder_packet_nal *nal = src->nals+i;
+
+		if (nal->type == OBS_NAL_SLICE_IDR ||
+		    nal->type == OBS_NAL_SLICE) {
+			*is_keyframe = (nal->type == OBS_NAL_SLICE_IDR);
+			*priority    = nal->priority;
+		}
+
+		s_wb32(s, nal->size);
+		s_write(s, src->data + nal->offset, nal->size);
+	}
+}
+
 void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 		const struct encoder_packet *src)
 {
@@ -141,9 +169,15 @@ void obs_parse_avc_packet(struct encoder_packet *avc_packet,
 	array_output_serializer_init(&s, &output);
 	*avc_packet = *src;
 
-	serialize_avc_data(&s, src->data, src->size, &avc_packet->keyframe,
-			&avc_packet->priority);
+	if (src->num_nals)
+		serialize_avc_nals(&s, &output, src, &avc_packet->keyframe,
+				&avc_packet->priority);
+	else
+		serialize_avc_data(&s, src->data, src->size,
+				&avc_packet->keyframe, &avc_packet->priority);
 
+	avc_packet->nals          = NULL;
+	avc_packet->num_nals      = 0;
 	avc_packet->data          = output.bytes.array;
 	avc_packet->size          = output.bytes.num;
 	avc_packet->drop_priority = get_drop_priority(avc_packet->priority);
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include "graphics/vec4.h"
+#include "util/platform.h"
 #include "obs.h"
 #include "obs-internal.h"
 
@@ -97,6 +98,18 @@ void obs_display_destroy(obs_display_t *display)
 	}
 }
 
+void obs_display_set_max_fps(obs_display_t *display, uint32_t fps)
+{
+	if (!display) return;
+
+	pthread_mutex_lock(&display->draw_callbacks_mutex);
+
+	display->min_interval_ns = fps ? 1000000000ULL / fps : 0;
+	display->next_render_ns  = 0;
+
+	pthread_mutex_unlock(&display->draw_callbacks_mutex);
+}
+
 void obs_display_resize(obs_display_t *display, uint32_t cx, uint32_t cy)
 {
 	if (!display) return;
@@ -168,10 +181,39 @@ static inline void render_display_end()
 	gs_present();
 }
 
+/* allow a display to render slightly early so that a limit which divides
+ * the video frame rate doesn't get rounded down by timing jitter */
+#define DISPLAY_LIMIT_TOLERANCE_NS 2000000ULL
+
+static bool display_limit_reached(struct obs_display *display)
+{
+	uint64_t interval = display->min_interval_ns;
+	uint64_t now;
+
+	if (!interval)
+		return false;
+
+	now = os_gettime_ns();
+	if (now + DISPLAY_LIMIT_TOLERANCE_NS < display->next_render_ns)
+		return true;
+
+	display->next_render_ns += interval;
+	if (display->next_render_ns < now)
+		display->next_render_ns = now + interval;
+	return false;
+}
+
 void render_display(struct obs_display *display)
 {
 	if (!display) return;
 
+	pthread_mutex_lock(&display->draw_callbacks_mutex);
+	if (display_limit_reached(display)) {
+		pthread_mutex_unlock(&display->draw_callbacks_mutex);
+		return;
+	}
+	pthread_mutex_unlock(&display->draw_callbacks_mutex);
+
 	render_display_begin(display);
 
 	pthread_mutex_lock(&display->draw_callbacks_mutex);
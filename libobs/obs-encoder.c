@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include "obs.h"
 #include "obs-internal.h"
 
@@ -39,15 +40,28 @@ const char *obs_encoder_get_display_name(const char *id)
 static bool init_encoder(struct obs_encoder *encoder, const char *name,
 		obs_data_t *settings)
 {
+	pthread_mutexattr_t attr;
+
 	pthread_mutex_init_value(&encoder->callbacks_mutex);
 	pthread_mutex_init_value(&encoder->outputs_mutex);
+	pthread_mutex_init_value(&encoder->audio_buffer_mutex);
 
 	if (!obs_context_data_init(&encoder->context, settings, name))
 		return false;
-	if (pthread_mutex_init(&encoder->callbacks_mutex, NULL) != 0)
+
+	/* recursive, an output can be stopped from its packet callback */
+	if (pthread_mutexattr_init(&attr) != 0)
+		return false;
+	if (pthread_mutexattr_settype(&attr, PTHREAD_MUTEX_RECURSIVE) != 0)
+		return false;
+	if (pthread_mutex_init(&encoder->callbacks_mutex, &attr) != 0)
 		return false;
 	if (pthread_mutex_init(&encoder->outputs_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&encoder->audio_buffer_mutex, NULL) != 0)
+		return false;
+	if (pthread_cond_init(&encoder->stop_cond, NULL) != 0)
+		return false;
 
 	if (encoder->info.get_defaults)
 		encoder->info.get_defaults(encoder->context.settings);
@@ -100,6 +114,9 @@ obs_encoder_t *obs_audio_encoder_create(const char *id, const char *name,
 
 static void receive_video(void *param, struct video_data *frame);
 static void receive_audio(void *param, size_t mix_idx, struct audio_data *data);
+static void drain_encoder(struct obs_encoder *encoder);
+static void process_audio(void *param);
+static void wait_for_pending_stop(struct obs_encoder *encoder);
 
 static inline struct audio_convert_info *get_audio_info(
 		const struct obs_encoder *encoder,
@@ -148,6 +165,10 @@ static void add_connection(struct obs_encoder *encoder)
 	struct audio_convert_info audio_info = {0};
 	struct video_scale_info   video_info = {0};
 
+	encoder->encode_time_total = 0;
+	encoder->encode_time_max   = 0;
+	encoder->encode_count      = 0;
+
 	if (encoder->info.type == OBS_ENCODER_AUDIO) {
 		get_audio_info(encoder, &audio_info);
 		audio_output_connect(encoder->media, encoder->mixer_idx,
@@ -212,6 +233,7 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 
 		blog(LOG_INFO, "encoder '%s' destroyed", encoder->context.name);
 
+		obs_audio_workers_unschedule(encoder);
 		free_audio_buffers(encoder);
 
 		if (encoder->context.data)
@@ -219,6 +241,8 @@ static void obs_encoder_actually_destroy(obs_encoder_t *encoder)
 		da_free(encoder->callbacks);
 		pthread_mutex_destroy(&encoder->callbacks_mutex);
 		pthread_mutex_destroy(&encoder->outputs_mutex);
+		pthread_mutex_destroy(&encoder->audio_buffer_mutex);
+		pthread_cond_destroy(&encoder->stop_cond);
 		obs_context_data_free(&encoder->context);
 		bfree(encoder);
 	}
@@ -357,6 +381,8 @@ bool obs_encoder_initialize(obs_encoder_t *encoder)
 	if (encoder->active)
 		return true;
 
+	wait_for_pending_stop(encoder);
+
 	if (encoder->context.data)
 		encoder->info.destroy(encoder->context.data);
 
@@ -398,6 +424,8 @@ void obs_encoder_start(obs_encoder_t *encoder,
 
 	if (!encoder || !new_packet || !encoder->context.data) return;
 
+	wait_for_pending_stop(encoder);
+
 	pthread_mutex_lock(&encoder->callbacks_mutex);
 
 	first = (encoder->callbacks.num == 0);
@@ -414,10 +442,92 @@ void obs_encoder_start(obs_encoder_t *encoder,
 	}
 }
 
+static void log_encode_time(const struct obs_encoder *encoder)
+{
+	double avg;
+
+	if (!encoder->encode_count)
+		return;
+
+	avg = (double)encoder->encode_time_total /
+		(double)encoder->encode_count / 1000000.0;
+
+	blog(LOG_INFO, "encoder '%s': average encode time: %g ms, "
+	               "max: %g ms (%"PRIu32" frames)",
+	               encoder->context.name, avg,
+	               (double)encoder->encode_time_max / 1000000.0,
+	               encoder->encode_count);
+}
+
+static inline bool can_drain(const struct obs_encoder *encoder)
+{
+	return (encoder->info.caps & OBS_ENCODER_CAP_DRAIN) != 0;
+}
+
+/* called once no more frames can arrive, on the thread that encoded the last
+ * of them.  returns true if the encoder was destroyed. */
+static bool finish_stop(struct obs_encoder *encoder,
+		const struct encoder_callback *cb)
+{
+	size_t idx;
+
+	log_encode_time(encoder);
+
+	if (can_drain(encoder)) {
+		drain_encoder(encoder);
+
+		pthread_mutex_lock(&encoder->callbacks_mutex);
+		idx = get_callback_idx(encoder, cb->new_packet, cb->param);
+		if (idx != DARRAY_INVALID)
+			da_erase(encoder->callbacks, idx);
+		pthread_mutex_unlock(&encoder->callbacks_mutex);
+	}
+
+	if (!encoder->destroy_on_stop)
+		return false;
+
+	obs_encoder_actually_destroy(encoder);
+	return true;
+}
+
+/* audio that is scheduled (or being encoded) is left to the worker, which
+ * finishes the stop after it has encoded the frames still buffered.  this
+ * keeps the drain after the last frames, and never waits on a worker that
+ * may be the caller itself or may need a lock the caller holds. */
+static bool defer_stop(struct obs_encoder *encoder,
+		const struct encoder_callback *cb)
+{
+	bool deferred;
+
+	pthread_mutex_lock(&encoder->audio_buffer_mutex);
+
+	deferred = encoder->audio_scheduled;
+	if (deferred) {
+		encoder->stop_pending = true;
+		encoder->stop_cb      = *cb;
+	}
+
+	pthread_mutex_unlock(&encoder->audio_buffer_mutex);
+	return deferred;
+}
+
+static void wait_for_pending_stop(struct obs_encoder *encoder)
+{
+	if (encoder->info.type != OBS_ENCODER_AUDIO)
+		return;
+
+	pthread_mutex_lock(&encoder->audio_buffer_mutex);
+	while (encoder->stop_pending)
+		pthread_cond_wait(&encoder->stop_cond,
+				&encoder->audio_buffer_mutex);
+	pthread_mutex_unlock(&encoder->audio_buffer_mutex);
+}
+
 void obs_encoder_stop(obs_encoder_t *encoder,
 		void (*new_packet)(void *param, struct encoder_packet *packet),
 		void *param)
 {
+	struct encoder_callback cb = {false, new_packet, param};
 	bool   last = false;
 	size_t idx;
 
@@ -427,8 +537,12 @@ void obs_encoder_stop(obs_encoder_t *encoder,
 
 	idx = get_callback_idx(encoder, new_packet, param);
 	if (idx != DARRAY_INVALID) {
-		da_erase(encoder->callbacks, idx);
-		last = (encoder->callbacks.num == 0);
+		last = (encoder->callbacks.num == 1);
+
+		/* the last callback stays registered until the encoder has
+		 * been drained so it still receives the delayed packets */
+		if (!last || !can_drain(encoder))
+			da_erase(encoder->callbacks, idx);
 	}
 
 	pthread_mutex_unlock(&encoder->callbacks_mutex);
@@ -436,8 +550,11 @@ void obs_encoder_stop(obs_encoder_t *encoder,
 	if (last) {
 		remove_connection(encoder);
 
-		if (encoder->destroy_on_stop)
-			obs_encoder_actually_destroy(encoder);
+		if (encoder->info.type == OBS_ENCODER_AUDIO &&
+		    defer_stop(encoder, &cb))
+			return;
+
+		finish_stop(encoder, &cb);
 	}
 }
 
@@ -575,9 +692,13 @@ static void send_first_video_packet(struct obs_encoder *encoder,
 	da_push_back_array(data, sei, size);
 	da_push_back_array(data, packet->data, packet->size);
 
-	first_packet      = *packet;
-	first_packet.data = data.array;
-	first_packet.size = data.num;
+	/* the NAL offsets no longer apply once the SEI has been prepended,
+	 * this only happens once per stream so just let it be rescanned */
+	first_packet          = *packet;
+	first_packet.data     = data.array;
+	first_packet.size     = data.num;
+	first_packet.nals     = NULL;
+	first_packet.num_nals = 0;
 
 	cb->new_packet(cb->param, &first_packet);
 	cb->sent_first_packet = true;
@@ -605,24 +726,32 @@ static void full_stop(struct obs_encoder *encoder)
 	}
 }
 
-static inline void do_encode(struct obs_encoder *encoder,
+static inline bool do_encode(struct obs_encoder *encoder,
 		struct encoder_frame *frame)
 {
 	struct encoder_packet pkt = {0};
 	bool received = false;
 	bool success;
+	uint64_t start_time, encode_time;
 
 	pkt.timebase_num = encoder->timebase_num;
 	pkt.timebase_den = encoder->timebase_den;
 	pkt.encoder = encoder;
 
+	start_time = os_gettime_ns();
 	success = encoder->info.encode(encoder->context.data, frame, &pkt,
 			&received);
+	encode_time = os_gettime_ns() - start_time;
+
+	encoder->encode_time_total += encode_time;
+	encoder->encode_count++;
+	if (encode_time > encoder->encode_time_max)
+		encoder->encode_time_max = encode_time;
 	if (!success) {
 		full_stop(encoder);
 		blog(LOG_ERROR, "Error encoding with encoder '%s'",
 				encoder->context.name);
-		return;
+		return false;
 	}
 
 	if (received) {
@@ -632,14 +761,54 @@ static inline void do_encode(struct obs_encoder *encoder,
 
 		pthread_mutex_lock(&encoder->callbacks_mutex);
 
-		for (size_t i = 0; i < encoder->callbacks.num; i++) {
+		/* in reverse, a callback can stop its output and remove
+		 * itself */
+		for (size_t i = encoder->callbacks.num; i > 0; i--) {
 			struct encoder_callback *cb;
-			cb = encoder->callbacks.array+i;
+			cb = encoder->callbacks.array+(i-1);
 			send_packet(encoder, cb, &pkt);
 		}
 
 		pthread_mutex_unlock(&encoder->callbacks_mutex);
 	}
+
+	return received;
+}
+
+static inline bool has_delayed_frames(struct obs_encoder *encoder)
+{
+	bool failed;
+
+	/* a failed encode clears the callbacks, see full_stop */
+	pthread_mutex_lock(&encoder->callbacks_mutex);
+	failed = !encoder->callbacks.num;
+	pthread_mutex_unlock(&encoder->callbacks_mutex);
+
+	return !failed &&
+		encoder->info.get_delayed_frames(encoder->context.data) > 0;
+}
+
+/* called once the encoder has been disconnected from its media, so no more
+ * frames can arrive while the encoder is being flushed */
+static void drain_encoder(struct obs_encoder *encoder)
+{
+	size_t count = 0;
+
+	if (encoder->info.get_delayed_frames) {
+		/* a flush can return no packet while frames are still being
+		 * encoded, so go by the number of frames held back */
+		while (has_delayed_frames(encoder)) {
+			if (do_encode(encoder, NULL))
+				count++;
+		}
+	} else {
+		while (do_encode(encoder, NULL))
+			count++;
+	}
+
+	if (count)
+		blog(LOG_DEBUG, "encoder '%s': drained %d delayed packet(s)",
+				encoder->context.name, (int)count);
 }
 
 static void receive_video(void *param, struct video_data *frame)
@@ -709,17 +878,36 @@ static bool buffer_audio(struct obs_encoder *encoder, struct audio_data *data)
 	return true;
 }
 
-static void send_audio_data(struct obs_encoder *encoder)
+/* once the buffer runs out, the encoder may no longer be touched unless
+ * *stop is set: a stop that was deferred to this worker is then finished
+ * by it */
+static bool pop_audio_frame(struct obs_encoder *encoder, bool *stop)
 {
-	struct encoder_frame  enc_frame;
+	pthread_mutex_lock(&encoder->audio_buffer_mutex);
 
-	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+	if (encoder->audio_input_buffer[0].size < encoder->framesize_bytes) {
+		encoder->audio_scheduled = false;
+		*stop = encoder->stop_pending;
+		pthread_mutex_unlock(&encoder->audio_buffer_mutex);
+		return false;
+	}
 
-	for (size_t i = 0; i < encoder->planes; i++) {
+	for (size_t i = 0; i < encoder->planes; i++)
 		circlebuf_pop_front(&encoder->audio_input_buffer[i],
 				encoder->audio_output_buffer[i],
 				encoder->framesize_bytes);
 
+	pthread_mutex_unlock(&encoder->audio_buffer_mutex);
+	return true;
+}
+
+static void send_audio_data(struct obs_encoder *encoder)
+{
+	struct encoder_frame  enc_frame;
+
+	memset(&enc_frame, 0, sizeof(struct encoder_frame));
+
+	for (size_t i = 0; i < encoder->planes; i++) {
 		enc_frame.data[i]     = encoder->audio_output_buffer[i];
 		enc_frame.linesize[i] = (uint32_t)encoder->framesize_bytes;
 	}
@@ -732,15 +920,51 @@ static void send_audio_data(struct obs_encoder *encoder)
 	encoder->cur_pts += encoder->framesize;
 }
 
-static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
+/* runs on an audio worker, so encoding one track never holds up the audio
+ * thread or the other tracks */
+static void process_audio(void *param)
 {
 	struct obs_encoder *encoder = param;
+	struct encoder_callback cb;
+	bool stop = false;
+
+	while (pop_audio_frame(encoder, &stop))
+		send_audio_data(encoder);
 
-	if (!buffer_audio(encoder, data))
+	if (!stop)
 		return;
 
-	while (encoder->audio_input_buffer[0].size >= encoder->framesize_bytes)
-		send_audio_data(encoder);
+	cb = encoder->stop_cb;
+	if (finish_stop(encoder, &cb))
+		return;
+
+	pthread_mutex_lock(&encoder->audio_buffer_mutex);
+	encoder->stop_pending = false;
+	pthread_cond_broadcast(&encoder->stop_cond);
+	pthread_mutex_unlock(&encoder->audio_buffer_mutex);
+}
+
+static void receive_audio(void *param, size_t mix_idx, struct audio_data *data)
+{
+	struct obs_encoder *encoder = param;
+	bool schedule = false;
+
+	pthread_mutex_lock(&encoder->audio_buffer_mutex);
+
+	if (buffer_audio(encoder, data) && !encoder->audio_scheduled &&
+	    encoder->audio_input_buffer[0].size >= encoder->framesize_bytes) {
+		encoder->audio_scheduled = true;
+		schedule = true;
+	}
+
+	pthread_mutex_unlock(&encoder->audio_buffer_mutex);
+
+	if (schedule) {
+		if (obs->data.num_audio_workers)
+			obs_audio_workers_schedule(process_audio, encoder);
+		else
+			process_audio(encoder);
+	}
 
 	UNUSED_PARAMETER(mix_idx);
 }
@@ -769,11 +993,17 @@ void obs_duplicate_encoder_packet(struct encoder_packet *dst,
 		const struct encoder_packet *src)
 {
 	*dst = *src;
-	dst->data = bmemdup(src->data, src->size);
+	dst->data = bmalloc_tagged(src->size, BMEM_TAG_ENCODER);
+	memcpy(dst->data, src->data, src->size);
+
+	if (src->num_nals)
+		dst->nals = bmemdup(src->nals,
+				src->num_nals * sizeof(*src->nals));
 }
 
 void obs_free_encoder_packet(struct encoder_packet *packet)
 {
 	bfree(packet->data);
+	bfree(packet->nals);
 	memset(packet, 0, sizeof(struct encoder_packet));
 }
@@ -35,6 +35,23 @@ enum obs_encoder_type {
 	OBS_ENCODER_VIDEO  /**< The encoder provides a video codec */
 };
 
+/**
+ * Encoder can be drained:  encode may be called with a NULL frame to flush
+ * any packets that are still held back (lookahead, B-frames, etc) when the
+ * encoder is stopped.  Encoders that may return no packet from a flush while
+ * still holding frames should implement get_delayed_frames.
+ */
+#define OBS_ENCODER_CAP_DRAIN (1<<0)
+
+/** Location of a single NAL unit within AVC encoder packet data */
+struct encoder_packet_nal {
+	uint32_t              offset;   /**< Offset of the unit past its
+	                                     start code */
+	uint32_t              size;     /**< Size without the start code */
+	int                   type;     /**< NAL unit type (OBS_NAL_*) */
+	int                   priority; /**< NAL reference priority */
+};
+
 /** Encoder output packet */
 struct encoder_packet {
 	uint8_t               *data;        /**< Packet data */
@@ -77,6 +94,14 @@ struct encoder_packet {
 
 	/** Encoder from which the track originated from */
 	obs_encoder_t         *encoder;
+
+	/**
+	 * Optional list of the NAL units in the data (AVC only).  Encoders
+	 * that know where their NAL units are can set this so that outputs
+	 * do not have to scan the packet for start codes.
+	 */
+	struct encoder_packet_nal *nals;
+	size_t                num_nals;
 };
 
 /** Encoder input frame */
@@ -147,7 +172,9 @@ struct obs_encoder_info {
 	 *
 	 * @param       data             Data associated with this encoder
 	 *                               context
-	 * @param[in]   frame            Raw audio/video data to encode
+	 * @param[in]   frame            Raw audio/video data to encode, or
+	 *                               NULL to drain delayed packets if the
+	 *                               encoder has OBS_ENCODER_CAP_DRAIN
 	 * @param[out]  packet           Encoder packet output, if any
 	 * @param[out]  received_packet  Set to true if a packet was received,
 	 *                               false otherwise
@@ -227,6 +254,22 @@ struct obs_encoder_info {
 	 *                    otherwise
 	 */
 	bool (*get_video_info)(void *data, struct video_scale_info *info);
+
+	/**
+	 * Encoder capability flags (OBS_ENCODER_CAP_*)
+	 */
+	uint32_t caps;
+
+	/**
+	 * Drainable encoders only:  Returns the number of frames the encoder
+	 * is still holding back.  Draining continues until this returns 0.
+	 * If not implemented, draining stops at the first NULL frame that
+	 * does not return a packet.
+	 *
+	 * @param  data  Data associated with this encoder context
+	 * @return       Number of frames still held back
+	 */
+	int (*get_delayed_frames)(void *data);
 };
 
 EXPORT void obs_register_encoder_s(const struct obs_encoder_info *info,
@@ -29,12 +29,16 @@
 #include "graphics/graphics.h"
 
 #include "media-io/audio-resampler.h"
+#include "media-io/audio-remix.h"
 #include "media-io/video-io.h"
 #include "media-io/audio-io.h"
 
 #include "obs.h"
 
 #define NUM_TEXTURES 2
+#define MAX_STAGING_SURFACES 4
+#define DEFAULT_STAGING_SURFACES 2
+#define NUM_AUDIO_WORKERS 4
 #define MICROSECOND_DEN 1000000
 
 static inline int64_t packet_dts_usec(struct encoder_packet *packet)
@@ -113,6 +117,8 @@ extern void obs_view_free(struct obs_view *view);
 struct obs_display {
 	bool                            size_changed;
 	uint32_t                        cx, cy;
+	uint64_t                        min_interval_ns;
+	uint64_t                        next_render_ns;
 	gs_swapchain_t                  *swap;
 	pthread_mutex_t                 draw_callbacks_mutex;
 	DARRAY(struct draw_callback)    draw_callbacks;
@@ -134,15 +140,26 @@ struct obs_vframe_info {
 	int count;
 };
 
+/* frame pacing statistics of the graphics thread, logged when video stops */
+struct obs_video_pacing {
+	uint64_t                        frames;
+	uint64_t                        duplicated;
+	uint64_t                        caught_up;
+	uint64_t                        render_total_ns;
+	uint64_t                        render_max_ns;
+	uint64_t                        jitter_total_ns;
+	uint64_t                        jitter_max_ns;
+};
+
 struct obs_core_video {
 	graphics_t                      *graphics;
-	gs_stagesurf_t                  *copy_surfaces[NUM_TEXTURES];
+	gs_stagesurf_t                  *copy_surfaces[MAX_STAGING_SURFACES];
 	gs_texture_t                    *render_textures[NUM_TEXTURES];
 	gs_texture_t                    *output_textures[NUM_TEXTURES];
 	gs_texture_t                    *convert_textures[NUM_TEXTURES];
 	bool                            textures_rendered[NUM_TEXTURES];
 	bool                            textures_output[NUM_TEXTURES];
-	bool                            textures_copied[NUM_TEXTURES];
+	bool                            textures_copied[MAX_STAGING_SURFACES];
 	bool                            textures_converted[NUM_TEXTURES];
 	struct circlebuf                vframe_info_buffer;
 	gs_effect_t                     *default_effect;
@@ -155,6 +172,19 @@ struct obs_core_video {
 	gs_stagesurf_t                  *mapped_surface;
 	int                             cur_texture;
 
+	/* staged frames are downloaded num_staging_surfaces-1 frames after
+	 * they were copied, giving the GPU time to finish the readback */
+	int                             num_staging_surfaces;
+	int                             cur_staging;
+	uint32_t                        staging_depth;
+	struct obs_video_pacing         pacing;
+
+	/* GPU converted frames are lent to the video output while their
+	 * staging surface stays mapped.  The video-io thread hands surfaces
+	 * back here and the graphics thread unmaps them. */
+	pthread_mutex_t                 lent_mutex;
+	DARRAY(gs_stagesurf_t*)         returned_surfaces;
+
 	video_t                         *video;
 	pthread_t                       video_thread;
 	bool                            thread_initialized;
@@ -184,6 +214,18 @@ struct obs_core_audio {
 	float                           present_volume;
 };
 
+/* work item for the audio worker pool.  work for the same param is never
+ * processed by more than one worker at a time as long as callers only
+ * schedule it while it isn't already pending or running */
+struct audio_worker_task {
+	void (*process)(void *param);
+	void *param;
+};
+
+extern void obs_audio_workers_schedule(void (*process)(void *param),
+		void *param);
+extern bool obs_audio_workers_unschedule(void *param);
+
 /* user sources, output channels, and displays */
 struct obs_core_data {
 	pthread_mutex_t                 user_sources_mutex;
@@ -203,8 +245,22 @@ struct obs_core_data {
 
 	struct obs_view                 main_view;
 
+	/* worker pool for sources using obs_source_output_audio_async and
+	 * for audio encoders */
+	pthread_mutex_t                 audio_workers_mutex;
+	pthread_cond_t                  audio_workers_idle;
+	os_sem_t                        *audio_workers_sem;
+	pthread_t                       audio_workers[NUM_AUDIO_WORKERS];
+	void                            *audio_workers_busy[NUM_AUDIO_WORKERS];
+	size_t                          num_audio_workers;
+	volatile bool                   audio_workers_stop;
+	DARRAY(struct audio_worker_task) audio_workers_queue;
+
 	volatile long                   active_transitions;
 
+	/* incremented whenever something that gets saved changes */
+	volatile long                   save_generation;
+
 	long long                       unnamed_index;
 
 	volatile bool                   valid;
@@ -238,6 +294,12 @@ struct obs_core {
 extern struct obs_core *obs;
 
 extern void *obs_video_thread(void *param);
+extern void free_returned_surfaces(struct obs_core_video *video);
+
+static inline void obs_mark_save_dirty(void)
+{
+	os_atomic_inc_long(&obs->data.save_generation);
+}
 
 
 /* ------------------------------------------------------------------------- */
@@ -325,6 +387,7 @@ struct obs_source {
 	bool                            muted;
 	struct resample_info            sample_info;
 	audio_resampler_t               *resampler;
+	audio_remixer_t                 *remixer;
 	audio_line_t                    *audio_line;
 	pthread_mutex_t                 audio_mutex;
 	struct obs_audio_data           audio_data;
@@ -334,6 +397,12 @@ struct obs_source {
 	float                           present_volume;
 	int64_t                         sync_offset;
 
+	/* asynchronous audio input, processed on the audio worker pool */
+	pthread_mutex_t                 async_audio_mutex;
+	struct circlebuf                async_audio_queue;
+	DARRAY(uint8_t)                 async_audio_buffer;
+	bool                            async_audio_scheduled;
+
 	/* async video data */
 	gs_texture_t                    *async_texture;
 	gs_texrender_t                  *async_convert_texrender;
@@ -364,6 +433,12 @@ struct obs_source {
 	gs_texrender_t                  *filter_texrender;
 	enum obs_allow_direct_render    allow_direct;
 	bool                            rendering_filter;
+
+	/* rendering cache for static sources */
+	gs_texrender_t                  *cache_texrender;
+	uint32_t                        cache_width;
+	uint32_t                        cache_height;
+	volatile bool                   cache_dirty;
 };
 
 extern const struct obs_source_info *find_source(struct darray *list,
@@ -380,9 +455,11 @@ enum view_type {
 	AUX_VIEW
 };
 
+
 extern void obs_source_activate(obs_source_t *source, enum view_type type);
 extern void obs_source_deactivate(obs_source_t *source, enum view_type type);
 extern void obs_source_video_tick(obs_source_t *source, float seconds);
+extern void obs_source_skip_async_video(obs_source_t *source);
 extern float obs_source_get_target_volume(obs_source_t *source,
 		obs_source_t *target);
 
@@ -390,6 +467,9 @@ extern float obs_source_get_target_volume(obs_source_t *source,
 /* ------------------------------------------------------------------------- */
 /* outputs  */
 
+/* the interleaver queues video and every audio track separately */
+#define MAX_INTERLEAVE_QUEUES (MAX_AUDIO_MIXES + 1)
+
 struct obs_output {
 	struct obs_context_data         context;
 	struct obs_output_info          info;
@@ -401,7 +481,12 @@ struct obs_output {
 	int64_t                         highest_audio_ts;
 	int64_t                         highest_video_ts;
 	pthread_mutex_t                 interleaved_mutex;
-	DARRAY(struct encoder_packet)   interleaved_packets;
+	struct circlebuf                interleaved_queues[
+	                                        MAX_INTERLEAVE_QUEUES];
+	int64_t                         interleaved_last_usec[
+	                                        MAX_INTERLEAVE_QUEUES];
+	int64_t                         interleave_skew_usec[
+	                                        MAX_INTERLEAVE_QUEUES];
 
 	int                             reconnect_retry_sec;
 	int                             reconnect_retry_max;
@@ -411,6 +496,12 @@ struct obs_output {
 	os_event_t                      *reconnect_stop_event;
 	volatile bool                   reconnect_thread_active;
 
+	/* the output's stop callback drains the encoders, so it runs on its
+	 * own thread instead of the caller's (usually the UI) */
+	pthread_t                       stop_thread;
+	bool                            stop_thread_active;
+	volatile bool                   stopping;
+
 	uint32_t                        starting_frame_count;
 	uint32_t                        starting_skipped_frame_count;
 
@@ -473,8 +564,24 @@ struct obs_encoder {
 
 	int64_t                         cur_pts;
 
+	/* audio is buffered on the audio thread and encoded on the audio
+	 * worker pool */
+	pthread_mutex_t                 audio_buffer_mutex;
 	struct circlebuf                audio_input_buffer[MAX_AV_PLANES];
 	uint8_t                         *audio_output_buffer[MAX_AV_PLANES];
+	bool                            audio_scheduled;
+
+	/* set when the encoder is stopped while audio is scheduled, the
+	 * audio worker then finishes the stop once it has encoded the
+	 * frames still buffered.  stop_cond is signaled when it's done. */
+	bool                            stop_pending;
+	struct encoder_callback         stop_cb;
+	pthread_cond_t                  stop_cond;
+
+	/* encode latency statistics, reset when the encoder starts */
+	uint64_t                        encode_time_total;
+	uint64_t                        encode_time_max;
+	uint32_t                        encode_count;
 
 	/* if a video encoder is paired with an audio encoder, make it start
 	 * up at the specific timestamp.  if this is the audio encoder,
@@ -16,6 +16,7 @@
 ******************************************************************************/
 
 #include "util/platform.h"
+#include "util/threading.h"
 #include "util/dstr.h"
 
 #include "obs-defs.h"
@@ -56,38 +57,64 @@ static int load_module_exports(struct obs_module *mod, const char *path)
 	return MODULE_SUCCESS;
 }
 
-int obs_open_module(obs_module_t **module, const char *path,
+/* opens the module binary without touching any shared state, so it can be
+ * called from several threads at once */
+static int open_module_file(struct obs_module *mod, const char *path,
 		const char *data_path)
 {
-	struct obs_module mod = {0};
 	int errorcode;
 
-	if (!module || !path || !obs)
-		return MODULE_ERROR;
-
-	mod.module = os_dlopen(path);
-	if (!mod.module) {
+	mod->module = os_dlopen(path);
+	if (!mod->module) {
 		blog(LOG_WARNING, "Module '%s' not found", path);
 		return MODULE_FILE_NOT_FOUND;
 	}
 
-	errorcode = load_module_exports(&mod, path);
+	errorcode = load_module_exports(mod, path);
 	if (errorcode != MODULE_SUCCESS)
 		return errorcode;
 
-	mod.bin_path  = bstrdup(path);
-	mod.file      = strrchr(mod.bin_path, '/');
-	mod.file      = (!mod.file) ? mod.bin_path : (mod.file + 1);
-	mod.data_path = bstrdup(data_path);
-	mod.next      = obs->first_module;
+	mod->bin_path  = bstrdup(path);
+	mod->file      = strrchr(mod->bin_path, '/');
+	mod->file      = (!mod->file) ? mod->bin_path : (mod->file + 1);
+	mod->data_path = bstrdup(data_path);
+	return MODULE_SUCCESS;
+}
+
+static void load_module_locale(struct obs_module *mod)
+{
+	mod->set_pointer(mod);
+
+	if (mod->set_locale)
+		mod->set_locale(obs->locale);
+}
+
+static inline void link_module(struct obs_module *mod)
+{
+	mod->next = obs->first_module;
+	obs->first_module = mod;
+}
+
+int obs_open_module(obs_module_t **module, const char *path,
+		const char *data_path)
+{
+	struct obs_module *mod;
+	int errorcode;
+
+	if (!module || !path || !obs)
+		return MODULE_ERROR;
 
-	*module = bmemdup(&mod, sizeof(mod));
-	obs->first_module = (*module);
-	mod.set_pointer(*module);
+	mod = bzalloc(sizeof(struct obs_module));
+	errorcode = open_module_file(mod, path, data_path);
+	if (errorcode != MODULE_SUCCESS) {
+		bfree(mod);
+		return errorcode;
+	}
 
-	if (mod.set_locale)
-		mod.set_locale(obs->locale);
+	link_module(mod);
+	load_module_locale(mod);
 
+	*module = mod;
 	return MODULE_SUCCESS;
 }
 
@@ -164,25 +191,155 @@ void obs_add_module_path(const char *bin, const char *data)
 	da_push_back(obs->module_paths, &omp);
 }
 
-static void load_all_callback(void *param, const struct obs_module_info *info)
+/* ------------------------------------------------------------------------- */
+/* parallel module loading
+ *
+ *   Loading the module binaries and parsing their locale files is done on a
+ * few threads, while obs_module_load is still called on the calling thread in
+ * the order the modules were found, so that type registration order doesn't
+ * depend on thread timing. */
+
+#define MODULE_LOADER_THREADS 4
+
+struct module_load_job {
+	char                           *bin_path;
+	char                           *data_path;
+	struct obs_module              *module;
+	int                            code;
+	uint64_t                       open_time;
+	uint64_t                       init_time;
+};
+
+struct module_loader {
+	DARRAY(struct module_load_job) jobs;
+	volatile long                  next_job;
+};
+
+static void add_load_job(void *param, const struct obs_module_info *info)
 {
-	obs_module_t *module;
+	struct module_loader   *loader = param;
+	struct module_load_job *job    = da_push_back_new(loader->jobs);
 
-	int code = obs_open_module(&module, info->bin_path, info->data_path);
-	if (code != MODULE_SUCCESS) {
-		blog(LOG_DEBUG, "Failed to load module file '%s': %d",
-				info->bin_path, code);
-		return;
+	job->bin_path  = bstrdup(info->bin_path);
+	job->data_path = bstrdup(info->data_path);
+}
+
+static void *module_loader_thread(void *param)
+{
+	struct module_loader *loader = param;
+
+	os_set_thread_name("libobs: module loader");
+
+	for (;;) {
+		size_t idx = (size_t)os_atomic_inc_long(&loader->next_job) - 1;
+		struct module_load_job *job;
+		uint64_t start;
+
+		if (idx >= loader->jobs.num)
+			break;
+
+		job   = loader->jobs.array + idx;
+		start = os_gettime_ns();
+
+		job->module = bzalloc(sizeof(struct obs_module));
+		job->code   = open_module_file(job->module, job->bin_path,
+				job->data_path);
+
+		if (job->code == MODULE_SUCCESS) {
+			load_module_locale(job->module);
+		} else {
+			bfree(job->module);
+			job->module = NULL;
+		}
+
+		job->open_time = os_gettime_ns() - start;
 	}
 
-	obs_init_module(module);
+	return NULL;
+}
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
+
+static void log_module_times(struct module_loader *loader, uint64_t total)
+{
+	int loaded = 0;
+
+	blog(LOG_INFO, "Module load times (open + locale, init):");
+
+	for (size_t i = 0; i < loader->jobs.num; i++) {
+		struct module_load_job *job = loader->jobs.array + i;
+
+		if (!job->module)
+			continue;
 
-	UNUSED_PARAMETER(param);
+		blog(LOG_INFO, "\t%-32s %8.2f ms %8.2f ms%s",
+				job->module->file,
+				ns_to_ms(job->open_time),
+				ns_to_ms(job->init_time),
+				job->module->loaded ? "" : " (failed)");
+
+		if (job->module->loaded)
+			loaded++;
+	}
+
+	blog(LOG_INFO, "Loaded %d modules in %.2f ms", loaded,
+			ns_to_ms(total));
 }
 
 void obs_load_all_modules(void)
 {
-	obs_find_modules(load_all_callback, NULL);
+	struct module_loader loader = {0};
+	pthread_t threads[MODULE_LOADER_THREADS];
+	size_t    num_threads = 0;
+	uint64_t  start = os_gettime_ns();
+
+	if (!obs)
+		return;
+
+	obs_find_modules(add_load_job, &loader);
+
+	for (size_t i = 0; i < MODULE_LOADER_THREADS; i++) {
+		if (i >= loader.jobs.num)
+			break;
+		if (pthread_create(&threads[num_threads], NULL,
+					module_loader_thread, &loader) == 0)
+			num_threads++;
+	}
+
+	/* fall back to loading on this thread if no thread could start */
+	if (!num_threads)
+		module_loader_thread(&loader);
+
+	for (size_t i = 0; i < num_threads; i++)
+		pthread_join(threads[i], NULL);
+
+	for (size_t i = 0; i < loader.jobs.num; i++) {
+		struct module_load_job *job = loader.jobs.array + i;
+		uint64_t init_start;
+
+		if (!job->module) {
+			blog(LOG_DEBUG, "Failed to load module file '%s': %d",
+					job->bin_path, job->code);
+			continue;
+		}
+
+		link_module(job->module);
+
+		init_start = os_gettime_ns();
+		obs_init_module(job->module);
+		job->init_time = os_gettime_ns() - init_start;
+	}
+
+	log_module_times(&loader, os_gettime_ns() - start);
+
+	for (size_t i = 0; i < loader.jobs.num; i++) {
+		bfree(loader.jobs.array[i].bin_path);
+		bfree(loader.jobs.array[i].data_path);
+	}
+	da_free(loader.jobs);
 }
 
 static inline void make_data_dir(struct dstr *parsed_data_dir,
@@ -109,11 +109,22 @@ fail:
 
 static inline void free_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++)
-		obs_free_encoder_packet(output->interleaved_packets.array+i);
-	da_free(output->interleaved_packets);
+	for (size_t i = 0; i < MAX_INTERLEAVE_QUEUES; i++) {
+		struct circlebuf *queue = &output->interleaved_queues[i];
+		struct encoder_packet packet;
+
+		while (queue->size) {
+			circlebuf_pop_front(queue, &packet, sizeof(packet));
+			obs_free_encoder_packet(&packet);
+		}
+
+		circlebuf_free(queue);
+	}
 }
 
+static void output_stop_internal(struct obs_output *output);
+static void wait_for_stop_thread(struct obs_output *output);
+
 void obs_output_destroy(obs_output_t *output)
 {
 	if (output) {
@@ -121,8 +132,15 @@ void obs_output_destroy(obs_output_t *output)
 
 		blog(LOG_INFO, "output '%s' destroyed", output->context.name);
 
-		if (output->valid && output->active)
-			obs_output_stop(output);
+		wait_for_stop_thread(output);
+
+		if (output->valid && output->active) {
+			os_event_signal(output->reconnect_stop_event);
+			if (output->reconnect_thread_active)
+				pthread_join(output->reconnect_thread, NULL);
+
+			output_stop_internal(output);
+		}
 		if (output->service)
 			output->service->output = NULL;
 
@@ -163,6 +181,7 @@ bool obs_output_start(obs_output_t *output)
 	if (!output)
 		return false;
 
+	wait_for_stop_thread(output);
 	output->stopped = false;
 
 	success = output->info.start(output->context.data);
@@ -210,20 +229,90 @@ static void log_frame_info(struct obs_output *output)
 	}
 }
 
+static void log_interleave_skew(struct obs_output *output)
+{
+	struct dstr str = {0};
+
+	if (!output->video_encoder || !output->audio_encoders[0])
+		return;
+
+	dstr_catf(&str, "video %"PRId64" ms",
+			output->interleave_skew_usec[0] / 1000);
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (!output->audio_encoders[i])
+			continue;
+
+		dstr_catf(&str, ", track %d %"PRId64" ms", (int)i + 1,
+				output->interleave_skew_usec[i + 1] / 1000);
+	}
+
+	blog(LOG_INFO, "Output '%s': Max interleave skew: %s",
+			output->context.name, str.array);
+	dstr_free(&str);
+}
+
+/* packets drained out of the encoders while the output ends data capture
+ * still have to be passed to the output, so stopped is only set after its
+ * stop callback */
+static void output_stop_internal(struct obs_output *output)
+{
+	output->info.stop(output->context.data);
+	output->stopped = true;
+
+	if (output->video)
+		log_frame_info(output);
+	if (output->info.flags & OBS_OUTPUT_ENCODED)
+		log_interleave_skew(output);
+
+	output->stopping = false;
+	signal_stop(output, OBS_OUTPUT_SUCCESS);
+}
+
+static void *stop_thread(void *data)
+{
+	struct obs_output *output = data;
+
+	os_set_thread_name("obs-output: stop");
+	output_stop_internal(output);
+	return NULL;
+}
+
+static void wait_for_stop_thread(struct obs_output *output)
+{
+	if (!output->stop_thread_active)
+		return;
+
+	/* a stop signal handler can restart or destroy the output */
+	if (pthread_equal(pthread_self(), output->stop_thread)) {
+		pthread_detach(output->stop_thread);
+	} else {
+		pthread_join(output->stop_thread, NULL);
+	}
+
+	output->stop_thread_active = false;
+}
+
 void obs_output_stop(obs_output_t *output)
 {
-	if (output) {
-		output->stopped = true;
+	if (!output || output->stopping)
+		return;
 
-		os_event_signal(output->reconnect_stop_event);
-		if (output->reconnect_thread_active)
-			pthread_join(output->reconnect_thread, NULL);
+	os_event_signal(output->reconnect_stop_event);
+	if (output->reconnect_thread_active)
+		pthread_join(output->reconnect_thread, NULL);
 
-		output->info.stop(output->context.data);
-		signal_stop(output, OBS_OUTPUT_SUCCESS);
+	wait_for_stop_thread(output);
+	output->stopping = true;
 
-		if (output->video)
-			log_frame_info(output);
+	if (pthread_create(&output->stop_thread, NULL, stop_thread,
+				output) == 0) {
+		output->stop_thread_active = true;
+	} else {
+		blog(LOG_WARNING, "Output '%s': failed to create stop thread, "
+				"stopping on the calling thread",
+				output->context.name);
+		output_stop_internal(output);
 	}
 }
 
@@ -471,6 +560,17 @@ int obs_output_get_total_frames(const obs_output_t *output)
 	return output ? output->total_frames : 0;
 }
 
+int64_t obs_output_get_interleave_skew(const obs_output_t *output,
+		enum obs_encoder_type type, size_t track_idx)
+{
+	if (!output || (type == OBS_ENCODER_AUDIO &&
+	                track_idx >= MAX_AUDIO_MIXES))
+		return 0;
+
+	return output->interleave_skew_usec[
+		type == OBS_ENCODER_VIDEO ? 0 : track_idx + 1];
+}
+
 void obs_output_set_preferred_size(obs_output_t *output, uint32_t width,
 		uint32_t height)
 {
@@ -722,167 +822,189 @@ static inline bool has_higher_opposing_ts(struct obs_output *output,
 		return output->highest_video_ts > packet->dts_usec;
 }
 
-static inline void send_interleaved(struct obs_output *output)
+/* packets of each encoder arrive in dts order, so every track is a plain
+ * FIFO and the interleaved order is a merge of the queue fronts */
+static inline size_t packet_queue_idx(const struct encoder_packet *packet)
 {
-	struct encoder_packet out = output->interleaved_packets.array[0];
+	return (packet->type == OBS_ENCODER_VIDEO) ? 0 : packet->track_idx + 1;
+}
 
-	/* do not send an interleaved packet if there's no packet of the
-	 * opposing type of a higher timstamp in the interleave buffer.
-	 * this ensures that the timestamps are monotonic */
-	if (!has_higher_opposing_ts(output, &out))
-		return;
+static inline bool peek_queue(struct obs_output *output, size_t idx,
+		struct encoder_packet *packet)
+{
+	struct circlebuf *queue = &output->interleaved_queues[idx];
 
-	if (out.type == OBS_ENCODER_VIDEO)
-		output->total_frames++;
+	if (!queue->size)
+		return false;
 
-	da_erase(output->interleaved_packets, 0);
-	if (!output->stopped)
-		output->info.encoded_packet(output->context.data, &out);
-	obs_free_encoder_packet(&out);
+	circlebuf_peek_front(queue, packet, sizeof(*packet));
+	return true;
 }
 
-static inline void set_higher_ts(struct obs_output *output,
-		struct encoder_packet *packet)
+/* returns the queue holding the earliest packet, ties go to video and then
+ * to the lowest track */
+static size_t next_interleaved_queue(struct obs_output *output,
+		struct encoder_packet *next)
 {
-	if (packet->type == OBS_ENCODER_VIDEO) {
-		if (output->highest_video_ts < packet->dts_usec)
-			output->highest_video_ts = packet->dts_usec;
-	} else {
-		if (output->highest_audio_ts < packet->dts_usec)
-			output->highest_audio_ts = packet->dts_usec;
+	size_t next_idx = DARRAY_INVALID;
+
+	for (size_t i = 0; i < MAX_INTERLEAVE_QUEUES; i++) {
+		struct encoder_packet packet;
+
+		if (!peek_queue(output, i, &packet))
+			continue;
+
+		if (next_idx == DARRAY_INVALID ||
+		    packet.dts_usec < next->dts_usec) {
+			*next    = packet;
+			next_idx = i;
+		}
 	}
+
+	return next_idx;
 }
 
-static bool can_prune_interleaved_packet(struct obs_output *output, size_t idx)
+/* how far each track has run ahead of the packet that is being sent */
+static inline void update_interleave_skew(struct obs_output *output,
+		const struct encoder_packet *sent)
 {
-	struct encoder_packet *packet;
-	struct encoder_packet *next;
+	for (size_t i = 0; i < MAX_INTERLEAVE_QUEUES; i++) {
+		int64_t skew;
 
-	if (idx >= (output->interleaved_packets.num - 1))
-		return false;
+		if (!output->interleaved_queues[i].size)
+			continue;
 
-	packet = &output->interleaved_packets.array[idx];
-
-	/* audio packets will almost always come before video packets,
-	 * so it should only ever be necessary to prune audio packets */
-	if (packet->type != OBS_ENCODER_AUDIO)
-		return false;
+		skew = output->interleaved_last_usec[i] - sent->dts_usec;
+		if (skew > output->interleave_skew_usec[i])
+			output->interleave_skew_usec[i] = skew;
+	}
+}
 
-	next = &output->interleaved_packets.array[idx + 1];
+static inline void send_packet(struct obs_output *output, size_t queue_idx,
+		struct encoder_packet *out)
+{
+	circlebuf_pop_front(&output->interleaved_queues[queue_idx], NULL,
+			sizeof(*out));
+	update_interleave_skew(output, out);
 
-	if (next->type == OBS_ENCODER_VIDEO &&
-	    next->dts_usec == packet->dts_usec)
-		return false;
+	if (out->type == OBS_ENCODER_VIDEO)
+		output->total_frames++;
 
-	return true;
+	if (!output->stopped)
+		output->info.encoded_packet(output->context.data, out);
+	obs_free_encoder_packet(out);
 }
 
-static void prune_interleaved_packets(struct obs_output *output)
+static inline void send_interleaved(struct obs_output *output)
 {
-	size_t start_idx = 0;
+	struct encoder_packet out;
+	size_t idx = next_interleaved_queue(output, &out);
 
-	while (can_prune_interleaved_packet(output, start_idx))
-		start_idx++;
+	if (idx == DARRAY_INVALID)
+		return;
 
-	if (start_idx) {
-		for (size_t i = 0; i < start_idx; i++) {
-			struct encoder_packet *packet =
-				&output->interleaved_packets.array[i];
-			obs_free_encoder_packet(packet);
-		}
+	/* do not send an interleaved packet if there's no packet of the
+	 * opposing type of a higher timstamp in the interleave buffer.
+	 * this ensures that the timestamps are monotonic */
+	if (!has_higher_opposing_ts(output, &out))
+		return;
 
-		da_erase_range(output->interleaved_packets, 0, start_idx);
+	send_packet(output, idx, &out);
+}
+
+static inline void set_higher_ts(struct obs_output *output,
+		struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO) {
+		if (output->highest_video_ts < packet->dts_usec)
+			output->highest_video_ts = packet->dts_usec;
+	} else {
+		if (output->highest_audio_ts < packet->dts_usec)
+			output->highest_audio_ts = packet->dts_usec;
 	}
 }
 
-static struct encoder_packet *find_first_packet_type(struct obs_output *output,
-		enum obs_encoder_type type, size_t audio_idx)
+/* audio packets will almost always come before video packets, so drop the
+ * audio that precedes the first video packet */
+static void prune_interleaved_packets(struct obs_output *output)
 {
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
+	struct encoder_packet video;
 
-		if (packet->type == type) {
-			if (type == OBS_ENCODER_AUDIO &&
-			    packet->track_idx != audio_idx) {
-				continue;
-			}
+	if (!peek_queue(output, 0, &video))
+		return;
 
-			return packet;
+	for (size_t i = 1; i < MAX_INTERLEAVE_QUEUES; i++) {
+		struct circlebuf *queue = &output->interleaved_queues[i];
+		struct encoder_packet packet;
+
+		while (peek_queue(output, i, &packet) &&
+		       packet.dts_usec < video.dts_usec) {
+			circlebuf_pop_front(queue, NULL, sizeof(packet));
+			obs_free_encoder_packet(&packet);
 		}
 	}
-
-	return NULL;
 }
 
 static bool initialize_interleaved_packets(struct obs_output *output)
 {
-	struct encoder_packet *video;
-	struct encoder_packet *audio[MAX_AUDIO_MIXES];
+	struct encoder_packet video;
+	struct encoder_packet audio[MAX_AUDIO_MIXES];
 	size_t audio_mixes = num_audio_mixes(output);
+	bool has_video;
 
-	video = find_first_packet_type(output, OBS_ENCODER_VIDEO, 0);
-	if (!video)
+	has_video = peek_queue(output, 0, &video);
+	if (!has_video)
 		output->received_video = false;
 
 	for (size_t i = 0; i < audio_mixes; i++) {
-		audio[i] = find_first_packet_type(output, OBS_ENCODER_AUDIO, i);
-		if (!audio[i]) {
+		if (!peek_queue(output, i + 1, &audio[i])) {
 			output->received_audio = false;
 			return false;
 		}
 	}
 
-	if (!video) {
+	if (!has_video) {
 		return false;
 	}
 
 	/* get new offsets */
-	output->video_offset = video->dts;
+	output->video_offset = video.dts;
 	for (size_t i = 0; i < audio_mixes; i++)
-		output->audio_offsets[i] = audio[i]->dts;
+		output->audio_offsets[i] = audio[i].dts;
 
 	/* subtract offsets from highest TS offset variables */
-	output->highest_audio_ts -= audio[0]->dts_usec;
-	output->highest_video_ts -= video->dts_usec;
-
-	/* apply new offsets to all existing packet DTS/PTS values */
-	for (size_t i = 0; i < output->interleaved_packets.num; i++) {
-		struct encoder_packet *packet =
-			&output->interleaved_packets.array[i];
-		apply_interleaved_packet_offset(output, packet);
-	}
+	output->highest_audio_ts -= audio[0].dts_usec;
+	output->highest_video_ts -= video.dts_usec;
 
-	return true;
-}
+	/* apply new offsets to all existing packet DTS/PTS values.  every
+	 * packet of a track gets the same offset, so the queues stay sorted
+	 * and are simply rotated once */
+	for (size_t i = 0; i < MAX_INTERLEAVE_QUEUES; i++) {
+		struct circlebuf *queue = &output->interleaved_queues[i];
+		size_t count = queue->size / sizeof(struct encoder_packet);
 
-static inline void insert_interleaved_packet(struct obs_output *output,
-		struct encoder_packet *out)
-{
-	size_t idx;
-	for (idx = 0; idx < output->interleaved_packets.num; idx++) {
-		struct encoder_packet *cur_packet;
-		cur_packet = output->interleaved_packets.array + idx;
+		for (size_t j = 0; j < count; j++) {
+			struct encoder_packet packet;
+
+			circlebuf_pop_front(queue, &packet, sizeof(packet));
+			apply_interleaved_packet_offset(output, &packet);
+			circlebuf_push_back(queue, &packet, sizeof(packet));
 
-		if (out->dts_usec < cur_packet->dts_usec)
-			break;
+			output->interleaved_last_usec[i] = packet.dts_usec;
+		}
 	}
 
-	da_insert(output->interleaved_packets, idx, out);
+	return true;
 }
 
-static void resort_interleaved_packets(struct obs_output *output)
+static inline void insert_interleaved_packet(struct obs_output *output,
+		struct encoder_packet *out)
 {
-	DARRAY(struct encoder_packet) old_array;
-
-	old_array.da = output->interleaved_packets.da;
-	memset(&output->interleaved_packets, 0,
-			sizeof(output->interleaved_packets));
+	size_t idx = packet_queue_idx(out);
 
-	for (size_t i = 0; i < old_array.num; i++)
-		insert_interleaved_packet(output, &old_array.array[i]);
-
-	da_free(old_array);
+	circlebuf_push_back(&output->interleaved_queues[idx], out,
+			sizeof(*out));
+	output->interleaved_last_usec[idx] = out->dts_usec;
 }
 
 static void interleave_packets(void *data, struct encoder_packet *packet)
@@ -913,10 +1035,8 @@ static void interleave_packets(void *data, struct encoder_packet *packet)
 	if (output->received_audio && output->received_video) {
 		if (!was_started) {
 			prune_interleaved_packets(output);
-			if (initialize_interleaved_packets(output)) {
-				resort_interleaved_packets(output);
+			if (initialize_interleaved_packets(output))
 				send_interleaved(output);
-			}
 		} else {
 			send_interleaved(output);
 		}
@@ -984,6 +1104,8 @@ static void hook_data_capture(struct obs_output *output, bool encoded,
 
 		for (size_t i = 0; i < MAX_AUDIO_MIXES; i++)
 			output->audio_offsets[0] = 0;
+		for (size_t i = 0; i < MAX_INTERLEAVE_QUEUES; i++)
+			output->interleave_skew_usec[i] = 0;
 
 		free_packets(output);
 
@@ -1173,6 +1295,26 @@ static inline void stop_audio_encoders(obs_output_t *output,
 	}
 }
 
+/* once the encoders have been drained, nothing else can arrive to satisfy
+ * the interleaver, so send out whatever is left in timestamp order */
+static void flush_interleaved_packets(struct obs_output *output)
+{
+	pthread_mutex_lock(&output->interleaved_mutex);
+
+	if (output->received_audio && output->received_video) {
+		struct encoder_packet packet;
+		size_t idx;
+
+		while ((idx = next_interleaved_queue(output, &packet)) !=
+				DARRAY_INVALID)
+			send_packet(output, idx, &packet);
+	}
+
+	free_packets(output);
+
+	pthread_mutex_unlock(&output->interleaved_mutex);
+}
+
 void obs_output_end_data_capture(obs_output_t *output)
 {
 	bool encoded, has_video, has_audio, has_service;
@@ -1193,6 +1335,9 @@ void obs_output_end_data_capture(obs_output_t *output)
 					encoded_callback, output);
 		if (has_audio)
 			stop_audio_encoders(output, encoded_callback);
+
+		if (has_video && has_audio)
+			flush_interleaved_packets(output);
 	} else {
 		if (has_video)
 			video_output_disconnect(output->video,
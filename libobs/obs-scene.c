@@ -222,6 +222,34 @@ static void calculate_bounds_data(struct obs_scene_item *item,
 			(int)-width_diff, (int)-height_diff);
 }
 
+static void update_item_bounds(struct obs_scene_item *item, uint32_t width,
+		uint32_t height)
+{
+	struct vec3 corners[4];
+
+	vec3_set(&corners[0], 0.0f,          0.0f,           0.0f);
+	vec3_set(&corners[1], (float)width, 0.0f,           0.0f);
+	vec3_set(&corners[2], 0.0f,          (float)height, 0.0f);
+	vec3_set(&corners[3], (float)width, (float)height, 0.0f);
+
+	for (size_t i = 0; i < 4; i++) {
+		vec3_transform(&corners[i], &corners[i], &item->draw_transform);
+
+		if (i == 0 || corners[i].x < item->draw_min.x)
+			item->draw_min.x = corners[i].x;
+		if (i == 0 || corners[i].y < item->draw_min.y)
+			item->draw_min.y = corners[i].y;
+		if (i == 0 || corners[i].x > item->draw_max.x)
+			item->draw_max.x = corners[i].x;
+		if (i == 0 || corners[i].y > item->draw_max.y)
+			item->draw_max.y = corners[i].y;
+	}
+
+	/* the bounding box is only the exact drawn area if the item isn't
+	 * rotated by anything other than multiples of 90 degrees */
+	item->axis_aligned = fmodf(item->rot, 90.0f) == 0.0f;
+}
+
 static void update_item_transform(struct obs_scene_item *item)
 {
 	uint32_t        width         = obs_source_get_width(item->source);
@@ -280,6 +308,8 @@ static void update_item_transform(struct obs_scene_item *item)
 
 	/* ----------------------- */
 
+	update_item_bounds(item, width, height);
+
 	item->last_width  = width;
 	item->last_height = height;
 
@@ -298,18 +328,105 @@ static inline bool source_size_changed(struct obs_scene_item *item)
 	return item->last_width != width || item->last_height != height;
 }
 
+/* ------------------------------------------------------------------------- */
+/* culling */
+
+#define MAX_OCCLUDERS 8
+
+struct occluder {
+	struct vec2 min;
+	struct vec2 max;
+};
+
+/* tracks whether the scene being rendered is nested inside another scene.
+ * a graphics context is only used by the thread that entered it, so keeping
+ * this per thread keeps it per rendering context */
+#ifdef _MSC_VER
+static __declspec(thread) int scene_render_depth = 0;
+#else
+static __thread int scene_render_depth = 0;
+#endif
+
+static inline bool item_is_opaque(const struct obs_scene_item *item)
+{
+	const struct obs_source *source = item->source;
+
+	if (!item->axis_aligned || !source->enabled ||
+	    !source->context.data ||
+	    (source->info.output_flags & OBS_SOURCE_OPAQUE) == 0)
+		return false;
+
+	/* filters can change the source's alpha */
+	if (source->filters.num)
+		return false;
+
+	return !source->info.is_opaque ||
+		source->info.is_opaque(source->context.data);
+}
+
+static inline bool item_off_canvas(const struct obs_scene_item *item,
+		float cx, float cy)
+{
+	return item->draw_max.x <= 0.0f || item->draw_max.y <= 0.0f ||
+	       item->draw_min.x >= cx   || item->draw_min.y >= cy;
+}
+
+static inline bool item_occluded(const struct obs_scene_item *item,
+		const struct occluder *occluders, size_t num_occluders)
+{
+	for (size_t i = 0; i < num_occluders; i++) {
+		const struct occluder *occ = occluders + i;
+
+		if (item->draw_min.x >= occ->min.x &&
+		    item->draw_min.y >= occ->min.y &&
+		    item->draw_max.x <= occ->max.x &&
+		    item->draw_max.y <= occ->max.y)
+			return true;
+	}
+
+	return false;
+}
+
+/* walks the items from the top down, marking the ones that are either
+ * entirely outside of the canvas or entirely covered by opaque items above
+ * them.  only a top level scene maps directly to the canvas, items of a
+ * nested scene can be drawn outside of its area so they're never treated as
+ * off-canvas. */
+static void cull_items(struct obs_scene *scene, struct obs_scene_item *last,
+		bool top_level)
+{
+	struct occluder occluders[MAX_OCCLUDERS];
+	size_t num_occluders = 0;
+	float  cx = (float)obs_source_get_width(scene->source);
+	float  cy = (float)obs_source_get_height(scene->source);
+	struct obs_scene_item *item = last;
+
+	while (item) {
+		item->culled = !item->visible ||
+			(top_level && item_off_canvas(item, cx, cy)) ||
+			item_occluded(item, occluders, num_occluders);
+
+		if (!item->culled && num_occluders < MAX_OCCLUDERS &&
+		    item_is_opaque(item)) {
+			occluders[num_occluders].min = item->draw_min;
+			occluders[num_occluders].max = item->draw_max;
+			num_occluders++;
+		}
+
+		item = item->prev;
+	}
+}
+
 static void scene_video_render(void *data, gs_effect_t *effect)
 {
 	struct obs_scene *scene = data;
 	struct obs_scene_item *item;
+	struct obs_scene_item *last = NULL;
 
 	pthread_mutex_lock(&scene->mutex);
 
 	item = scene->first_item;
 
-	gs_blend_state_push();
-	gs_blend_function(GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA);
-
 	while (item) {
 		if (obs_source_removed(item->source)) {
 			struct obs_scene_item *del_item = item;
@@ -322,7 +439,26 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		if (source_size_changed(item))
 			update_item_transform(item);
 
-		if (item->visible) {
+		last = item;
+		item = item->next;
+	}
+
+	cull_items(scene, last, scene_render_depth == 0);
+	scene_render_depth++;
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_SRCALPHA, GS_BLEND_INVSRCALPHA);
+	gs_sprite_batch_begin();
+
+	item = scene->first_item;
+
+	while (item) {
+		/* culled items are still showing, so async sources in them
+		 * have to keep taking their frames or they'd queue forever */
+		if (item->culled) {
+			if (item->visible)
+				obs_source_skip_async_video(item->source);
+		} else {
 			gs_matrix_push();
 			gs_matrix_mul(&item->draw_transform);
 			obs_source_video_render(item->source);
@@ -332,8 +468,10 @@ static void scene_video_render(void *data, gs_effect_t *effect)
 		item = item->next;
 	}
 
+	gs_sprite_batch_end();
 	gs_blend_state_pop();
 
+	scene_render_depth--;
 	pthread_mutex_unlock(&scene->mutex);
 
 	UNUSED_PARAMETER(effect);
@@ -607,6 +745,7 @@ obs_sceneitem_t *obs_scene_add(obs_scene_t *scene, obs_source_t *source)
 			&params);
 	calldata_free(&params);
 
+	obs_mark_save_dirty();
 	return item;
 }
 
@@ -663,6 +802,8 @@ void obs_sceneitem_remove(obs_sceneitem_t *item)
 
 	pthread_mutex_unlock(&scene->mutex);
 
+	obs_mark_save_dirty();
+
 	obs_sceneitem_release(item);
 }
 
@@ -704,6 +845,7 @@ void obs_sceneitem_set_pos(obs_sceneitem_t *item, const struct vec2 *pos)
 	if (item) {
 		vec2_copy(&item->pos, pos);
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -712,6 +854,7 @@ void obs_sceneitem_set_rot(obs_sceneitem_t *item, float rot)
 	if (item) {
 		item->rot = rot;
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -720,6 +863,7 @@ void obs_sceneitem_set_scale(obs_sceneitem_t *item, const struct vec2 *scale)
 	if (item) {
 		vec2_copy(&item->scale, scale);
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -728,6 +872,7 @@ void obs_sceneitem_set_alignment(obs_sceneitem_t *item, uint32_t alignment)
 	if (item) {
 		item->align = alignment;
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -784,6 +929,7 @@ void obs_sceneitem_set_order(obs_sceneitem_t *item,
 	}
 
 	signal_reorder(item);
+	obs_mark_save_dirty();
 
 	pthread_mutex_unlock(&scene->mutex);
 	obs_scene_release(scene);
@@ -816,6 +962,7 @@ void obs_sceneitem_set_order_position(obs_sceneitem_t *item,
 	}
 
 	signal_reorder(item);
+	obs_mark_save_dirty();
 
 	pthread_mutex_unlock(&scene->mutex);
 	obs_scene_release(scene);
@@ -827,6 +974,7 @@ void obs_sceneitem_set_bounds_type(obs_sceneitem_t *item,
 	if (item) {
 		item->bounds_type = type;
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -836,6 +984,7 @@ void obs_sceneitem_set_bounds_alignment(obs_sceneitem_t *item,
 	if (item) {
 		item->bounds_align = alignment;
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -844,6 +993,7 @@ void obs_sceneitem_set_bounds(obs_sceneitem_t *item, const struct vec2 *bounds)
 	if (item) {
 		item->bounds = *bounds;
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -911,6 +1061,7 @@ void obs_sceneitem_set_info(obs_sceneitem_t *item,
 		item->bounds_align = info->bounds_alignment;
 		item->bounds       = info->bounds;
 		update_item_transform(item);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -941,6 +1092,7 @@ void obs_sceneitem_set_visible(obs_sceneitem_t *item, bool visible)
 		return;
 
 	item->visible = visible;
+	obs_mark_save_dirty();
 
 	if (!item->parent)
 		return;
@@ -45,6 +45,13 @@ struct obs_scene_item {
 	struct matrix4        box_transform;
 	struct matrix4        draw_transform;
 
+	/* scene space bounding box of the drawn source, updated along with
+	 * the transforms and used to cull items that can't be seen */
+	struct vec2           draw_min;
+	struct vec2           draw_max;
+	bool                  axis_aligned;
+	bool                  culled;
+
 	enum obs_bounds_type  bounds_type;
 	uint32_t              bounds_align;
 	struct vec2           bounds;
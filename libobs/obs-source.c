@@ -124,6 +124,7 @@ bool obs_source_init(struct obs_source *source,
 	pthread_mutex_init_value(&source->filter_mutex);
 	pthread_mutex_init_value(&source->async_mutex);
 	pthread_mutex_init_value(&source->audio_mutex);
+	pthread_mutex_init_value(&source->async_audio_mutex);
 
 	if (pthread_mutexattr_init(&attr) != 0)
 		return false;
@@ -135,6 +136,8 @@ bool obs_source_init(struct obs_source *source,
 		return false;
 	if (pthread_mutex_init(&source->async_mutex, NULL) != 0)
 		return false;
+	if (pthread_mutex_init(&source->async_audio_mutex, NULL) != 0)
+		return false;
 
 	if (info && info->output_flags & OBS_SOURCE_AUDIO) {
 		source->audio_line = audio_output_create_line(obs->audio.audio,
@@ -211,6 +214,8 @@ obs_source_t *obs_source_create(enum obs_source_type type, const char *id,
 
 	if (info && info->type == OBS_SOURCE_TYPE_TRANSITION)
 		os_atomic_inc_long(&obs->data.active_transitions);
+
+	obs_mark_save_dirty();
 	return source;
 
 fail:
@@ -274,13 +279,16 @@ void obs_source_destroy(struct obs_source *source)
 		source->context.data = NULL;
 	}
 
+	obs_audio_workers_unschedule(source);
+
 	for (i = 0; i < source->async_cache.num; i++)
 		obs_source_frame_decref(source->async_cache.array[i].frame);
 
 	gs_enter_context(obs->video.graphics);
 	gs_texrender_destroy(source->async_convert_texrender);
-	gs_texture_destroy(source->async_texture);
+	gs_texture_pool_release(source->async_texture);
 	gs_texrender_destroy(source->filter_texrender);
+	gs_texrender_destroy(source->cache_texrender);
 	gs_leave_context();
 
 	for (i = 0; i < MAX_AV_PLANES; i++)
@@ -288,13 +296,17 @@ void obs_source_destroy(struct obs_source *source)
 
 	audio_line_destroy(source->audio_line);
 	audio_resampler_destroy(source->resampler);
+	audio_remixer_destroy(source->remixer);
 
 	da_free(source->async_cache);
 	da_free(source->async_frames);
 	da_free(source->filters);
+	da_free(source->async_audio_buffer);
+	circlebuf_free(&source->async_audio_queue);
 	pthread_mutex_destroy(&source->filter_mutex);
 	pthread_mutex_destroy(&source->audio_mutex);
 	pthread_mutex_destroy(&source->async_mutex);
+	pthread_mutex_destroy(&source->async_audio_mutex);
 	obs_context_data_free(&source->context);
 
 	if (source->owns_info_id)
@@ -332,6 +344,7 @@ void obs_source_remove(obs_source_t *source)
 	}
 
 	source->removed = true;
+	obs_mark_save_dirty();
 
 	obs_source_addref(source);
 
@@ -422,6 +435,7 @@ static void obs_source_deferred_update(obs_source_t *source)
 				source->context.settings);
 
 	source->defer_update = false;
+	obs_source_invalidate_cache(source);
 }
 
 void obs_source_update(obs_source_t *source, obs_data_t *settings)
@@ -431,6 +445,9 @@ void obs_source_update(obs_source_t *source, obs_data_t *settings)
 	if (settings)
 		obs_data_apply(source->context.settings, settings);
 
+	obs_mark_save_dirty();
+	obs_source_invalidate_cache(source);
+
 	if (source->info.output_flags & OBS_SOURCE_VIDEO) {
 		source->defer_update = true;
 	} else if (source->context.data && source->info.update) {
@@ -538,10 +555,25 @@ static void deactivate_source(obs_source_t *source)
 	obs_source_dosignal(source, "source_deactivate", "deactivate");
 }
 
+/* a hidden source is not rendered, so don't keep its cached frame around */
+static void free_render_cache(obs_source_t *source)
+{
+	source->cache_dirty = true;
+
+	if (!source->cache_texrender)
+		return;
+
+	obs_enter_graphics();
+	gs_texrender_destroy(source->cache_texrender);
+	source->cache_texrender = NULL;
+	obs_leave_graphics();
+}
+
 static void show_source(obs_source_t *source)
 {
 	if (source->context.data && source->info.show)
 		source->info.show(source->context.data);
+	source->cache_dirty = true;
 	obs_source_dosignal(source, "source_show", "show");
 }
 
@@ -549,6 +581,7 @@ static void hide_source(obs_source_t *source)
 {
 	if (source->context.data && source->info.hide)
 		source->info.hide(source->context.data);
+	free_render_cache(source);
 	obs_source_dosignal(source, "source_hide", "hide");
 }
 
@@ -865,7 +898,7 @@ static inline bool set_async_texture_size(struct obs_source *source,
 
 	source->async_reset_texture = false;
 
-	gs_texture_destroy(source->async_texture);
+	gs_texture_pool_release(source->async_texture);
 	gs_texrender_destroy(source->async_convert_texrender);
 	source->async_convert_texrender = NULL;
 
@@ -875,20 +908,20 @@ static inline bool set_async_texture_size(struct obs_source *source,
 		source->async_convert_texrender =
 			gs_texrender_create(GS_BGRX, GS_ZS_NONE);
 
-		source->async_texture = gs_texture_create(
+		source->async_texture = gs_texture_pool_acquire(
 				source->async_convert_width,
 				source->async_convert_height,
 				source->async_texture_format,
-				1, NULL, GS_DYNAMIC);
+				GS_DYNAMIC);
 
 	} else {
 		enum gs_color_format format = convert_video_format(
 				frame->format);
 		source->async_gpu_conversion = false;
 
-		source->async_texture = gs_texture_create(
+		source->async_texture = gs_texture_pool_acquire(
 				frame->width, frame->height,
-				format, 1, NULL, GS_DYNAMIC);
+				format, GS_DYNAMIC);
 	}
 
 	return !!source->async_texture;
@@ -1197,6 +1230,102 @@ static inline void obs_source_main_render(obs_source_t *source)
 
 static bool ready_async_frame(obs_source_t *source, uint64_t sys_time);
 
+/* ------------------------------------------------------------------------- */
+/* static source caching */
+
+static bool source_cacheable(const obs_source_t *source)
+{
+	uint32_t flags = source->info.output_flags;
+
+	if ((flags & OBS_SOURCE_STATIC) == 0 || (flags & OBS_SOURCE_ASYNC) != 0)
+		return false;
+	if (source->info.type == OBS_SOURCE_TYPE_FILTER)
+		return false;
+
+	for (size_t i = 0; i < source->filters.num; i++) {
+		obs_source_t *filter = source->filters.array[i];
+		if ((filter->info.output_flags & OBS_SOURCE_STATIC) == 0)
+			return false;
+	}
+
+	return true;
+}
+
+static void update_render_cache(obs_source_t *source, uint32_t cx,
+		uint32_t cy)
+{
+	struct vec4 clear_color;
+
+	if (!source->cache_texrender)
+		source->cache_texrender = gs_texrender_create(GS_RGBA,
+				GS_ZS_NONE);
+
+	gs_texrender_reset(source->cache_texrender);
+
+	gs_blend_state_push();
+	gs_blend_function(GS_BLEND_ONE, GS_BLEND_ZERO);
+
+	if (gs_texrender_begin(source->cache_texrender, cx, cy)) {
+		vec4_zero(&clear_color);
+		gs_clear(GS_CLEAR_COLOR, &clear_color, 0.0f, 0);
+		gs_ortho(0.0f, (float)cx, 0.0f, (float)cy, -100.0f, 100.0f);
+
+		if (source->filters.num)
+			obs_source_render_filters(source);
+		else
+			obs_source_main_render(source);
+
+		gs_texrender_end(source->cache_texrender);
+	}
+
+	gs_blend_state_pop();
+
+	source->cache_width  = cx;
+	source->cache_height = cy;
+}
+
+static bool obs_source_render_cached(obs_source_t *source)
+{
+	uint32_t     cx = obs_source_get_width(source);
+	uint32_t     cy = obs_source_get_height(source);
+	gs_effect_t  *effect = obs->video.default_effect;
+	gs_texture_t *tex;
+
+	if (!cx || !cy)
+		return false;
+
+	if (source->cache_dirty || !source->cache_texrender ||
+	    source->cache_width != cx || source->cache_height != cy) {
+		source->cache_dirty = false;
+		update_render_cache(source, cx, cy);
+	}
+
+	tex = gs_texrender_get_texture(source->cache_texrender);
+	if (!tex)
+		return false;
+
+	gs_effect_set_texture(gs_effect_get_param_by_name(effect, "image"),
+			tex);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, cx, cy);
+
+	return true;
+}
+
+void obs_source_invalidate_cache(obs_source_t *source)
+{
+	if (!source)
+		return;
+
+	/* filters are cached as part of their parent */
+	if (source->filter_parent)
+		source = source->filter_parent;
+
+	source->cache_dirty = true;
+}
+
+/* ------------------------------------------------------------------------- */
+
 void obs_source_video_render(obs_source_t *source)
 {
 	if (!source) return;
@@ -1207,6 +1336,10 @@ void obs_source_video_render(obs_source_t *source)
 		return;
 	}
 
+	if (!source->rendering_filter && source_cacheable(source) &&
+	    obs_source_render_cached(source))
+		return;
+
 	if (source->filters.num && !source->rendering_filter)
 		obs_source_render_filters(source);
 
@@ -1345,6 +1478,9 @@ void obs_source_filter_add(obs_source_t *source, obs_source_t *filter)
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_mark_save_dirty();
+	obs_source_invalidate_cache(source);
+
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
 
@@ -1377,6 +1513,9 @@ static bool obs_source_filter_remove_refless(obs_source_t *source,
 
 	pthread_mutex_unlock(&source->filter_mutex);
 
+	obs_mark_save_dirty();
+	obs_source_invalidate_cache(source);
+
 	calldata_set_ptr(&cd, "source", source);
 	calldata_set_ptr(&cd, "filter", filter);
 
@@ -1492,8 +1631,11 @@ void obs_source_filter_set_order(obs_source_t *source, obs_source_t *filter,
 	success = move_filter_dir(source, filter, movement);
 	pthread_mutex_unlock(&source->filter_mutex);
 
-	if (success)
+	if (success) {
 		obs_source_dosignal(source, NULL, "reorder_filters");
+		obs_mark_save_dirty();
+		obs_source_invalidate_cache(source);
+	}
 }
 
 obs_data_t *obs_source_get_settings(const obs_source_t *source)
@@ -1723,7 +1865,9 @@ static inline void reset_resampler(obs_source_t *source,
 	source->sample_info.speakers        = audio->speakers;
 
 	audio_resampler_destroy(source->resampler);
+	audio_remixer_destroy(source->remixer);
 	source->resampler = NULL;
+	source->remixer   = NULL;
 
 	if (source->sample_info.samples_per_sec == obs_info->samples_per_sec &&
 	    source->sample_info.format          == obs_info->format          &&
@@ -1732,6 +1876,14 @@ static inline void reset_resampler(obs_source_t *source,
 		return;
 	}
 
+	/* layout and format changes at the same rate don't need swresample */
+	source->remixer = audio_remixer_create(&output_info,
+			&source->sample_info);
+	if (source->remixer) {
+		source->audio_failed = false;
+		return;
+	}
+
 	source->resampler = audio_resampler_create(&output_info,
 			&source->sample_info);
 
@@ -1740,50 +1892,48 @@ static inline void reset_resampler(obs_source_t *source,
 		blog(LOG_ERROR, "creation of resampler failed");
 }
 
-static void copy_audio_data(obs_source_t *source,
-		const uint8_t *const data[], uint32_t frames, uint64_t ts)
+static void reserve_audio_data(obs_source_t *source, uint32_t frames,
+		uint64_t ts)
 {
 	size_t planes    = audio_output_get_planes(obs->audio.audio);
 	size_t blocksize = audio_output_get_block_size(obs->audio.audio);
 	size_t size      = (size_t)frames * blocksize;
-	bool   resize    = source->audio_storage_size < size;
 
 	source->audio_data.frames    = frames;
 	source->audio_data.timestamp = ts;
 
-	for (size_t i = 0; i < planes; i++) {
-		/* ensure audio storage capacity */
-		if (resize) {
-			bfree(source->audio_data.data[i]);
-			source->audio_data.data[i] = bmalloc(size);
-		}
+	/* ensure audio storage capacity */
+	if (source->audio_storage_size >= size)
+		return;
 
-		memcpy(source->audio_data.data[i], data[i], size);
+	for (size_t i = 0; i < planes; i++) {
+		bfree(source->audio_data.data[i]);
+		source->audio_data.data[i] = bmalloc_tagged(size,
+				BMEM_TAG_AUDIO);
 	}
 
-	if (resize)
-		source->audio_storage_size = size;
+	source->audio_storage_size = size;
 }
 
-/* TODO: SSE optimization */
-static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
+static void copy_audio_data(obs_source_t *source,
+		const uint8_t *const data[], uint32_t frames, uint64_t ts)
 {
-	size_t channels = audio_output_get_channels(obs->audio.audio);
-	const float channels_i = 1.0f / (float)channels;
-	float **data = (float**)source->audio_data.data;
+	size_t planes    = audio_output_get_planes(obs->audio.audio);
+	size_t blocksize = audio_output_get_block_size(obs->audio.audio);
+	size_t size      = (size_t)frames * blocksize;
 
-	for (size_t channel = 1; channel < channels; channel++) {
-		for (uint32_t frame = 0; frame < frames; frame++)
-			data[0][frame] += data[channel][frame];
-	}
+	reserve_audio_data(source, frames, ts);
 
-	for (uint32_t frame = 0; frame < frames; frame++)
-		data[0][frame] *= channels_i;
+	for (size_t i = 0; i < planes; i++)
+		memcpy(source->audio_data.data[i], data[i], size);
+}
 
-	for (size_t channel = 1; channel < channels; channel++) {
-		for (uint32_t frame = 0; frame < frames; frame++)
-			data[channel][frame] = data[0][frame];
-	}
+static void downmix_to_mono_planar(struct obs_source *source, uint32_t frames)
+{
+	size_t channels = audio_output_get_channels(obs->audio.audio);
+
+	audio_downmix_to_mono_planar((float**)source->audio_data.data,
+			channels, frames);
 }
 
 /* resamples/remixes new audio to the designated main audio output format */
@@ -1801,7 +1951,12 @@ static void process_audio(obs_source_t *source,
 	if (source->audio_failed)
 		return;
 
-	if (source->resampler) {
+	if (source->remixer) {
+		reserve_audio_data(source, frames, audio->timestamp);
+		audio_remixer_remix(source->remixer, source->audio_data.data,
+				audio->data, frames);
+
+	} else if (source->resampler) {
 		uint8_t  *output[MAX_AV_PLANES];
 		uint64_t offset;
 
@@ -1854,6 +2009,107 @@ void obs_source_output_audio(obs_source_t *source,
 	pthread_mutex_unlock(&source->filter_mutex);
 }
 
+/* ------------------------------------------------------------------------- */
+/* asynchronous audio input */
+
+/* limits the amount of queued audio per source before new data is dropped */
+#define MAX_ASYNC_AUDIO_QUEUE (8 * 1024 * 1024)
+
+struct async_audio_header {
+	struct obs_source_audio audio;
+	size_t                  planes;
+	size_t                  plane_size;
+};
+
+static void process_async_audio(void *param);
+
+void obs_source_output_audio_async(obs_source_t *source,
+		const struct obs_source_audio *audio)
+{
+	struct async_audio_header header;
+	bool schedule = false;
+
+	if (!source || !audio)
+		return;
+
+	if (!obs->data.num_audio_workers) {
+		obs_source_output_audio(source, audio);
+		return;
+	}
+
+	header.audio      = *audio;
+	header.planes     = get_audio_planes(audio->format, audio->speakers);
+	header.plane_size = get_audio_size(audio->format, audio->speakers,
+			audio->frames);
+
+	pthread_mutex_lock(&source->async_audio_mutex);
+
+	if (source->async_audio_queue.size > MAX_ASYNC_AUDIO_QUEUE) {
+		pthread_mutex_unlock(&source->async_audio_mutex);
+		blog(LOG_DEBUG, "Async audio queue for source '%s' is full, "
+		                "dropping %"PRIu32" frames",
+		                source->context.name, audio->frames);
+		return;
+	}
+
+	circlebuf_push_back(&source->async_audio_queue, &header,
+			sizeof(header));
+	for (size_t i = 0; i < header.planes; i++)
+		circlebuf_push_back(&source->async_audio_queue,
+				audio->data[i], header.plane_size);
+
+	if (!source->async_audio_scheduled) {
+		source->async_audio_scheduled = true;
+		schedule = true;
+	}
+
+	pthread_mutex_unlock(&source->async_audio_mutex);
+
+	if (schedule)
+		obs_audio_workers_schedule(process_async_audio, source);
+}
+
+static bool pop_async_audio(obs_source_t *source,
+		struct obs_source_audio *audio)
+{
+	struct async_audio_header header;
+	uint8_t *ptr;
+
+	pthread_mutex_lock(&source->async_audio_mutex);
+
+	if (!source->async_audio_queue.size) {
+		source->async_audio_scheduled = false;
+		pthread_mutex_unlock(&source->async_audio_mutex);
+		return false;
+	}
+
+	circlebuf_pop_front(&source->async_audio_queue, &header,
+			sizeof(header));
+	da_resize(source->async_audio_buffer,
+			header.planes * header.plane_size);
+
+	ptr = source->async_audio_buffer.array;
+	circlebuf_pop_front(&source->async_audio_queue, ptr,
+			header.planes * header.plane_size);
+
+	pthread_mutex_unlock(&source->async_audio_mutex);
+
+	*audio = header.audio;
+	for (size_t i = 0; i < header.planes; i++)
+		audio->data[i] = ptr + i * header.plane_size;
+
+	return true;
+}
+
+static void process_async_audio(void *param)
+{
+	obs_source_t *source = param;
+	struct obs_source_audio audio;
+
+	while (pop_async_audio(source, &audio))
+		obs_source_output_audio(source, &audio);
+}
+
 static inline bool frame_out_of_bounds(const obs_source_t *source, uint64_t ts)
 {
 	if (ts < source->last_frame_ts)
@@ -2040,6 +2296,42 @@ void obs_source_release_frame(obs_source_t *source,
 	}
 }
 
+static inline void skip_async_frame(obs_source_t *source)
+{
+	struct obs_source_frame *frame;
+
+	if ((source->info.output_flags & OBS_SOURCE_ASYNC) == 0)
+		return;
+
+	frame = obs_source_get_frame(source);
+	if (frame)
+		obs_source_release_frame(source, frame);
+}
+
+static void skip_async_tree(obs_source_t *parent, obs_source_t *child,
+		void *param)
+{
+	skip_async_frame(child);
+
+	UNUSED_PARAMETER(parent);
+	UNUSED_PARAMETER(param);
+}
+
+/*
+ * Consumes the frame an async source would have drawn this frame, for sources
+ * that are showing but skipped while rendering (culled scene items, for
+ * example).  Nothing else would take frames off the source's queue while it's
+ * showing, so without this the queue and frame cache would keep growing.
+ */
+void obs_source_skip_async_video(obs_source_t *source)
+{
+	if (!source_valid(source))
+		return;
+
+	skip_async_frame(source);
+	obs_source_enum_tree(source, skip_async_tree, NULL);
+}
+
 const char *obs_source_get_name(const obs_source_t *source)
 {
 	return source ? source->context.name : NULL;
@@ -2062,6 +2354,8 @@ void obs_source_set_name(obs_source_t *source, const char *name)
 		signal_handler_signal(source->context.signals, "rename", &data);
 		calldata_free(&data);
 		bfree(prev_name);
+
+		obs_mark_save_dirty();
 	}
 }
 
@@ -2250,6 +2544,7 @@ void obs_source_set_volume(obs_source_t *source, float volume)
 		calldata_free(&data);
 
 		source->user_volume = volume;
+		obs_mark_save_dirty();
 	}
 }
 
@@ -2291,6 +2586,8 @@ void obs_source_set_sync_offset(obs_source_t *source, int64_t offset)
 
 		source->sync_offset = calldata_int(&data, "offset");
 		calldata_free(&data);
+
+		obs_mark_save_dirty();
 	}
 }
 
@@ -2379,6 +2676,7 @@ bool obs_source_add_child(obs_source_t *parent, obs_source_t *child)
 		obs_source_activate(child, type);
 	}
 
+	obs_source_invalidate_cache(parent);
 	return true;
 }
 
@@ -2391,6 +2689,8 @@ void obs_source_remove_child(obs_source_t *parent, obs_source_t *child)
 		type = (i < parent->activate_refs) ? MAIN_VIEW : AUX_VIEW;
 		obs_source_deactivate(child, type);
 	}
+
+	obs_source_invalidate_cache(parent);
 }
 
 void obs_source_save(obs_source_t *source)
@@ -2434,6 +2734,7 @@ void obs_source_set_flags(obs_source_t *source, uint32_t flags)
 	if (flags != source->flags) {
 		source->flags = flags;
 		signal_flags_updated(source);
+		obs_mark_save_dirty();
 	}
 }
 
@@ -2470,6 +2771,7 @@ void obs_source_set_audio_mixers(obs_source_t *source, uint32_t mixers)
 	calldata_free(&data);
 
 	audio_line_set_mixers(source->audio_line, mixers);
+	obs_mark_save_dirty();
 }
 
 uint32_t obs_source_get_audio_mixers(const obs_source_t *source)
@@ -2679,6 +2981,8 @@ void obs_source_set_enabled(obs_source_t *source, bool enabled)
 		return;
 
 	source->enabled = enabled;
+	obs_mark_save_dirty();
+	obs_source_invalidate_cache(source);
 
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_bool(&data, "enabled", enabled);
@@ -2701,6 +3005,7 @@ void obs_source_set_muted(obs_source_t *source, bool muted)
 		return;
 
 	source->muted = muted;
+	obs_mark_save_dirty();
 
 	calldata_set_ptr(&data, "source", source);
 	calldata_set_bool(&data, "muted", muted);
@@ -103,6 +103,34 @@ enum obs_source_type {
  */
 #define OBS_SOURCE_INTERACTION (1<<5)
 
+/**
+ * Source is opaque.
+ *
+ * Specify this if the source covers its entire width and height with fully
+ * opaque pixels.  Scenes use this to skip rendering items that are
+ * completely hidden behind the source.  If the source draws nothing at times
+ * (before it has any video, for example), implement is_opaque as well.
+ */
+#define OBS_SOURCE_OPAQUE      (1<<6)
+
+/**
+ * Source is static.
+ *
+ * Specify this if the source's video only changes when its settings or size
+ * change (or when it calls obs_source_invalidate_cache).  If a source and all
+ * of its filters are static, the source and its filters are rendered to a
+ * texture once, and that texture is drawn until something changes.  The
+ * source is rendered to that texture the same way a filter renders its
+ * target, so it should draw itself in a single pass.  The cache is redrawn
+ * when the source is shown and released when it is hidden; a source that
+ * loads or unloads its content at any other time must call
+ * obs_source_invalidate_cache.
+ *
+ * For filters, this means the output depends only on the filter's settings
+ * and its target.
+ */
+#define OBS_SOURCE_STATIC      (1<<7)
+
 /** @} */
 
 typedef void (*obs_source_enum_proc_t)(obs_source_t *parent,
@@ -372,6 +400,16 @@ struct obs_source_info {
 	 * @param  source  Source that the filter being removed from
 	 */
 	void (*filter_remove)(void *data, obs_source_t *source);
+
+	/**
+	 * Returns whether the source currently covers its entire area with
+	 * fully opaque pixels.  Only used for sources with OBS_SOURCE_OPAQUE,
+	 * which are treated as always opaque if this isn't implemented.
+	 *
+	 * @param  data  Source data
+	 * @return       true if the source is currently opaque
+	 */
+	bool (*is_opaque)(void *data);
 };
 
 EXPORT void obs_register_source_s(const struct obs_source_info *info,
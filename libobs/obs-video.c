@@ -15,6 +15,7 @@
     along with this program.  If not, see <http://www.gnu.org/licenses/>.
 ******************************************************************************/
 
+#include <inttypes.h>
 #include "obs.h"
 #include "obs-internal.h"
 #include "graphics/vec4.h"
@@ -292,12 +293,58 @@ static void render_convert_texture(struct obs_core_video *video,
 	video->textures_converted[cur_texture] = true;
 }
 
+static void return_lent_surface(void *param)
+{
+	struct obs_core_video *video = &obs->video;
+	gs_stagesurf_t *surface = param;
+
+	pthread_mutex_lock(&video->lent_mutex);
+	da_push_back(video->returned_surfaces, &surface);
+	pthread_mutex_unlock(&video->lent_mutex);
+}
+
+void free_returned_surfaces(struct obs_core_video *video)
+{
+	pthread_mutex_lock(&video->lent_mutex);
+
+	for (size_t i = 0; i < video->returned_surfaces.num; i++) {
+		gs_stagesurf_t *surface = video->returned_surfaces.array[i];
+		gs_stagesurface_unmap(surface);
+		gs_stagesurface_pool_release(surface);
+	}
+
+	da_resize(video->returned_surfaces, 0);
+
+	pthread_mutex_unlock(&video->lent_mutex);
+}
+
+static inline int oldest_staging_surface(struct obs_core_video *video)
+{
+	return (video->cur_staging + 1) % video->num_staging_surfaces;
+}
+
+static inline gs_stagesurf_t *get_staging_surface(struct obs_core_video *video)
+{
+	gs_stagesurf_t **copy = &video->copy_surfaces[video->cur_staging];
+
+	/* replace surfaces that were lent to the video output */
+	if (!*copy) {
+		uint32_t height = video->gpu_conversion ?
+			video->conversion_height : video->output_height;
+
+		*copy = gs_stagesurface_pool_acquire(video->output_width,
+				height, GS_RGBA);
+	}
+
+	return *copy;
+}
+
 static inline void stage_output_texture(struct obs_core_video *video,
-		int cur_texture, int prev_texture)
+		int prev_texture)
 {
 	gs_texture_t   *texture;
 	bool        texture_ready;
-	gs_stagesurf_t *copy = video->copy_surfaces[cur_texture];
+	gs_stagesurf_t *copy;
 
 	if (video->gpu_conversion) {
 		texture = video->convert_textures[prev_texture];
@@ -312,14 +359,20 @@ static inline void stage_output_texture(struct obs_core_video *video,
 	if (!texture_ready)
 		return;
 
+	copy = get_staging_surface(video);
+	if (!copy)
+		return;
+
 	gs_stage_texture(copy, texture);
 
-	video->textures_copied[cur_texture] = true;
+	video->textures_copied[video->cur_staging] = true;
 }
 
 static inline void render_video(struct obs_core_video *video, int cur_texture,
 		int prev_texture)
 {
+	free_returned_surfaces(video);
+
 	gs_begin_scene();
 
 	gs_enable_depth_test(false);
@@ -330,7 +383,7 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	if (video->gpu_conversion)
 		render_convert_texture(video, cur_texture, prev_texture);
 
-	stage_output_texture(video, cur_texture, prev_texture);
+	stage_output_texture(video, prev_texture);
 
 	gs_set_render_target(NULL, NULL);
 	gs_enable_blending(true);
@@ -338,12 +391,15 @@ static inline void render_video(struct obs_core_video *video, int cur_texture,
 	gs_end_scene();
 }
 
+/* downloads the oldest staged frame, which is the one that will be staged
+ * over next */
 static inline bool download_frame(struct obs_core_video *video,
-		int prev_texture, struct video_data *frame)
+		struct video_data *frame)
 {
-	gs_stagesurf_t *surface = video->copy_surfaces[prev_texture];
+	int oldest = oldest_staging_surface(video);
+	gs_stagesurf_t *surface = video->copy_surfaces[oldest];
 
-	if (!video->textures_copied[prev_texture])
+	if (!video->textures_copied[oldest])
 		return false;
 
 	if (!gs_stagesurface_map(surface, &frame->data[0], &frame->linesize[0]))
@@ -454,6 +510,43 @@ static void convert_frame(
 	}
 }
 
+/*
+ * Hands the mapped staging surface to the video output instead of copying it
+ * into the output's cache.  The surface is detached from the staging ring and
+ * replaced from the resource pool, and is unmapped once the output is done
+ * with it.  Only possible if the planes don't need to be realigned.
+ */
+static bool lend_gpu_converted_data(struct obs_core_video *video,
+		struct video_data *input_frame, int count)
+{
+	gs_stagesurf_t *surface = video->mapped_surface;
+	int oldest = oldest_staging_surface(video);
+	struct video_frame frame;
+
+	if (!surface || input_frame->linesize[0] != video->output_width*4)
+		return false;
+
+	memset(&frame, 0, sizeof(frame));
+
+	for (size_t i = 0; i < 3; i++) {
+		if (video->plane_linewidth[i] == 0)
+			break;
+
+		frame.linesize[i] = video->plane_linewidth[i];
+		frame.data[i] = input_frame->data[0] + video->plane_offsets[i];
+	}
+
+	if (video_output_lend_frame(video->video, &frame, count,
+				input_frame->timestamp, return_lent_surface,
+				surface)) {
+		video->mapped_surface          = NULL;
+		video->copy_surfaces[oldest]   = NULL;
+		video->textures_copied[oldest] = false;
+	}
+
+	return true;
+}
+
 static inline void output_video_data(struct obs_core_video *video,
 		struct video_data *input_frame, int count)
 {
@@ -461,6 +554,10 @@ static inline void output_video_data(struct obs_core_video *video,
 	struct video_frame output_frame;
 	bool locked;
 
+	if (video->gpu_conversion &&
+	    lend_gpu_converted_data(video, input_frame, count))
+		return;
+
 	info = video_output_get_info(video->video);
 
 	locked = video_output_lock_frame(video->video, &output_frame, count,
@@ -478,41 +575,60 @@ static inline void output_video_data(struct obs_core_video *video,
 	}
 }
 
+/*
+ * Sleeps until the deadline of the next frame.  If the deadline has already
+ * passed, the next frame is rendered right away to catch up as long as the
+ * thread is less than num_staging_surfaces-1 frames behind, which the staging
+ * pipeline can absorb.  Only when it falls further behind are frames skipped,
+ * which duplicates the current frame in the output.
+ */
 static inline void video_sleep(struct obs_core_video *video,
 		uint64_t *p_time, uint64_t interval_ns)
 {
+	struct obs_video_pacing *pacing = &video->pacing;
 	struct obs_vframe_info vframe_info;
 	uint64_t cur_time = *p_time;
 	uint64_t t = cur_time + interval_ns;
-	int count;
+	uint64_t max_lag = interval_ns * (video->num_staging_surfaces - 1);
+	bool missed = !os_sleepto_ns(t);
+	uint64_t lag = os_gettime_ns() - t;
+	int count = 1;
 
-	if (os_sleepto_ns(t)) {
+	if (lag < max_lag) {
 		*p_time = t;
-		count = 1;
+		if (missed)
+			pacing->caught_up++;
 	} else {
-		count = (int)((os_gettime_ns() - cur_time) / interval_ns);
+		count = (int)((lag + interval_ns) / interval_ns);
 		*p_time = cur_time + interval_ns * count;
+		pacing->duplicated += count - 1;
 	}
 
+	pacing->jitter_total_ns += lag;
+	if (lag > pacing->jitter_max_ns)
+		pacing->jitter_max_ns = lag;
+
 	vframe_info.timestamp = cur_time;
 	vframe_info.count = count;
 	circlebuf_push_back(&video->vframe_info_buffer, &vframe_info,
 			sizeof(vframe_info));
 }
 
-static inline void output_frame(uint64_t *cur_time, uint64_t interval)
+static inline void output_frame(void)
 {
 	struct obs_core_video *video = &obs->video;
 	int cur_texture  = video->cur_texture;
 	int prev_texture = cur_texture == 0 ? NUM_TEXTURES-1 : cur_texture-1;
 	struct video_data frame;
 	bool frame_ready;
+	uint64_t start_time = os_gettime_ns();
+	uint64_t render_time;
 
 	memset(&frame, 0, sizeof(struct video_data));
 
 	gs_enter_context(video->graphics);
 	render_video(video, cur_texture, prev_texture);
-	frame_ready = download_frame(video, prev_texture, &frame);
+	frame_ready = download_frame(video, &frame);
 	gs_flush();
 	gs_leave_context();
 
@@ -525,10 +641,48 @@ static inline void output_frame(uint64_t *cur_time, uint64_t interval)
 		output_video_data(video, &frame, vframe_info.count);
 	}
 
+	render_time = os_gettime_ns() - start_time;
+	video->pacing.render_total_ns += render_time;
+	if (render_time > video->pacing.render_max_ns)
+		video->pacing.render_max_ns = render_time;
+	video->pacing.frames++;
+
 	if (++video->cur_texture == NUM_TEXTURES)
 		video->cur_texture = 0;
+	if (++video->cur_staging == video->num_staging_surfaces)
+		video->cur_staging = 0;
+}
+
+static inline double ns_to_ms(uint64_t ns)
+{
+	return (double)ns / 1000000.0;
+}
 
-	video_sleep(video, cur_time, interval);
+static void log_video_pacing(struct obs_core_video *video)
+{
+	struct obs_video_pacing *pacing = &video->pacing;
+
+	if (!pacing->frames)
+		return;
+
+	blog(LOG_INFO, "video pacing (staging depth %d):\n"
+	               "\tframes rendered:   %"PRIu64"\n"
+	               "\tframes duplicated: %"PRIu64" (%0.1f%%)\n"
+	               "\tframes caught up:  %"PRIu64"\n"
+	               "\trender time:       avg %0.2f ms, max %0.2f ms\n"
+	               "\tdeadline jitter:   avg %0.2f ms, max %0.2f ms",
+	               video->num_staging_surfaces,
+	               pacing->frames,
+	               pacing->duplicated,
+	               (double)pacing->duplicated /
+	               (double)(pacing->frames + pacing->duplicated) * 100.0,
+	               pacing->caught_up,
+	               ns_to_ms(pacing->render_total_ns) /
+	               (double)pacing->frames,
+	               ns_to_ms(pacing->render_max_ns),
+	               ns_to_ms(pacing->jitter_total_ns) /
+	               (double)pacing->frames,
+	               ns_to_ms(pacing->jitter_max_ns));
 }
 
 void *obs_video_thread(void *param)
@@ -539,14 +693,22 @@ void *obs_video_thread(void *param)
 
 	os_set_thread_name("libobs: graphics thread");
 
+	memset(&obs->video.pacing, 0, sizeof(obs->video.pacing));
+
 	while (!video_output_stopped(obs->video.video)) {
 		last_time = tick_sources(cur_time, last_time);
 
+		output_frame();
+
+		/* displays are drawn after the main texture so that previews
+		 * can show it without rendering the sources again */
 		render_displays();
 
-		output_frame(&cur_time, interval);
+		video_sleep(&obs->video, &cur_time, interval);
 	}
 
+	log_video_pacing(&obs->video);
+
 	UNUSED_PARAMETER(param);
 	return NULL;
 }
@@ -168,13 +168,18 @@ static bool obs_init_textures(struct obs_video_info *ovi)
 		video->conversion_height : ovi->output_height;
 	size_t i;
 
-	for (i = 0; i < NUM_TEXTURES; i++) {
-		video->copy_surfaces[i] = gs_stagesurface_create(
+	video->num_staging_surfaces = video->staging_depth ?
+		(int)video->staging_depth : DEFAULT_STAGING_SURFACES;
+
+	for (i = 0; i < (size_t)video->num_staging_surfaces; i++) {
+		video->copy_surfaces[i] = gs_stagesurface_pool_acquire(
 				ovi->output_width, output_height, GS_RGBA);
 
 		if (!video->copy_surfaces[i])
 			return false;
+	}
 
+	for (i = 0; i < NUM_TEXTURES; i++) {
 		video->render_textures[i] = gs_texture_create(
 				ovi->base_width, ovi->base_height,
 				GS_RGBA, 1, NULL, GS_RENDER_TARGET);
@@ -321,6 +326,10 @@ static int obs_init_video(struct obs_video_info *ovi)
 		return OBS_VIDEO_FAIL;
 	}
 
+	pthread_mutex_init_value(&video->lent_mutex);
+	if (pthread_mutex_init(&video->lent_mutex, NULL) != 0)
+		return OBS_VIDEO_FAIL;
+
 	if (!obs_display_init(&video->main_display, NULL))
 		return OBS_VIDEO_FAIL;
 
@@ -367,6 +376,7 @@ static void obs_free_video(void)
 	if (video->video) {
 		obs_display_free(&video->main_display);
 
+		/* closing the output returns every lent surface */
 		video_output_close(video->video);
 		video->video = NULL;
 
@@ -375,18 +385,25 @@ static void obs_free_video(void)
 
 		gs_enter_context(video->graphics);
 
+		free_returned_surfaces(video);
+		da_free(video->returned_surfaces);
+		pthread_mutex_destroy(&video->lent_mutex);
+
 		if (video->mapped_surface) {
 			gs_stagesurface_unmap(video->mapped_surface);
 			video->mapped_surface = NULL;
 		}
 
+		for (size_t i = 0; i < MAX_STAGING_SURFACES; i++) {
+			gs_stagesurface_pool_release(video->copy_surfaces[i]);
+			video->copy_surfaces[i] = NULL;
+		}
+
 		for (size_t i = 0; i < NUM_TEXTURES; i++) {
-			gs_stagesurface_destroy(video->copy_surfaces[i]);
 			gs_texture_destroy(video->render_textures[i]);
 			gs_texture_destroy(video->convert_textures[i]);
 			gs_texture_destroy(video->output_textures[i]);
 
-			video->copy_surfaces[i]    = NULL;
 			video->render_textures[i]  = NULL;
 			video->convert_textures[i] = NULL;
 			video->output_textures[i]  = NULL;
@@ -406,6 +423,7 @@ static void obs_free_video(void)
 				sizeof(video->textures_converted));
 
 		video->cur_texture = 0;
+		video->cur_staging = 0;
 	}
 }
 
@@ -462,6 +480,155 @@ static void obs_free_audio(void)
 	memset(audio, 0, sizeof(struct obs_core_audio));
 }
 
+/* ------------------------------------------------------------------------- */
+/* audio worker pool, shared by asynchronous audio sources and audio encoders */
+
+static void *audio_worker_thread(void *param)
+{
+	struct obs_core_data *data = &obs->data;
+	size_t idx = (size_t)param;
+
+	os_set_thread_name("libobs: audio worker thread");
+
+	while (os_sem_wait(data->audio_workers_sem) == 0) {
+		struct audio_worker_task task = {0};
+
+		if (data->audio_workers_stop)
+			break;
+
+		pthread_mutex_lock(&data->audio_workers_mutex);
+		if (data->audio_workers_queue.num) {
+			task = data->audio_workers_queue.array[0];
+			data->audio_workers_busy[idx] = task.param;
+			da_erase(data->audio_workers_queue, 0);
+		}
+		pthread_mutex_unlock(&data->audio_workers_mutex);
+
+		if (!task.process)
+			continue;
+
+		task.process(task.param);
+
+		pthread_mutex_lock(&data->audio_workers_mutex);
+		data->audio_workers_busy[idx] = NULL;
+		pthread_cond_broadcast(&data->audio_workers_idle);
+		pthread_mutex_unlock(&data->audio_workers_mutex);
+	}
+
+	return NULL;
+}
+
+void obs_audio_workers_schedule(void (*process)(void *param), void *param)
+{
+	struct obs_core_data *data = &obs->data;
+	struct audio_worker_task task = {process, param};
+
+	pthread_mutex_lock(&data->audio_workers_mutex);
+	da_push_back(data->audio_workers_queue, &task);
+	pthread_mutex_unlock(&data->audio_workers_mutex);
+
+	os_sem_post(data->audio_workers_sem);
+}
+
+static inline bool audio_worker_busy(struct obs_core_data *data, void *param)
+{
+	for (size_t i = 0; i < data->num_audio_workers; i++)
+		if (data->audio_workers_busy[i] == param)
+			return true;
+	return false;
+}
+
+static inline bool is_current_worker(struct obs_core_data *data, void *param)
+{
+	pthread_t self = pthread_self();
+
+	for (size_t i = 0; i < data->num_audio_workers; i++)
+		if (data->audio_workers_busy[i] == param &&
+		    pthread_equal(data->audio_workers[i], self))
+			return true;
+	return false;
+}
+
+/* called after the object has stopped producing work: removes any pending
+ * work for it and waits for a worker that may still be using it.  returns
+ * false without waiting if called from the worker processing it (an encoder
+ * destroyed as the worker finishes stopping it, for example), the caller's
+ * own work is then still in progress further up the stack. */
+bool obs_audio_workers_unschedule(void *param)
+{
+	struct obs_core_data *data = &obs->data;
+	bool idle = true;
+
+	if (!data->num_audio_workers)
+		return true;
+
+	pthread_mutex_lock(&data->audio_workers_mutex);
+
+	for (size_t i = data->audio_workers_queue.num; i > 0; i--) {
+		struct audio_worker_task *task =
+			data->audio_workers_queue.array + (i - 1);
+		if (task->param == param)
+			da_erase(data->audio_workers_queue, i - 1);
+	}
+
+	if (is_current_worker(data, param))
+		idle = false;
+	else
+		while (audio_worker_busy(data, param))
+			pthread_cond_wait(&data->audio_workers_idle,
+					&data->audio_workers_mutex);
+
+	pthread_mutex_unlock(&data->audio_workers_mutex);
+	return idle;
+}
+
+static bool obs_audio_workers_init(void)
+{
+	struct obs_core_data *data = &obs->data;
+
+	pthread_mutex_init_value(&data->audio_workers_mutex);
+
+	if (pthread_mutex_init(&data->audio_workers_mutex, NULL) != 0)
+		return false;
+	if (pthread_cond_init(&data->audio_workers_idle, NULL) != 0)
+		return false;
+	if (os_sem_init(&data->audio_workers_sem, 0) != 0)
+		return false;
+
+	for (size_t i = 0; i < NUM_AUDIO_WORKERS; i++) {
+		if (pthread_create(&data->audio_workers[i], NULL,
+					audio_worker_thread, (void*)i) != 0) {
+			blog(LOG_ERROR, "Failed to create audio worker "
+			                "thread %d", (int)i);
+			break;
+		}
+
+		data->num_audio_workers++;
+	}
+
+	return data->num_audio_workers != 0;
+}
+
+static void obs_audio_workers_free(void)
+{
+	struct obs_core_data *data = &obs->data;
+	size_t num = data->num_audio_workers;
+
+	data->audio_workers_stop = true;
+	data->num_audio_workers  = 0;
+
+	for (size_t i = 0; i < num; i++)
+		os_sem_post(data->audio_workers_sem);
+	for (size_t i = 0; i < num; i++)
+		pthread_join(data->audio_workers[i], NULL);
+
+	da_free(data->audio_workers_queue);
+	os_sem_destroy(data->audio_workers_sem);
+	pthread_cond_destroy(&data->audio_workers_idle);
+	pthread_mutex_destroy(&data->audio_workers_mutex);
+	data->audio_workers_sem = NULL;
+}
+
 static bool obs_init_data(void)
 {
 	struct obs_core_data *data = &obs->data;
@@ -489,6 +656,8 @@ static bool obs_init_data(void)
 		goto fail;
 	if (!obs_view_init(&data->main_view))
 		goto fail;
+	if (!obs_audio_workers_init())
+		goto fail;
 
 	data->valid = true;
 
@@ -544,6 +713,8 @@ static void obs_free_data(void)
 	FREE_OBS_LINKED_LIST(display);
 	FREE_OBS_LINKED_LIST(service);
 
+	obs_audio_workers_free();
+
 	pthread_mutex_destroy(&data->user_sources_mutex);
 	pthread_mutex_destroy(&data->sources_mutex);
 	pthread_mutex_destroy(&data->displays_mutex);
@@ -760,6 +931,18 @@ int obs_reset_video(struct obs_video_info *ovi)
 	return obs_init_video(ovi);
 }
 
+void obs_set_video_staging_depth(uint32_t depth)
+{
+	if (!obs) return;
+
+	if (depth && depth < 2)
+		depth = 2;
+	else if (depth > MAX_STAGING_SURFACES)
+		depth = MAX_STAGING_SURFACES;
+
+	obs->video.staging_depth = depth;
+}
+
 bool obs_reset_audio(const struct obs_audio_info *oai)
 {
 	struct audio_output_info ai;
@@ -1030,6 +1213,8 @@ void obs_set_output_source(uint32_t channel, obs_source_t *source)
 
 	pthread_mutex_unlock(&view->channels_mutex);
 
+	obs_mark_save_dirty();
+
 	if (source)
 		obs_source_activate(source, MAIN_VIEW);
 
@@ -1227,6 +1412,34 @@ void obs_render_main_view(void)
 	obs_view_render(&obs->data.main_view);
 }
 
+void obs_render_main_texture(void)
+{
+	struct obs_core_video *video;
+	gs_texture_t *tex;
+	gs_effect_t  *effect;
+	gs_eparam_t  *param;
+	int          last_texture;
+
+	if (!obs) return;
+
+	video = &obs->video;
+	last_texture = video->cur_texture == 0 ?
+		NUM_TEXTURES - 1 : video->cur_texture - 1;
+
+	if (!video->textures_rendered[last_texture])
+		return;
+
+	tex    = video->render_textures[last_texture];
+	effect = video->default_effect;
+	param  = gs_effect_get_param_by_name(effect, "image");
+	gs_effect_set_texture(param, tex);
+
+	gs_enable_blending(false);
+	while (gs_effect_loop(effect, "Draw"))
+		gs_draw_sprite(tex, 0, 0, 0);
+	gs_enable_blending(true);
+}
+
 void obs_set_master_volume(float volume)
 {
 	struct calldata data = {0};
@@ -1423,6 +1636,11 @@ obs_data_array_t *obs_save_sources(void)
 	return array;
 }
 
+long obs_get_save_generation(void)
+{
+	return obs ? obs->data.save_generation : 0;
+}
+
 /* ensures that names are never blank */
 static inline char *dup_name(const char *name)
 {
@@ -281,6 +281,17 @@ EXPORT const char *obs_get_locale(void);
  */
 EXPORT int obs_reset_video(struct obs_video_info *ovi);
 
+/**
+ * Sets how many frames the graphics thread may keep in flight between
+ * staging an output frame and downloading it (2 to 4, 0 for the default).
+ * Deeper pipelines hide GPU readback latency and let the graphics thread
+ * absorb longer stalls without duplicating frames, at the cost of output
+ * latency.
+ *
+ * @note Takes effect on the next call to obs_reset_video.
+ */
+EXPORT void obs_set_video_staging_depth(uint32_t depth);
+
 /**
  * Sets base audio output format/channels/samples/etc
  *
@@ -531,6 +542,13 @@ EXPORT void obs_resize(uint32_t cx, uint32_t cy);
 /** Renders the main view */
 EXPORT void obs_render_main_view(void);
 
+/**
+ * Draws the most recently composited main view texture at base resolution
+ * instead of rendering the sources again.  Use this in previews and
+ * projectors of the main view; it only works from display draw callbacks.
+ */
+EXPORT void obs_render_main_texture(void);
+
 /** Sets the master user volume */
 EXPORT void obs_set_master_volume(float volume);
 
@@ -555,6 +573,13 @@ EXPORT void obs_load_sources(obs_data_array_t *array);
 /** Saves sources to a data array */
 EXPORT obs_data_array_t *obs_save_sources(void);
 
+/**
+ * Returns a counter that changes whenever anything saved by obs_save_sources
+ * (or the output channels) changes.  Comparing it against the value from the
+ * last save allows skipping saves when nothing has changed.
+ */
+EXPORT long obs_get_save_generation(void);
+
 
 /* ------------------------------------------------------------------------- */
 /* View context */
@@ -598,6 +623,12 @@ EXPORT obs_display_t *obs_display_create(
 /** Destroys a display context */
 EXPORT void obs_display_destroy(obs_display_t *display);
 
+/**
+ * Limits how often the display is redrawn.  0 (the default) redraws the
+ * display every frame.
+ */
+EXPORT void obs_display_set_max_fps(obs_display_t *display, uint32_t fps);
+
 /** Changes the size of this display */
 EXPORT void obs_display_resize(obs_display_t *display, uint32_t cx,
 		uint32_t cy);
@@ -676,6 +707,12 @@ EXPORT void obs_source_update(obs_source_t *source, obs_data_t *settings);
 /** Renders a video source. */
 EXPORT void obs_source_video_render(obs_source_t *source);
 
+/**
+ * Tells libobs the video of a static source (or the output of a static
+ * filter) has changed, and any cached rendering of it must be redrawn.
+ */
+EXPORT void obs_source_invalidate_cache(obs_source_t *source);
+
 /** Gets the width of a source (if it has video) */
 EXPORT uint32_t obs_source_get_width(obs_source_t *source);
 
@@ -875,6 +912,15 @@ EXPORT void obs_source_output_video(obs_source_t *source,
 EXPORT void obs_source_output_audio(obs_source_t *source,
 		const struct obs_source_audio *audio);
 
+/**
+ * Queues audio data to be processed on the libobs audio worker pool instead
+ * of the calling thread.  The data is copied, so this is safe to call from
+ * device callbacks that must return quickly.  Resampling, filtering, and
+ * output are performed in order for each source.
+ */
+EXPORT void obs_source_output_audio_async(obs_source_t *source,
+		const struct obs_source_audio *audio);
+
 /** Signal an update to any currently used properties via 'update_properties' */
 EXPORT void obs_source_update_properties(obs_source_t *source);
 
@@ -1069,7 +1115,13 @@ EXPORT const char *obs_output_get_name(const obs_output_t *output);
 /** Starts the output. */
 EXPORT bool obs_output_start(obs_output_t *output);
 
-/** Stops the output. */
+/**
+ * Stops the output.  Packets that the output's encoders still hold back are
+ * drained into the output first, which happens on a separate thread:  the
+ * output stays active until it has stopped, which is signaled by its "stop"
+ * signal (emitted from that thread).  Starting or destroying the output
+ * waits for a pending stop to finish.
+ */
 EXPORT void obs_output_stop(obs_output_t *output);
 
 /** Returns whether the output is active */
@@ -1179,6 +1231,14 @@ EXPORT uint64_t obs_output_get_total_bytes(const obs_output_t *output);
 EXPORT int obs_output_get_frames_dropped(const obs_output_t *output);
 EXPORT int obs_output_get_total_frames(const obs_output_t *output);
 
+/**
+ * Returns the largest amount of time (in microseconds) that packets of a
+ * track had to wait in the interleaver for the other tracks to catch up.
+ * track_idx is ignored for video.
+ */
+EXPORT int64_t obs_output_get_interleave_skew(const obs_output_t *output,
+		enum obs_encoder_type type, size_t track_idx);
+
 /**
  * Sets the preferred scaled resolution for this output.  Set width and height
  * to 0 to disable scaling.
@@ -14,71 +14,63 @@
  * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#if defined(__linux__)
+#include <sys/mman.h>
+#endif
 #include "base.h"
 #include "bmem.h"
 #include "threading.h"
 
-/*
- * NOTE: totally jacked the mem alignment trick from ffmpeg, credit to them:
- *   http://www.ffmpeg.org/
- */
-
 #define ALIGNMENT 32
 
-/* TODO: use memalign for non-windows systems */
-#if defined(_WIN32)
-#define ALIGNED_MALLOC 1
-#else
-#define ALIGNMENT_HACK 1
-#endif
-
 static void *a_malloc(size_t size)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	return _aligned_malloc(size, ALIGNMENT);
-#elif ALIGNMENT_HACK
+#else
 	void *ptr = NULL;
-	long diff;
-
-	ptr  = malloc(size + ALIGNMENT);
-	diff = ((~(long)ptr) & (ALIGNMENT - 1)) + 1;
-	ptr  = (char *)ptr + diff;
-	((char *)ptr)[-1] = (char)diff;
-
+	if (posix_memalign(&ptr, ALIGNMENT, size) != 0)
+		return NULL;
 	return ptr;
-#else
-	return malloc(size);
 #endif
 }
 
 static void *a_realloc(void *ptr, size_t size)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	return _aligned_realloc(ptr, size, ALIGNMENT);
-#elif ALIGNMENT_HACK
-	long diff;
+#else
+	void *new_ptr;
 
 	if (!ptr)
 		return a_malloc(size);
-	diff = ((char *)ptr)[-1];
-	ptr = realloc((char*)ptr - diff, size + diff);
-	if (ptr)
-		ptr = (char *)ptr + diff;
-	return ptr;
-#else
-	return realloc(ptr, size);
+
+	/* realloc only keeps malloc's own alignment, so if the block moved to
+	 * an unaligned address it has to be moved once more */
+	ptr = realloc(ptr, size);
+	if (!ptr || ((uintptr_t)ptr & (ALIGNMENT - 1)) == 0)
+		return ptr;
+
+	new_ptr = a_malloc(size);
+	if (new_ptr)
+		memcpy(new_ptr, ptr, size);
+	free(ptr);
+	return new_ptr;
 #endif
 }
 
 static void a_free(void *ptr)
 {
-#ifdef ALIGNED_MALLOC
+#ifdef _WIN32
 	_aligned_free(ptr);
-#elif ALIGNMENT_HACK
-	if (ptr)
-		free((char *)ptr - ((char*)ptr)[-1]);
 #else
 	free(ptr);
 #endif
@@ -86,45 +78,400 @@ static void a_free(void *ptr)
 
 static struct base_allocator alloc = {a_malloc, a_realloc, a_free};
 static long num_allocs = 0;
+static volatile int64_t tag_bytes[BMEM_TAG_COUNT] = {0};
+
+static const char *tag_names[BMEM_TAG_COUNT] = {
+	"general",
+	"video",
+	"audio",
+	"encoder"
+};
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Every allocation is preceded by a header (padded to the alignment, so the
+ * returned pointer stays aligned) that records its size and tag for the
+ * per-subsystem counters, and whether it belongs to the media pool.
+ */
+
+#define BMEM_MAPPED    (1<<0)
+#define BMEM_HUGEPAGES (1<<1)
+
+struct bmem_header {
+	size_t   size;
+	size_t   block_size; /* media pool block size, 0 if not pooled */
+	uint32_t tag;
+	uint32_t flags;
+};
+
+#define HEADER_SIZE ALIGNMENT
+
+typedef char header_size_check[
+	sizeof(struct bmem_header) <= HEADER_SIZE ? 1 : -1];
+
+static inline void *header_to_ptr(struct bmem_header *header)
+{
+	return (uint8_t*)header + HEADER_SIZE;
+}
+
+static inline struct bmem_header *ptr_to_header(void *ptr)
+{
+	return (struct bmem_header*)((uint8_t*)ptr - HEADER_SIZE);
+}
+
+static inline void account(uint32_t tag, int64_t bytes)
+{
+	os_atomic_add_int64(&tag_bytes[tag], bytes);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * Media pool: large buffers (video frames and the like) are rounded up to a
+ * size class and recycled instead of going back to the system, so that
+ * resolution changes and frame caches don't keep faulting in fresh pages.
+ * On linux blocks are mapped directly and prefaulted, optionally backed by
+ * transparent huge pages.  The least recently used classes are released
+ * once the pool holds more than media_max_cached bytes.
+ */
+
+#define MEDIA_MIN_SIZE      (256 * 1024)
+#define MEDIA_GRANULARITY   (64 * 1024)
+#define MEDIA_MAX_CLASSES   16
+#define MEDIA_DEFAULT_CACHE (256 * 1024 * 1024)
+#define HUGE_PAGE_SIZE      (2 * 1024 * 1024)
+#define PAGE_SIZE_DEFAULT   4096
+
+struct media_class {
+	size_t             block_size;
+	struct bmem_header *free_blocks;
+	size_t             num_free;
+	uint64_t           last_used;
+};
+
+static pthread_mutex_t    media_mutex = PTHREAD_MUTEX_INITIALIZER;
+static struct media_class media_classes[MEDIA_MAX_CLASSES];
+static size_t             media_cached = 0;
+static size_t             media_max_cached = MEDIA_DEFAULT_CACHE;
+static bool               media_hugepages = false;
+static uint64_t           media_clock = 0;
+
+static inline struct bmem_header **next_block(struct bmem_header *header)
+{
+	return (struct bmem_header**)header_to_ptr(header);
+}
+
+static inline size_t mapped_size(size_t block_size, uint32_t flags)
+{
+	size_t page = (flags & BMEM_HUGEPAGES) ?
+		HUGE_PAGE_SIZE : PAGE_SIZE_DEFAULT;
+	return (block_size + HEADER_SIZE + page - 1) & ~(page - 1);
+}
+
+static struct bmem_header *media_block_alloc(size_t block_size, bool huge)
+{
+	struct bmem_header *header;
+
+#if defined(__linux__)
+	uint32_t flags = BMEM_MAPPED;
+	size_t   len;
+	void     *mem;
+
+	if (huge && block_size + HEADER_SIZE >= HUGE_PAGE_SIZE)
+		flags |= BMEM_HUGEPAGES;
+
+	len = mapped_size(block_size, flags);
+
+	if (flags & BMEM_HUGEPAGES) {
+		/* the advice has to be given before the pages are touched, so
+		 * prefault by hand rather than with MAP_POPULATE */
+		mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mem != MAP_FAILED) {
+			madvise(mem, len, MADV_HUGEPAGE);
+			memset(mem, 0, len);
+		}
+	} else {
+		mem = mmap(NULL, len, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE,
+				-1, 0);
+	}
+
+	if (mem == MAP_FAILED)
+		return NULL;
+
+	header = mem;
+	header->flags = flags;
+#else
+	UNUSED_PARAMETER(huge);
+
+	header = alloc.malloc(block_size + HEADER_SIZE);
+	if (!header)
+		return NULL;
+
+	header->flags = 0;
+#endif
+
+	header->block_size = block_size;
+	return header;
+}
+
+static void media_block_free(struct bmem_header *header)
+{
+#if defined(__linux__)
+	if (header->flags & BMEM_MAPPED) {
+		munmap(header, mapped_size(header->block_size, header->flags));
+		return;
+	}
+#endif
+	alloc.free(header);
+}
+
+static void media_free_list(struct bmem_header *header)
+{
+	while (header) {
+		struct bmem_header *next = *next_block(header);
+		media_block_free(header);
+		header = next;
+	}
+}
+
+static struct media_class *find_class(size_t block_size)
+{
+	for (size_t i = 0; i < MEDIA_MAX_CLASSES; i++) {
+		if (media_classes[i].block_size == block_size)
+			return &media_classes[i];
+	}
+
+	return NULL;
+}
+
+static struct media_class *lru_class(bool need_free_blocks)
+{
+	struct media_class *lru = NULL;
+
+	for (size_t i = 0; i < MEDIA_MAX_CLASSES; i++) {
+		struct media_class *class = &media_classes[i];
+
+		if (need_free_blocks && !class->num_free)
+			continue;
+		if (!lru || class->last_used < lru->last_used)
+			lru = class;
+	}
+
+	return lru;
+}
+
+/* moves every free block of the class to the given list, must be called with
+ * media_mutex locked */
+static void evict_class(struct media_class *class,
+		struct bmem_header **to_free)
+{
+	while (class->free_blocks) {
+		struct bmem_header *header = class->free_blocks;
+
+		class->free_blocks = *next_block(header);
+		*next_block(header) = *to_free;
+		*to_free = header;
+	}
+
+	media_cached -= class->block_size * class->num_free;
+	class->num_free = 0;
+}
+
+/* evicts the least recently used blocks until the new size fits, must be
+ * called with media_mutex locked */
+static void media_trim(size_t incoming, struct bmem_header **to_free)
+{
+	while (media_cached + incoming > media_max_cached) {
+		struct media_class *class = lru_class(true);
+		struct bmem_header *header;
+
+		if (!class)
+			break;
+
+		header = class->free_blocks;
+		class->free_blocks = *next_block(header);
+		class->num_free--;
+		media_cached -= class->block_size;
+
+		*next_block(header) = *to_free;
+		*to_free = header;
+	}
+}
+
+static struct media_class *get_class(size_t block_size,
+		struct bmem_header **to_free)
+{
+	struct media_class *class = find_class(block_size);
+
+	if (!class) {
+		class = find_class(0);
+		if (!class) {
+			class = lru_class(false);
+			evict_class(class, to_free);
+		}
+
+		class->block_size = block_size;
+	}
+
+	return class;
+}
+
+static void media_release(struct bmem_header *header)
+{
+	struct bmem_header *to_free = NULL;
+	size_t block_size = header->block_size;
+
+	pthread_mutex_lock(&media_mutex);
+
+	if (block_size <= media_max_cached) {
+		struct media_class *class = get_class(block_size, &to_free);
+
+		media_trim(block_size, &to_free);
+
+		*next_block(header) = class->free_blocks;
+		class->free_blocks = header;
+		class->num_free++;
+		class->last_used = ++media_clock;
+		media_cached += block_size;
+		header = NULL;
+	}
+
+	pthread_mutex_unlock(&media_mutex);
+
+	if (header)
+		media_block_free(header);
+	media_free_list(to_free);
+}
+
+/* ------------------------------------------------------------------------- */
 
 void base_set_allocator(struct base_allocator *defs)
 {
 	memcpy(&alloc, defs, sizeof(struct base_allocator));
 }
 
-void *bmalloc(size_t size)
+void *bmalloc_tagged(size_t size, enum bmem_tag tag)
 {
-	void *ptr = alloc.malloc(size);
-	if (!ptr && !size)
-		ptr = alloc.malloc(1);
-	if (!ptr)
+	struct bmem_header *header = alloc.malloc(size + HEADER_SIZE);
+	if (!header)
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 
+	header->size       = size;
+	header->block_size = 0;
+	header->tag        = (uint32_t)tag;
+	header->flags      = 0;
+
 	os_atomic_inc_long(&num_allocs);
-	return ptr;
+	account(tag, (int64_t)size);
+	return header_to_ptr(header);
+}
+
+void *bmalloc(size_t size)
+{
+	return bmalloc_tagged(size, BMEM_TAG_GENERAL);
+}
+
+void *bmalloc_media(size_t size, enum bmem_tag tag)
+{
+	struct bmem_header *header = NULL;
+	struct media_class *class;
+	size_t block_size;
+	bool   huge;
+
+	if (size < MEDIA_MIN_SIZE)
+		return bmalloc_tagged(size, tag);
+
+	block_size = (size + MEDIA_GRANULARITY - 1) &
+		~(size_t)(MEDIA_GRANULARITY - 1);
+
+	pthread_mutex_lock(&media_mutex);
+
+	class = find_class(block_size);
+	if (class && class->free_blocks) {
+		header = class->free_blocks;
+		class->free_blocks = *next_block(header);
+		class->num_free--;
+		class->last_used = ++media_clock;
+		media_cached -= block_size;
+	}
+
+	huge = media_hugepages;
+
+	pthread_mutex_unlock(&media_mutex);
+
+	if (!header) {
+		header = media_block_alloc(block_size, huge);
+		if (!header)
+			bcrash("Out of memory while trying to allocate %lu "
+			       "bytes", (unsigned long)size);
+	}
+
+	header->size = size;
+	header->tag  = (uint32_t)tag;
+
+	os_atomic_inc_long(&num_allocs);
+	account(tag, (int64_t)size);
+	return header_to_ptr(header);
 }
 
 void *brealloc(void *ptr, size_t size)
 {
-	if (!ptr)
-		os_atomic_inc_long(&num_allocs);
+	struct bmem_header *header;
+	size_t old_size;
+	uint32_t tag;
 
-	ptr = alloc.realloc(ptr, size);
-	if (!ptr && !size)
-		ptr = alloc.realloc(ptr, 1);
 	if (!ptr)
+		return bmalloc(size);
+
+	header   = ptr_to_header(ptr);
+	old_size = header->size;
+	tag      = header->tag;
+
+	if (header->block_size) {
+		void *new_ptr;
+
+		if (size <= header->block_size) {
+			header->size = size;
+			account(tag, (int64_t)size - (int64_t)old_size);
+			return ptr;
+		}
+
+		new_ptr = bmalloc_tagged(size, (enum bmem_tag)tag);
+		memcpy(new_ptr, ptr, old_size);
+		bfree(ptr);
+		return new_ptr;
+	}
+
+	header = alloc.realloc(header, size + HEADER_SIZE);
+	if (!header)
 		bcrash("Out of memory while trying to allocate %lu bytes",
 				(unsigned long)size);
 
-	return ptr;
+	header->size = size;
+	account(tag, (int64_t)size - (int64_t)old_size);
+	return header_to_ptr(header);
 }
 
 void bfree(void *ptr)
 {
-	if (ptr)
-		os_atomic_dec_long(&num_allocs);
-	alloc.free(ptr);
+	struct bmem_header *header;
+
+	if (!ptr)
+		return;
+
+	header = ptr_to_header(ptr);
+
+	os_atomic_dec_long(&num_allocs);
+	account(header->tag, -(int64_t)header->size);
+
+	if (header->block_size)
+		media_release(header);
+	else
+		alloc.free(header);
 }
 
 long bnum_allocs(void)
@@ -132,6 +479,44 @@ long bnum_allocs(void)
 	return num_allocs;
 }
 
+int64_t bmem_get_tag_bytes(enum bmem_tag tag)
+{
+	if (tag >= BMEM_TAG_COUNT)
+		return 0;
+	return tag_bytes[tag];
+}
+
+const char *bmem_get_tag_name(enum bmem_tag tag)
+{
+	return tag < BMEM_TAG_COUNT ? tag_names[tag] : NULL;
+}
+
+void bmem_set_media_pool(size_t max_cached, bool hugepages)
+{
+	struct bmem_header *to_free = NULL;
+
+	pthread_mutex_lock(&media_mutex);
+
+	media_max_cached = max_cached;
+	media_hugepages  = hugepages;
+	media_trim(0, &to_free);
+
+	pthread_mutex_unlock(&media_mutex);
+
+	media_free_list(to_free);
+}
+
+size_t bmem_get_media_pool_size(void)
+{
+	size_t size;
+
+	pthread_mutex_lock(&media_mutex);
+	size = media_cached;
+	pthread_mutex_unlock(&media_mutex);
+
+	return size;
+}
+
 int base_get_alignment(void)
 {
 	return ALIGNMENT;
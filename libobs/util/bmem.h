@@ -33,14 +33,44 @@ struct base_allocator {
 
 EXPORT void base_set_allocator(struct base_allocator *defs);
 
+/** Subsystems whose allocated bytes are counted separately */
+enum bmem_tag {
+	BMEM_TAG_GENERAL,
+	BMEM_TAG_VIDEO,
+	BMEM_TAG_AUDIO,
+	BMEM_TAG_ENCODER,
+	BMEM_TAG_COUNT
+};
+
 EXPORT void *bmalloc(size_t size);
 EXPORT void *brealloc(void *ptr, size_t size);
 EXPORT void bfree(void *ptr);
 
+/** Allocates memory counted under the given tag, freed with bfree */
+EXPORT void *bmalloc_tagged(size_t size, enum bmem_tag tag);
+
+/**
+ * Allocates a large media buffer (such as a video frame) from the media pool,
+ * which recycles buffers of similar size instead of returning them to the
+ * system.  Small sizes fall back to bmalloc_tagged.  Freed with bfree.
+ */
+EXPORT void *bmalloc_media(size_t size, enum bmem_tag tag);
+
+/**
+ * Sets how many bytes of freed media buffers the pool may keep, and whether
+ * new pool buffers should be backed by huge pages where supported.
+ */
+EXPORT void bmem_set_media_pool(size_t max_cached, bool hugepages);
+EXPORT size_t bmem_get_media_pool_size(void);
+
 EXPORT int base_get_alignment(void);
 
 EXPORT long bnum_allocs(void);
 
+/** Returns the number of bytes currently allocated under the given tag */
+EXPORT int64_t bmem_get_tag_bytes(enum bmem_tag tag);
+EXPORT const char *bmem_get_tag_name(enum bmem_tag tag);
+
 EXPORT void *bmemdup(const void *ptr, size_t size);
 
 static inline void *bzalloc(size_t size)
@@ -27,6 +27,13 @@
 struct config_item {
 	char *name;
 	char *value;
+
+	/* the value parsed as each type when it's set, so the typed getters
+	 * don't have to parse it again on every call */
+	int64_t  int_val;
+	uint64_t uint_val;
+	double   double_val;
+	bool     bool_val;
 };
 
 static inline void config_item_free(struct config_item *item)
@@ -52,12 +59,198 @@ static inline void config_section_free(struct config_section *section)
 	bfree(section->name);
 }
 
+struct config_key {
+	uint32_t hash;
+	uint32_t section; /* section index + 1, 0 when empty */
+	uint32_t item;
+};
+
+/* open addressing hash table of section/item pairs.  the size is always a
+ * power of two and kept at least twice the number of keys */
+struct config_index {
+	struct config_key *table;
+	size_t            size;
+	size_t            num;
+};
+
 struct config_data {
 	char *file;
 	struct darray sections; /* struct config_section */
 	struct darray defaults; /* struct config_section */
+	struct config_index sections_index;
+	struct config_index defaults_index;
 };
 
+static inline int64_t str_to_int64(const char *str)
+{
+	if (!str || !*str)
+		return 0;
+
+	if (str[0] == '0' && str[1] == 'x')
+		return strtoll(str + 2, NULL, 16);
+	else
+		return strtoll(str, NULL, 10);
+}
+
+static inline uint64_t str_to_uint64(const char *str)
+{
+	if (!str || !*str)
+		return 0;
+
+	if (str[0] == '0' && str[1] == 'x')
+		return strtoull(str + 2, NULL, 16);
+	else
+		return strtoull(str, NULL, 10);
+}
+
+static void config_item_set_value(struct config_item *item, char *value)
+{
+	bfree(item->value);
+	item->value      = value;
+	item->int_val    = str_to_int64(value);
+	item->uint_val   = str_to_uint64(value);
+	item->double_val = *value ? os_strtod(value) : 0.0;
+	item->bool_val   = astrcmpi(value, "true") == 0 || !!item->uint_val;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static inline char lower_char(char ch)
+{
+	return (ch >= 'A' && ch <= 'Z') ? (char)(ch + 0x20) : ch;
+}
+
+static inline uint32_t hash_str(uint32_t hash, const char *str)
+{
+	while (*str) {
+		hash ^= (uint8_t)lower_char(*(str++));
+		hash *= 16777619U;
+	}
+
+	return hash;
+}
+
+/* case insensitive FNV-1a of the section and name */
+static inline uint32_t hash_key(const char *section, const char *name)
+{
+	uint32_t hash = hash_str(2166136261U, section);
+	hash ^= 0xFF;
+	hash *= 16777619U;
+	return hash_str(hash, name);
+}
+
+static inline struct config_section *get_section(
+		const struct darray *sections, size_t idx)
+{
+	return (struct config_section*)sections->array + idx;
+}
+
+static inline struct config_item *get_item(const struct darray *sections,
+		size_t section_idx, size_t item_idx)
+{
+	struct config_section *section = get_section(sections, section_idx);
+	return (struct config_item*)section->items.array + item_idx;
+}
+
+static struct config_key *index_find(const struct config_index *index,
+		const struct darray *sections, const char *section,
+		const char *name, uint32_t hash)
+{
+	size_t mask = index->size - 1;
+	size_t idx  = hash & mask;
+
+	if (!index->size)
+		return NULL;
+
+	for (;;) {
+		struct config_key *key = index->table + idx;
+
+		if (!key->section)
+			return key;
+
+		if (key->hash == hash) {
+			struct config_section *sec;
+			struct config_item *item;
+
+			sec  = get_section(sections, key->section - 1);
+			item = get_item(sections, key->section - 1, key->item);
+
+			if (astrcmpi(sec->name, section) == 0 &&
+			    astrcmpi(item->name, name) == 0)
+				return key;
+		}
+
+		idx = (idx + 1) & mask;
+	}
+}
+
+static void index_insert(struct config_index *index,
+		const struct darray *sections, size_t section_idx,
+		size_t item_idx);
+
+static void index_grow(struct config_index *index,
+		const struct darray *sections)
+{
+	size_t new_size = index->size ? index->size * 2 : 64;
+	struct config_key *old_table = index->table;
+	size_t old_size = index->size;
+
+	index->table = bzalloc(new_size * sizeof(struct config_key));
+	index->size  = new_size;
+	index->num   = 0;
+
+	for (size_t i = 0; i < old_size; i++) {
+		struct config_key *key = old_table + i;
+		if (key->section)
+			index_insert(index, sections, key->section - 1,
+					key->item);
+	}
+
+	bfree(old_table);
+}
+
+/* the first occurrence of a key wins, just like the old linear search */
+static void index_insert(struct config_index *index,
+		const struct darray *sections, size_t section_idx,
+		size_t item_idx)
+{
+	struct config_section *sec = get_section(sections, section_idx);
+	struct config_item *item = get_item(sections, section_idx, item_idx);
+	uint32_t hash = hash_key(sec->name, item->name);
+	struct config_key *key;
+
+	if ((index->num + 1) * 2 > index->size)
+		index_grow(index, sections);
+
+	key = index_find(index, sections, sec->name, item->name, hash);
+	if (key->section)
+		return;
+
+	key->hash    = hash;
+	key->section = (uint32_t)section_idx + 1;
+	key->item    = (uint32_t)item_idx;
+	index->num++;
+}
+
+static void index_build(struct config_index *index,
+		const struct darray *sections)
+{
+	for (size_t i = 0; i < sections->num; i++) {
+		struct config_section *sec = get_section(sections, i);
+
+		for (size_t j = 0; j < sec->items.num; j++)
+			index_insert(index, sections, i, j);
+	}
+}
+
+static inline void index_free(struct config_index *index)
+{
+	bfree(index->table);
+	memset(index, 0, sizeof(*index));
+}
+
+/* ------------------------------------------------------------------------- */
+
 config_t *config_create(const char *file)
 {
 	struct config_data *config;
@@ -118,9 +311,9 @@ static bool config_parse_string(struct lexer *lex, struct strref *ref,
 static void config_add_item(struct darray *items, struct strref *name,
 		struct strref *value)
 {
-	struct config_item item;
-	item.name  = bstrdup_n(name->array,  name->len);
-	item.value = bstrdup_n(value->array, value->len);
+	struct config_item item = {0};
+	item.name = bstrdup_n(name->array, name->len);
+	config_item_set_value(&item, bstrdup_n(value->array, value->len));
 	darray_push_back(sizeof(struct config_item), items, &item);
 }
 
@@ -249,6 +442,8 @@ int config_open(config_t **config, const char *file,
 	if (errorcode != CONFIG_SUCCESS) {
 		config_close(*config);
 		*config = NULL;
+	} else {
+		index_build(&(*config)->sections_index, &(*config)->sections);
 	}
 
 	return errorcode;
@@ -272,22 +467,31 @@ int config_open_string(config_t **config, const char *str)
 	parse_config_data(&(*config)->sections, &lex);
 	lexer_free(&lex);
 
+	index_build(&(*config)->sections_index, &(*config)->sections);
 	return CONFIG_SUCCESS;
 }
 
 int config_open_defaults(config_t *config, const char *file)
 {
+	int errorcode;
+
 	if (!config)
 		return CONFIG_ERROR;
 
-	return config_parse_file(&config->defaults, file, false);
+	errorcode = config_parse_file(&config->defaults, file, false);
+
+	/* rebuilt as a whole because the file may add to existing defaults */
+	index_free(&config->defaults_index);
+	index_build(&config->defaults_index, &config->defaults);
+	return errorcode;
 }
 
 int config_save(config_t *config)
 {
 	FILE *f;
-	struct dstr str;
+	struct dstr str, temp_file;
 	size_t i, j;
+	int ret = CONFIG_SUCCESS;
 
 	if (!config)
 		return CONFIG_ERROR;
@@ -295,10 +499,16 @@ int config_save(config_t *config)
 		return CONFIG_ERROR;
 
 	dstr_init(&str);
-
-	f = os_fopen(config->file, "wb");
-	if (!f)
+	dstr_init_copy(&temp_file, config->file);
+	dstr_cat(&temp_file, ".tmp");
+
+	/* write to a temporary file first so an interrupted save can't leave
+	 * a truncated config behind */
+	f = os_fopen(temp_file.array, "wb");
+	if (!f) {
+		dstr_free(&temp_file);
 		return CONFIG_FILENOTFOUND;
+	}
 
 	for (i = 0; i < config->sections.num; i++) {
 		struct config_section *section = darray_item(
@@ -326,12 +536,21 @@ int config_save(config_t *config)
 #ifdef _WIN32
 	fwrite("\xEF\xBB\xBF", 1, 3, f);
 #endif
-	fwrite(str.array, 1, str.len, f);
-	fclose(f);
-
+	if (str.len && fwrite(str.array, 1, str.len, f) != str.len)
+		ret = CONFIG_ERROR;
+	if (fclose(f) != 0)
+		ret = CONFIG_ERROR;
+
+	if (ret == CONFIG_SUCCESS &&
+	    os_rename(temp_file.array, config->file) != 0)
+		ret = CONFIG_ERROR;
+	if (ret != CONFIG_SUCCESS)
+		os_unlink(temp_file.array);
+
+	dstr_free(&temp_file);
 	dstr_free(&str);
 
-	return CONFIG_SUCCESS;
+	return ret;
 }
 
 void config_close(config_t *config)
@@ -351,6 +570,8 @@ void config_close(config_t *config)
 
 	darray_free(&config->defaults);
 	darray_free(&config->sections);
+	index_free(&config->defaults_index);
+	index_free(&config->sections_index);
 	bfree(config->file);
 	bfree(config);
 }
@@ -374,52 +595,38 @@ const char *config_get_section(config_t *config, size_t idx)
 }
 
 static const struct config_item *config_find_item(const struct darray *sections,
+		const struct config_index *index,
 		const char *section, const char *name)
 {
-	size_t i, j;
-
-	for (i = 0; i < sections->num; i++) {
-		const struct config_section *sec = darray_item(
-				sizeof(struct config_section), sections, i);
-
-		if (astrcmpi(sec->name, section) == 0) {
-			for (j = 0; j < sec->items.num; j++) {
-				struct config_item *item = darray_item(
-						sizeof(struct config_item),
-						&sec->items, j);
+	const struct config_key *key;
 
-				if (astrcmpi(item->name, name) == 0)
-					return item;
-			}
-		}
-	}
+	key = index_find(index, sections, section, name,
+			hash_key(section, name));
+	if (!key || !key->section)
+		return NULL;
 
-	return NULL;
+	return get_item(sections, key->section - 1, key->item);
 }
 
-static void config_set_item(struct darray *sections, const char *section,
-		const char *name, char *value)
+static void config_set_item(struct darray *sections,
+		struct config_index *index,
+		const char *section, const char *name, char *value)
 {
 	struct config_section *sec = NULL;
-	struct config_section *array = sections->array;
 	struct config_item *item;
-	size_t i, j;
+	size_t i;
+
+	item = (struct config_item*)config_find_item(sections, index,
+			section, name);
+	if (item) {
+		config_item_set_value(item, value);
+		return;
+	}
 
 	for (i = 0; i < sections->num; i++) {
-		struct config_section *cur_sec = array+i;
-		struct config_item *items = cur_sec->items.array;
+		struct config_section *cur_sec = get_section(sections, i);
 
 		if (astrcmpi(cur_sec->name, section) == 0) {
-			for (j = 0; j < cur_sec->items.num; j++) {
-				item = items+j;
-
-				if (astrcmpi(item->name, name) == 0) {
-					bfree(item->value);
-					item->value = value;
-					return;
-				}
-			}
-
 			sec = cur_sec;
 			break;
 		}
@@ -433,7 +640,23 @@ static void config_set_item(struct darray *sections, const char *section,
 
 	item = darray_push_back_new(sizeof(struct config_item), &sec->items);
 	item->name  = bstrdup(name);
-	item->value = value;
+	config_item_set_value(item, value);
+
+	index_insert(index, sections, i, sec->items.num - 1);
+}
+
+static inline void set_user_item(config_t *config, const char *section,
+		const char *name, char *value)
+{
+	config_set_item(&config->sections, &config->sections_index,
+			section, name, value);
+}
+
+static inline void set_default_item(config_t *config, const char *section,
+		const char *name, char *value)
+{
+	config_set_item(&config->defaults, &config->defaults_index,
+			section, name, value);
 }
 
 void config_set_string(config_t *config, const char *section,
@@ -441,7 +664,7 @@ void config_set_string(config_t *config, const char *section,
 {
 	if (!value)
 		value = "";
-	config_set_item(&config->sections, section, name, bstrdup(value));
+	set_user_item(config, section, name, bstrdup(value));
 }
 
 void config_set_int(config_t *config, const char *section,
@@ -450,7 +673,7 @@ void config_set_int(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%lld", value);
-	config_set_item(&config->sections, section, name, str.array);
+	set_user_item(config, section, name, str.array);
 }
 
 void config_set_uint(config_t *config, const char *section,
@@ -459,14 +682,14 @@ void config_set_uint(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%llu", value);
-	config_set_item(&config->sections, section, name, str.array);
+	set_user_item(config, section, name, str.array);
 }
 
 void config_set_bool(config_t *config, const char *section,
 		const char *name, bool value)
 {
 	char *str = bstrdup(value ? "true" : "false");
-	config_set_item(&config->sections, section, name, str);
+	set_user_item(config, section, name, str);
 }
 
 void config_set_double(config_t *config, const char *section,
@@ -474,7 +697,7 @@ void config_set_double(config_t *config, const char *section,
 {
 	char *str = bzalloc(64);
 	os_dtostr(value, str, 64);
-	config_set_item(&config->sections, section, name, str);
+	set_user_item(config, section, name, str);
 }
 
 void config_set_default_string(config_t *config, const char *section,
@@ -482,7 +705,7 @@ void config_set_default_string(config_t *config, const char *section,
 {
 	if (!value)
 		value = "";
-	config_set_item(&config->defaults, section, name, bstrdup(value));
+	set_default_item(config, section, name, bstrdup(value));
 }
 
 void config_set_default_int(config_t *config, const char *section,
@@ -491,7 +714,7 @@ void config_set_default_int(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%lld", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	set_default_item(config, section, name, str.array);
 }
 
 void config_set_default_uint(config_t *config, const char *section,
@@ -500,14 +723,14 @@ void config_set_default_uint(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%llu", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	set_default_item(config, section, name, str.array);
 }
 
 void config_set_default_bool(config_t *config, const char *section,
 		const char *name, bool value)
 {
 	char *str = bstrdup(value ? "true" : "false");
-	config_set_item(&config->defaults, section, name, str);
+	set_default_item(config, section, name, str);
 }
 
 void config_set_default_double(config_t *config, const char *section,
@@ -516,147 +739,114 @@ void config_set_default_double(config_t *config, const char *section,
 	struct dstr str;
 	dstr_init(&str);
 	dstr_printf(&str, "%g", value);
-	config_set_item(&config->defaults, section, name, str.array);
+	set_default_item(config, section, name, str.array);
 }
 
-const char *config_get_string(const config_t *config, const char *section,
-		const char *name)
+static inline const struct config_item *find_user_item(
+		const config_t *config, const char *section, const char *name)
 {
-	const struct config_item *item = config_find_item(&config->sections,
+	return config_find_item(&config->sections, &config->sections_index,
 			section, name);
-	if (!item)
-		item = config_find_item(&config->defaults, section, name);
-	if (!item)
-		return NULL;
-
-	return item->value;
 }
 
-static inline int64_t str_to_int64(const char *str)
+static inline const struct config_item *find_default_item(
+		const config_t *config, const char *section, const char *name)
 {
-	if (!str || !*str)
-		return 0;
-
-	if (str[0] == '0' && str[1] == 'x')
-		return strtoll(str + 2, NULL, 16);
-	else
-		return strtoll(str, NULL, 10);
+	return config_find_item(&config->defaults, &config->defaults_index,
+			section, name);
 }
 
-static inline uint64_t str_to_uint64(const char *str)
+static inline const struct config_item *find_item(const config_t *config,
+		const char *section, const char *name)
 {
-	if (!str || !*str)
-		return 0;
+	const struct config_item *item = find_user_item(config, section, name);
+	return item ? item : find_default_item(config, section, name);
+}
 
-	if (str[0] == '0' && str[1] == 'x')
-		return strtoull(str + 2, NULL, 16);
-	else
-		return strtoull(str, NULL, 10);
+const char *config_get_string(const config_t *config, const char *section,
+		const char *name)
+{
+	const struct config_item *item = find_item(config, section, name);
+	return item ? item->value : NULL;
 }
 
 int64_t config_get_int(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return str_to_int64(value);
-
-	return 0;
+	const struct config_item *item = find_item(config, section, name);
+	return item ? item->int_val : 0;
 }
 
 uint64_t config_get_uint(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return str_to_uint64(value);
-
-	return 0;
+	const struct config_item *item = find_item(config, section, name);
+	return item ? item->uint_val : 0;
 }
 
 bool config_get_bool(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return astrcmpi(value, "true") == 0 ||
-		       !!str_to_uint64(value);
-
-	return false;
+	const struct config_item *item = find_item(config, section, name);
+	return item ? item->bool_val : false;
 }
 
 double config_get_double(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_string(config, section, name);
-	if (value)
-		return os_strtod(value);
-
-	return 0.0;
+	const struct config_item *item = find_item(config, section, name);
+	return item ? item->double_val : 0.0;
 }
 
 const char *config_get_default_string(const config_t *config,
 		const char *section, const char *name)
 {
 	const struct config_item *item;
-
-	item = config_find_item(&config->defaults, section, name);
-	if (!item)
-		return NULL;
-
-	return item->value;
+	item = find_default_item(config, section, name);
+	return item ? item->value : NULL;
 }
 
 int64_t config_get_default_int(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return str_to_int64(value);
-
-	return 0;
+	const struct config_item *item;
+	item = find_default_item(config, section, name);
+	return item ? item->int_val : 0;
 }
 
 uint64_t config_get_default_uint(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return str_to_uint64(value);
-
-	return 0;
+	const struct config_item *item;
+	item = find_default_item(config, section, name);
+	return item ? item->uint_val : 0;
 }
 
 bool config_get_default_bool(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return astrcmpi(value, "true") == 0 ||
-		       !!str_to_uint64(value);
-
-	return false;
+	const struct config_item *item;
+	item = find_default_item(config, section, name);
+	return item ? item->bool_val : false;
 }
 
 double config_get_default_double(const config_t *config, const char *section,
 		const char *name)
 {
-	const char *value = config_get_default_string(config, section, name);
-	if (value)
-		return os_strtod(value);
-
-	return 0.0;
+	const struct config_item *item;
+	item = find_default_item(config, section, name);
+	return item ? item->double_val : 0.0;
 }
 
 bool config_has_user_value(const config_t *config, const char *section,
 		const char *name)
 {
-	return config_find_item(&config->sections, section, name) != NULL;
+	return find_user_item(config, section, name) != NULL;
 }
 
 bool config_has_default_value(const config_t *config, const char *section,
 		const char *name)
 {
-	return config_find_item(&config->defaults, section, name) != NULL;
+	return find_default_item(config, section, name) != NULL;
 }
 
@@ -0,0 +1,306 @@
+/*
+ * Copyright (c) 2013 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#if defined(__linux__) && !defined(_GNU_SOURCE)
+#define _GNU_SOURCE
+#endif
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <unistd.h>
+#include <fcntl.h>
+#endif
+
+#include "bmem.h"
+#include "base.h"
+#include "circlebuf.h"
+#include "threading.h"
+#include "platform.h"
+#include "file-writer.h"
+
+#define DEFAULT_BUFFER_SIZE (32 * 1024 * 1024)
+#define DEFAULT_CHUNK_SIZE  (1024 * 1024)
+
+struct file_writer {
+	FILE                     *file;
+	struct file_writer_info  info;
+
+	pthread_mutex_t          mutex;
+	struct circlebuf         buffer;
+	uint8_t                  *chunk;
+	bool                     writing;
+	volatile bool            error;
+
+	pthread_t                thread;
+	bool                     thread_active;
+	volatile bool            stop;
+	os_event_t               *data_event;
+
+	/* broadcast whenever a chunk has been written, both blocked writes
+	 * and flushes wait on it */
+	pthread_cond_t           space_cond;
+	bool                     space_cond_valid;
+
+	int64_t                  offset;
+	uint64_t                 unsynced;
+	struct file_writer_stats stats;
+};
+
+static void sync_file(FILE *file)
+{
+	fflush(file);
+#ifdef _WIN32
+	_commit(_fileno(file));
+#else
+	fsync(fileno(file));
+#endif
+}
+
+static void preallocate_file(FILE *file, uint64_t size)
+{
+#if defined(__linux__)
+	/* keep the visible file size so a short recording doesn't end up with
+	 * trailing zeroes */
+	if (fallocate(fileno(file), FALLOC_FL_KEEP_SIZE, 0, (off_t)size) != 0)
+		blog(LOG_DEBUG, "file_writer: preallocation not supported");
+#else
+	UNUSED_PARAMETER(file);
+	UNUSED_PARAMETER(size);
+#endif
+}
+
+static bool write_chunk(struct file_writer *writer)
+{
+	size_t size;
+
+	pthread_mutex_lock(&writer->mutex);
+
+	size = writer->buffer.size;
+	if (size > writer->info.chunk_size)
+		size = writer->info.chunk_size;
+	if (size) {
+		circlebuf_pop_front(&writer->buffer, writer->chunk, size);
+		writer->writing = true;
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	if (!size)
+		return false;
+
+	if (!writer->error && fwrite(writer->chunk, 1, size, writer->file) !=
+			size) {
+		blog(LOG_ERROR, "file_writer: failed to write %d bytes",
+				(int)size);
+		writer->error = true;
+	}
+
+	writer->unsynced += size;
+	if (writer->info.sync == FILE_WRITER_SYNC_INTERVAL &&
+	    writer->unsynced >= writer->info.sync_interval) {
+		sync_file(writer->file);
+		writer->unsynced = 0;
+	}
+
+	pthread_mutex_lock(&writer->mutex);
+	writer->writing = false;
+	writer->stats.bytes_written += size;
+	pthread_cond_broadcast(&writer->space_cond);
+	pthread_mutex_unlock(&writer->mutex);
+
+	return true;
+}
+
+static void *file_writer_thread(void *data)
+{
+	struct file_writer *writer = data;
+
+	os_set_thread_name("file writer thread");
+
+	while (os_event_wait(writer->data_event) == 0) {
+		while (write_chunk(writer));
+
+		if (writer->stop)
+			break;
+	}
+
+	return NULL;
+}
+
+static void file_writer_free(struct file_writer *writer)
+{
+	if (writer->thread_active) {
+		writer->stop = true;
+		os_event_signal(writer->data_event);
+		pthread_join(writer->thread, NULL);
+	}
+
+	if (writer->file)
+		fclose(writer->file);
+
+	os_event_destroy(writer->data_event);
+	if (writer->space_cond_valid)
+		pthread_cond_destroy(&writer->space_cond);
+	pthread_mutex_destroy(&writer->mutex);
+	circlebuf_free(&writer->buffer);
+	bfree(writer->chunk);
+	bfree(writer);
+}
+
+file_writer_t *file_writer_open(const char *path,
+		const struct file_writer_info *info)
+{
+	struct file_writer *writer = bzalloc(sizeof(struct file_writer));
+	pthread_mutex_init_value(&writer->mutex);
+
+	if (info)
+		writer->info = *info;
+	if (!writer->info.buffer_size)
+		writer->info.buffer_size = DEFAULT_BUFFER_SIZE;
+	if (!writer->info.chunk_size)
+		writer->info.chunk_size = DEFAULT_CHUNK_SIZE;
+	if (writer->info.chunk_size > writer->info.buffer_size)
+		writer->info.chunk_size = writer->info.buffer_size;
+
+	if (pthread_mutex_init(&writer->mutex, NULL) != 0)
+		goto fail;
+	if (os_event_init(&writer->data_event, OS_EVENT_TYPE_AUTO) != 0)
+		goto fail;
+	if (pthread_cond_init(&writer->space_cond, NULL) != 0)
+		goto fail;
+	writer->space_cond_valid = true;
+
+	writer->file = os_fopen(path, "wb");
+	if (!writer->file)
+		goto fail;
+
+	/* we already write in large chunks, no need for stdio buffering */
+	setvbuf(writer->file, NULL, _IONBF, 0);
+
+	if (writer->info.preallocate)
+		preallocate_file(writer->file, writer->info.preallocate);
+
+	writer->chunk = bmalloc(writer->info.chunk_size);
+	circlebuf_reserve(&writer->buffer, writer->info.chunk_size);
+
+	if (pthread_create(&writer->thread, NULL, file_writer_thread,
+				writer) != 0)
+		goto fail;
+
+	writer->thread_active = true;
+	return writer;
+
+fail:
+	file_writer_free(writer);
+	return NULL;
+}
+
+bool file_writer_write(file_writer_t *writer, const void *data, size_t size)
+{
+	if (!writer || writer->error)
+		return false;
+	if (!size)
+		return true;
+
+	pthread_mutex_lock(&writer->mutex);
+
+	/* block instead of dropping data, but always accept a write into an
+	 * empty buffer even if it's larger than the buffer limit */
+	while (writer->buffer.size &&
+	       writer->buffer.size + size > writer->info.buffer_size &&
+	       !writer->error) {
+		writer->stats.stalls++;
+
+		os_event_signal(writer->data_event);
+		pthread_cond_wait(&writer->space_cond, &writer->mutex);
+	}
+
+	circlebuf_push_back(&writer->buffer, data, size);
+	writer->offset += (int64_t)size;
+	writer->stats.bytes_queued += size;
+	if (writer->buffer.size > writer->stats.max_backlog)
+		writer->stats.max_backlog = writer->buffer.size;
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	os_event_signal(writer->data_event);
+	return !writer->error;
+}
+
+int64_t file_writer_tell(file_writer_t *writer)
+{
+	int64_t offset;
+
+	if (!writer)
+		return -1;
+
+	pthread_mutex_lock(&writer->mutex);
+	offset = writer->offset;
+	pthread_mutex_unlock(&writer->mutex);
+	return offset;
+}
+
+bool file_writer_flush(file_writer_t *writer)
+{
+	if (!writer)
+		return false;
+
+	pthread_mutex_lock(&writer->mutex);
+
+	while ((writer->buffer.size || writer->writing) && !writer->error) {
+		os_event_signal(writer->data_event);
+		pthread_cond_wait(&writer->space_cond, &writer->mutex);
+	}
+
+	pthread_mutex_unlock(&writer->mutex);
+
+	fflush(writer->file);
+	return !writer->error;
+}
+
+FILE *file_writer_get_file(file_writer_t *writer)
+{
+	return writer ? writer->file : NULL;
+}
+
+void file_writer_get_stats(file_writer_t *writer,
+		struct file_writer_stats *stats)
+{
+	if (!writer || !stats)
+		return;
+
+	pthread_mutex_lock(&writer->mutex);
+	*stats = writer->stats;
+	stats->backlog = writer->buffer.size;
+	pthread_mutex_unlock(&writer->mutex);
+}
+
+bool file_writer_close(file_writer_t *writer)
+{
+	bool success;
+
+	if (!writer)
+		return false;
+
+	success = file_writer_flush(writer);
+
+	if (writer->info.sync != FILE_WRITER_SYNC_NONE)
+		sync_file(writer->file);
+
+	file_writer_free(writer);
+	return success;
+}
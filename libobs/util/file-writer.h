@@ -0,0 +1,86 @@
+/*
+ * Copyright (c) 2013 Hugh Bailey <obs.jim@gmail.com>
+ *
+ * Permission to use, copy, modify, and distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR
+ * ANY SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN
+ * ACTION OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF
+ * OR IN CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#pragma once
+
+/*
+ * Asynchronous file writer
+ *
+ *   Queues data in a bounded write-behind buffer and writes it to disk in
+ * large chunks from a separate thread, so that slow storage does not stall
+ * the thread producing the data.  If the buffer fills up, writes block until
+ * there is room again rather than dropping data.
+ */
+
+#include <stdio.h>
+#include "c99defs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+enum file_writer_sync {
+	FILE_WRITER_SYNC_NONE,     /* leave flushing to the OS */
+	FILE_WRITER_SYNC_INTERVAL, /* fsync every sync_interval bytes */
+	FILE_WRITER_SYNC_CLOSE     /* fsync once when the file is closed */
+};
+
+struct file_writer_info {
+	size_t                buffer_size;  /* max queued bytes, 0 = default */
+	size_t                chunk_size;   /* bytes per write, 0 = default */
+	uint64_t              preallocate;  /* bytes to reserve, if supported */
+	enum file_writer_sync sync;
+	uint64_t              sync_interval;
+};
+
+struct file_writer_stats {
+	uint64_t              bytes_queued;
+	uint64_t              bytes_written;
+	size_t                backlog;      /* bytes waiting to be written */
+	size_t                max_backlog;
+	uint32_t              stalls;       /* times a write had to wait */
+};
+
+/* opaque typedef */
+struct file_writer;
+typedef struct file_writer file_writer_t;
+
+/* functions */
+EXPORT file_writer_t *file_writer_open(const char *path,
+		const struct file_writer_info *info);
+EXPORT bool file_writer_write(file_writer_t *writer, const void *data,
+		size_t size);
+
+/** Returns the offset the next queued write will be written at */
+EXPORT int64_t file_writer_tell(file_writer_t *writer);
+
+/**
+ * Waits for all queued data to be written.  Afterwards, and until the next
+ * file_writer_write call, the underlying file can be accessed directly (for
+ * example to go back and patch a header).
+ */
+EXPORT bool file_writer_flush(file_writer_t *writer);
+EXPORT FILE *file_writer_get_file(file_writer_t *writer);
+
+EXPORT void file_writer_get_stats(file_writer_t *writer,
+		struct file_writer_stats *stats);
+
+/** Flushes, syncs according to the sync policy, and closes the file */
+EXPORT bool file_writer_close(file_writer_t *writer);
+
+#ifdef __cplusplus
+}
+#endif
@@ -296,6 +296,11 @@ int os_unlink(const char *path)
 	return unlink(path);
 }
 
+int os_rename(const char *old_path, const char *new_path)
+{
+	return rename(old_path, new_path);
+}
+
 int os_mkdir(const char *path)
 {
 	if (mkdir(path, 0777) == 0)
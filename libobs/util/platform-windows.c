@@ -395,6 +395,27 @@ int os_unlink(const char *path)
 	return success ? 0 : -1;
 }
 
+int os_rename(const char *old_path, const char *new_path)
+{
+	wchar_t *old_path_utf16 = NULL;
+	wchar_t *new_path_utf16 = NULL;
+	int code = -1;
+
+	os_utf8_to_wcs_ptr(old_path, 0, &old_path_utf16);
+	os_utf8_to_wcs_ptr(new_path, 0, &new_path_utf16);
+
+	if (old_path_utf16 && new_path_utf16) {
+		if (MoveFileExW(old_path_utf16, new_path_utf16,
+					MOVEFILE_REPLACE_EXISTING |
+					MOVEFILE_WRITE_THROUGH))
+			code = 0;
+	}
+
+	bfree(old_path_utf16);
+	bfree(new_path_utf16);
+	return code;
+}
+
 int os_mkdir(const char *path)
 {
 	wchar_t *path_utf16;
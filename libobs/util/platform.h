@@ -129,6 +129,9 @@ EXPORT void os_globfree(os_glob_t *pglob);
 
 EXPORT int os_unlink(const char *path);
 
+/** Renames a file, replacing the destination if it already exists */
+EXPORT int os_rename(const char *old_path, const char *new_path);
+
 #define MKDIR_EXISTS   1
 #define MKDIR_SUCCESS  0
 #define MKDIR_ERROR   -1
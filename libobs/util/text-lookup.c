@@ -15,168 +15,179 @@
  */
 
 #include "dstr.h"
+#include "darray.h"
 #include "text-lookup.h"
 #include "lexer.h"
 #include "platform.h"
 
 /* ------------------------------------------------------------------------- */
 
-struct text_leaf {
-	char *lookup, *value;
+/* all names and values are stored back to back in a single string buffer,
+ * entries only refer to them by offset */
+struct text_entry {
+	uint32_t hash;
+	uint32_t name;
+	uint32_t value;
 };
 
-static inline void text_leaf_destroy(struct text_leaf *leaf)
-{
-	if (leaf) {
-		bfree(leaf->lookup);
-		bfree(leaf->value);
-		bfree(leaf);
-	}
-}
-
-/* ------------------------------------------------------------------------- */
+struct text_lookup {
+	struct dstr                language;
 
-struct text_node {
-	struct dstr str;
-	struct text_node *first_subnode;
-	struct text_leaf *leaf;
+	DARRAY(char)               strings;
+	DARRAY(struct text_entry)  entries;
 
-	struct text_node *next;
+	/* open addressing hash table of entry index + 1, 0 when empty.  the
+	 * size is always a power of two and kept at least twice the number of
+	 * entries so probe sequences stay short */
+	uint32_t                   *table;
+	size_t                     table_size;
 };
 
-static void text_node_destroy(struct text_node *node)
+static inline char lower_char(char ch)
 {
-	struct text_node *subnode;
-
-	if (!node)
-		return;
+	return (ch >= 'A' && ch <= 'Z') ? (char)(ch + 0x20) : ch;
+}
 
-	subnode = node->first_subnode;
-	while (subnode) {
-		struct text_node *destroy_node = subnode;
+/* case insensitive FNV-1a */
+static inline uint32_t hash_name(const char *name, size_t len)
+{
+	uint32_t hash = 2166136261U;
 
-		subnode = subnode->next;
-		text_node_destroy(destroy_node);
+	for (size_t i = 0; i < len && name[i]; i++) {
+		hash ^= (uint8_t)lower_char(name[i]);
+		hash *= 16777619U;
 	}
 
-	dstr_free(&node->str);
-	if (node->leaf)
-		text_leaf_destroy(node->leaf);
-	bfree(node);
+	return hash;
 }
 
-static struct text_node *text_node_bychar(struct text_node *node, char ch)
+static inline bool names_match(const char *name1, const char *name2,
+		size_t len2)
 {
-	struct text_node *subnode = node->first_subnode;
-
-	while (subnode) {
-		if (!dstr_is_empty(&subnode->str) &&
-		    subnode->str.array[0] == ch)
-			return subnode;
+	size_t i;
 
-		subnode = subnode->next;
+	for (i = 0; i < len2 && name2[i]; i++) {
+		if (lower_char(name1[i]) != lower_char(name2[i]))
+			return false;
 	}
 
-	return NULL;
+	return name1[i] == 0;
+}
+
+static inline const char *lookup_str(struct text_lookup *lookup,
+		uint32_t offset)
+{
+	return lookup->strings.array + offset;
 }
 
-static struct text_node *text_node_byname(struct text_node *node,
-		const char *name)
+static size_t lookup_find(struct text_lookup *lookup, const char *name,
+		size_t len, uint32_t hash)
 {
-	struct text_node *subnode = node->first_subnode;
+	size_t mask = lookup->table_size - 1;
+	size_t idx  = hash & mask;
+
+	if (!lookup->table_size)
+		return DARRAY_INVALID;
+
+	for (;;) {
+		uint32_t entry_idx = lookup->table[idx];
+		struct text_entry *entry;
+
+		if (!entry_idx)
+			return DARRAY_INVALID;
 
-	while (subnode) {
-		if (astrcmpi_n(subnode->str.array, name, subnode->str.len) == 0)
-			return subnode;
+		entry = lookup->entries.array + (entry_idx - 1);
+		if (entry->hash == hash &&
+		    names_match(lookup_str(lookup, entry->name), name, len))
+			return entry_idx - 1;
 
-		subnode = subnode->next;
+		idx = (idx + 1) & mask;
 	}
+}
+
+static void lookup_insert_index(struct text_lookup *lookup, size_t entry_idx)
+{
+	size_t mask = lookup->table_size - 1;
+	size_t idx  = lookup->entries.array[entry_idx].hash & mask;
+
+	while (lookup->table[idx])
+		idx = (idx + 1) & mask;
 
-	return NULL;
+	lookup->table[idx] = (uint32_t)entry_idx + 1;
 }
 
-/* ------------------------------------------------------------------------- */
+static void lookup_grow_table(struct text_lookup *lookup)
+{
+	size_t new_size = lookup->table_size ? lookup->table_size * 2 : 256;
 
-struct text_lookup {
-	struct dstr language;
-	struct text_node *top;
-};
+	bfree(lookup->table);
+	lookup->table      = bzalloc(new_size * sizeof(uint32_t));
+	lookup->table_size = new_size;
 
-static void lookup_createsubnode(const char *lookup_val,
-		struct text_leaf *leaf, struct text_node *node)
+	for (size_t i = 0; i < lookup->entries.num; i++)
+		lookup_insert_index(lookup, i);
+}
+
+static uint32_t lookup_add_name(struct text_lookup *lookup, const char *str,
+		size_t len)
 {
-	struct text_node *new = bzalloc(sizeof(struct text_node));
-	new->leaf = leaf;
-	new->next = node->first_subnode;
-	dstr_copy(&new->str, lookup_val);
+	uint32_t offset = (uint32_t)lookup->strings.num;
 
-	node->first_subnode = new;
+	da_push_back_array(lookup->strings, str, len);
+	da_push_back(lookup->strings, "");
+	return offset;
 }
 
-static void lookup_splitnode(const char *lookup_val, size_t len,
-		struct text_leaf *leaf, struct text_node *node)
+/* copies the value while converting escape sequences */
+static uint32_t lookup_add_value(struct text_lookup *lookup, const char *str,
+		size_t len)
 {
-	struct text_node *split = bzalloc(sizeof(struct text_node));
+	uint32_t offset = (uint32_t)lookup->strings.num;
 
-	dstr_copy(&split->str, node->str.array+len);
-	split->leaf = node->leaf;
-	split->first_subnode = node->first_subnode;
-	node->first_subnode = split;
+	for (size_t i = 0; i < len; i++) {
+		char ch = str[i];
 
-	dstr_resize(&node->str, len);
+		if (ch == '\\' && i + 1 < len) {
+			char next = str[i + 1];
+
+			if (next == 'n' || next == 't' || next == 'r') {
+				ch = next == 'n' ? '\n' :
+				     next == 't' ? '\t' : '\r';
+				i++;
+			}
+		}
 
-	if (lookup_val[len] != 0) {
-		node->leaf = NULL;
-		lookup_createsubnode(lookup_val+len, leaf, node);
-	} else {
-		node->leaf = leaf;
+		da_push_back(lookup->strings, &ch);
 	}
-}
 
-static inline void lookup_replaceleaf(struct text_node *node,
-		struct text_leaf *leaf)
-{
-	text_leaf_destroy(node->leaf);
-	node->leaf = leaf;
+	da_push_back(lookup->strings, "");
+	return offset;
 }
 
-static void lookup_addstring(const char *lookup_val, struct text_leaf *leaf,
-		struct text_node *node)
+static void lookup_addstring(struct text_lookup *lookup,
+		const struct strref *name, const struct strref *value)
 {
-	struct text_node *child;
+	uint32_t hash = hash_name(name->array, name->len);
+	size_t   idx  = lookup_find(lookup, name->array, name->len, hash);
+	struct text_entry *entry;
 
 	/* value already exists, so replace */
-	if (!lookup_val || !*lookup_val) {
-		lookup_replaceleaf(node, leaf);
+	if (idx != DARRAY_INVALID) {
+		entry = lookup->entries.array + idx;
+		entry->value = lookup_add_value(lookup, value->array,
+				value->len);
 		return;
 	}
 
-	child = text_node_bychar(node, *lookup_val);
-	if (child) {
-		size_t len;
-
-		for (len = 0; len < child->str.len; len++) {
-			char val1 = child->str.array[len],
-			        val2 = lookup_val[len];
+	entry = da_push_back_new(lookup->entries);
+	entry->hash  = hash;
+	entry->name  = lookup_add_name(lookup, name->array, name->len);
+	entry->value = lookup_add_value(lookup, value->array, value->len);
 
-			if (val1 >= 'A' && val1 <= 'Z')
-				val1 += 0x20;
-			if (val2 >= 'A' && val2 <= 'Z')
-				val2 += 0x20;
-
-			if (val1 != val2)
-				break;
-		}
-
-		if (len == child->str.len) {
-			lookup_addstring(lookup_val+len, leaf, child);
-			return;
-		} else {
-			lookup_splitnode(lookup_val, len, leaf, child);
-		}
-	} else {
-		lookup_createsubnode(lookup_val, leaf, node);
-	}
+	if (lookup->entries.num * 2 > lookup->table_size)
+		lookup_grow_table(lookup);
+	else
+		lookup_insert_index(lookup, lookup->entries.num - 1);
 }
 
 static void lookup_getstringtoken(struct lexer *lex, struct strref *token)
@@ -277,20 +288,6 @@ static inline bool lookup_goto_nextline(struct lexer *p)
 	return success;
 }
 
-static char *convert_string(const char *str, size_t len)
-{
-	struct dstr out;
-	out.array    = bstrdup_n(str, len);
-	out.capacity = len+1;
-	out.len      = len;
-
-	dstr_replace(&out, "\\n", "\n");
-	dstr_replace(&out, "\\t", "\t");
-	dstr_replace(&out, "\\r", "\r");
-
-	return out.array;
-}
-
 static void lookup_addfiledata(struct text_lookup *lookup,
 		const char *file_data)
 {
@@ -303,7 +300,6 @@ static void lookup_addfiledata(struct text_lookup *lookup,
 	strref_clear(&value);
 
 	while (lookup_gettoken(&lex, &name)) {
-		struct text_leaf *leaf;
 		bool got_eq = false;
 
 		if (*name.array == '\n')
@@ -318,11 +314,7 @@ getval:
 			goto getval;
 		}
 
-		leaf = bmalloc(sizeof(struct text_leaf));
-		leaf->lookup = bstrdup_n(name.array,  name.len);
-		leaf->value  = convert_string(value.array, value.len);
-
-		lookup_addstring(leaf->lookup, leaf, lookup->top);
+		lookup_addstring(lookup, &name, &value);
 
 		if (!lookup_goto_nextline(&lex))
 			break;
@@ -331,31 +323,6 @@ getval:
 	lexer_free(&lex);
 }
 
-static inline bool lookup_getstring(const char *lookup_val,
-		const char **out, struct text_node *node)
-{
-	struct text_node *child;
-	char ch;
-
-	if (!node)
-		return false;
-
-	child = text_node_byname(node, lookup_val);
-	if (!child)
-		return false;
-
-	lookup_val += child->str.len;
-	ch = *lookup_val;
-	if (ch)
-		return lookup_getstring(lookup_val, out, child);
-
-	if (!child->leaf)
-		return false;
-
-	*out = child->leaf->value;
-	return true;
-}
-
 /* ------------------------------------------------------------------------- */
 
 lookup_t *text_lookup_create(const char *path)
@@ -387,9 +354,6 @@ bool text_lookup_add(lookup_t *lookup, const char *path)
 	if (!file_str.array)
 		return false;
 
-	if (!lookup->top)
-		lookup->top = bzalloc(sizeof(struct text_node));
-
 	dstr_replace(&file_str, "\r", " ");
 	lookup_addfiledata(lookup, file_str.array);
 	dstr_free(&file_str);
@@ -401,7 +365,9 @@ void text_lookup_destroy(lookup_t *lookup)
 {
 	if (lookup) {
 		dstr_free(&lookup->language);
-		text_node_destroy(lookup->top);
+		da_free(lookup->strings);
+		da_free(lookup->entries);
+		bfree(lookup->table);
 
 		bfree(lookup);
 	}
@@ -410,7 +376,17 @@ void text_lookup_destroy(lookup_t *lookup)
 bool text_lookup_getstr(lookup_t *lookup, const char *lookup_val,
 		const char **out)
 {
-	if (lookup)
-		return lookup_getstring(lookup_val, out, lookup->top);
-	return false;
+	uint32_t hash;
+	size_t   idx;
+
+	if (!lookup || !lookup_val)
+		return false;
+
+	hash = hash_name(lookup_val, SIZE_MAX);
+	idx  = lookup_find(lookup, lookup_val, SIZE_MAX, hash);
+	if (idx == DARRAY_INVALID)
+		return false;
+
+	*out = lookup_str(lookup, lookup->entries.array[idx].value);
+	return true;
 }
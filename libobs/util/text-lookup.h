@@ -19,9 +19,10 @@
 /*
  * Text Lookup interface
  *
- *   Used for storing and looking up localized strings.  Stores locazation
- * strings in a radix/trie tree to efficiently look up associated strings via a
- * unique string identifier name.
+ *   Used for storing and looking up localized strings.  Stores localization
+ * strings in a single string buffer indexed by a hash table, so looking up a
+ * string via its unique (case insensitive) identifier name never allocates.
+ * Returned strings remain valid until the lookup is modified or destroyed.
  */
 
 #include "c99defs.h"
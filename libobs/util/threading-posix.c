@@ -252,6 +252,11 @@ long os_atomic_dec_long(volatile long *val)
 	return __sync_sub_and_fetch(val, 1);
 }
 
+int64_t os_atomic_add_int64(volatile int64_t *val, int64_t n)
+{
+	return __sync_add_and_fetch(val, n);
+}
+
 void os_set_thread_name(const char *name)
 {
 #if defined(__APPLE__)
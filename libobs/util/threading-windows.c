@@ -176,6 +176,11 @@ long os_atomic_dec_long(volatile long *val)
 	return InterlockedDecrement(val);
 }
 
+int64_t os_atomic_add_int64(volatile int64_t *val, int64_t n)
+{
+	return InterlockedExchangeAdd64(val, n) + n;
+}
+
 #define VC_EXCEPTION 0x406D1388
 
 #pragma pack(push,8)
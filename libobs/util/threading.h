@@ -72,6 +72,7 @@ EXPORT int  os_sem_wait(os_sem_t *sem);
 
 EXPORT long os_atomic_inc_long(volatile long *val);
 EXPORT long os_atomic_dec_long(volatile long *val);
+EXPORT int64_t os_atomic_add_int64(volatile int64_t *val, int64_t n);
 
 EXPORT void os_set_thread_name(const char *name);
 
@@ -668,6 +668,13 @@ int main(int argc, char *argv[])
 	int ret = run_program(logFile, argc, argv);
 
 	blog(LOG_INFO, "Number of memory leaks: %ld", bnum_allocs());
+	for (int i = 0; i < BMEM_TAG_COUNT; i++) {
+		enum bmem_tag tag = (enum bmem_tag)i;
+		if (bmem_get_tag_bytes(tag))
+			blog(LOG_INFO, "    %s: %lld bytes",
+					bmem_get_tag_name(tag),
+					(long long)bmem_get_tag_bytes(tag));
+	}
 	base_set_log_handler(nullptr, nullptr);
 	return ret;
 }
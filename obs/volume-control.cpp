@@ -21,19 +21,6 @@ void VolControl::OBSVolumeChanged(void *data, calldata_t *calldata)
 	QMetaObject::invokeMethod(volControl, "VolumeChanged");
 }
 
-void VolControl::OBSVolumeLevel(void *data, calldata_t *calldata)
-{
-	VolControl *volControl = static_cast<VolControl*>(data);
-	float peak      = calldata_float(calldata, "level");
-	float mag       = calldata_float(calldata, "magnitude");
-	float peakHold  = calldata_float(calldata, "peak");
-
-	QMetaObject::invokeMethod(volControl, "VolumeLevel",
-		Q_ARG(float, mag),
-		Q_ARG(float, peak),
-		Q_ARG(float, peakHold));
-}
-
 void VolControl::OBSVolumeMuted(void *data, calldata_t *calldata)
 {
 	VolControl *volControl = static_cast<VolControl*>(data);
@@ -52,8 +39,23 @@ void VolControl::VolumeChanged()
 	updateText();
 }
 
-void VolControl::VolumeLevel(float mag, float peak, float peakHold)
+void VolControl::UpdateLevels()
 {
+	obs_volmeter_levels levels;
+
+	if (!obs_volmeter_get_levels(obs_volmeter, &levels))
+		return;
+
+	/* only feed the meter new levels so that it still resets itself
+	 * when the source stops sending audio */
+	if (levels.updates == lastLevelUpdate)
+		return;
+	lastLevelUpdate = levels.updates;
+
+	float mag      = levels.magnitude;
+	float peak     = levels.level;
+	float peakHold = levels.peak;
+
 	if (obs_source_muted(source) || !obs_source_enabled(source)) {
 		mag = 0.0f;
 		peak = 0.0f;
@@ -101,7 +103,8 @@ VolControl::VolControl(OBSSource source_)
 	  levelTotal    (0.0f),
 	  levelCount    (0.0f),
 	  obs_fader     (obs_fader_create(OBS_FADER_CUBIC)),
-	  obs_volmeter  (obs_volmeter_create(OBS_FADER_LOG))
+	  obs_volmeter  (obs_volmeter_create(OBS_FADER_LOG)),
+	  lastLevelUpdate (0)
 {
 	QHBoxLayout *volLayout  = new QHBoxLayout();
 	QVBoxLayout *mainLayout = new QVBoxLayout();
@@ -147,9 +150,6 @@ VolControl::VolControl(OBSSource source_)
 	signal_handler_connect(obs_fader_get_signal_handler(obs_fader),
 			"volume_changed", OBSVolumeChanged, this);
 
-	signal_handler_connect(obs_volmeter_get_signal_handler(obs_volmeter),
-			"levels_updated", OBSVolumeLevel, this);
-
 	signal_handler_connect(obs_source_get_signal_handler(source),
 			"mute", OBSVolumeMuted, this);
 
@@ -161,6 +161,13 @@ VolControl::VolControl(OBSSource source_)
 	obs_fader_attach_source(obs_fader, source);
 	obs_volmeter_attach_source(obs_volmeter, source);
 
+	/* levels are polled rather than signalled, so a busy audio thread
+	 * can't queue up more meter updates than the UI is able to paint */
+	levelTimer = new QTimer(this);
+	QWidget::connect(levelTimer, SIGNAL(timeout()),
+			this, SLOT(UpdateLevels()));
+	levelTimer->start(obs_volmeter_get_update_interval(obs_volmeter));
+
 	/* Call volume changed once to init the slider position and label */
 	VolumeChanged();
 }
@@ -170,9 +177,6 @@ VolControl::~VolControl()
 	signal_handler_disconnect(obs_fader_get_signal_handler(obs_fader),
 			"volume_changed", OBSVolumeChanged, this);
 
-	signal_handler_disconnect(obs_volmeter_get_signal_handler(obs_volmeter),
-			"levels_updated", OBSVolumeLevel, this);
-
 	signal_handler_disconnect(obs_source_get_signal_handler(source),
 			"mute", OBSVolumeMuted, this);
 
@@ -52,15 +52,16 @@ private:
 	float           levelCount;
 	obs_fader_t     *obs_fader;
 	obs_volmeter_t  *obs_volmeter;
+	QTimer          *levelTimer;
+	uint64_t        lastLevelUpdate;
 
 	static void OBSVolumeChanged(void *param, calldata_t *calldata);
-	static void OBSVolumeLevel(void *data, calldata_t *calldata);
 	static void OBSVolumeMuted(void *data, calldata_t *calldata);
 
 private slots:
 	void VolumeChanged();
 	void VolumeMuted(bool muted);
-	void VolumeLevel(float mag, float peak, float peakHold);
+	void UpdateLevels();
 
 	void SetMuted(bool checked);
 	void SliderChanged(int vol);
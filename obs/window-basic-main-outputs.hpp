@@ -1,11 +1,13 @@
 #pragma once
 
+#include <atomic>
+
 class OBSBasic;
 
 struct BasicOutputHandler {
 	OBSOutput              fileOutput;
 	OBSOutput              streamOutput;
-	int                    activeRefs = 0;
+	std::atomic<int>       activeRefs{0};
 	OBSBasic               *main;
 
 	inline BasicOutputHandler(OBSBasic *main_) : main(main_) {}
@@ -232,21 +232,89 @@ void OBSBasic::ClearVolumeControls()
 	volumes.clear();
 }
 
-void OBSBasic::Save(const char *file)
+static void WriteSaveData(obs_data_t *saveData, const char *file)
 {
-	obs_data_t *saveData  = GenerateSaveData();
 	const char *jsonData = obs_data_get_json(saveData);
 
 	if (!!jsonData) {
+		/* write to a temporary file first so that a crash or full disk
+		 * can never leave a truncated scene collection behind */
+		string tempFile = string(file) + ".tmp";
+
 		/* TODO: maybe a message box here? */
-		bool success = os_quick_write_utf8_file(file, jsonData,
-				strlen(jsonData), false);
+		bool success = os_quick_write_utf8_file(tempFile.c_str(),
+				jsonData, strlen(jsonData), false);
+		if (success)
+			success = os_rename(tempFile.c_str(), file) == 0;
 		if (!success)
 			blog(LOG_ERROR, "Could not save scene data to %s",
 					file);
 	}
+}
+
+void OBSBasic::Save(const char *file)
+{
+	long generation = obs_get_save_generation();
+	if (generation == lastSaveGeneration)
+		return;
 
+	/* the save data shares its settings objects with the live sources,
+	 * so hand a deep copy of it to the save thread */
+	obs_data_t *saveData = GenerateSaveData();
+	obs_data_t *snapshot = obs_data_create();
+	obs_data_apply(snapshot, saveData);
 	obs_data_release(saveData);
+
+	if (saveThread.joinable()) {
+		std::lock_guard<std::mutex> lock(saveMutex);
+		pendingSaveData = snapshot;
+		pendingSavePath = file;
+		saveCondition.notify_one();
+	} else {
+		WriteSaveData(snapshot, file);
+	}
+
+	obs_data_release(snapshot);
+	lastSaveGeneration = generation;
+}
+
+void OBSBasic::SaveThread()
+{
+	std::unique_lock<std::mutex> lock(saveMutex);
+
+	for (;;) {
+		saveCondition.wait(lock, [this] ()
+		{
+			return saveThreadExit || !!pendingSaveData;
+		});
+
+		if (!pendingSaveData)
+			break;
+
+		/* only the newest snapshot matters, older ones that were never
+		 * written are simply replaced */
+		OBSData saveData = pendingSaveData;
+		string  file     = pendingSavePath;
+		pendingSaveData  = nullptr;
+
+		lock.unlock();
+		WriteSaveData(saveData, file.c_str());
+		lock.lock();
+	}
+}
+
+void OBSBasic::StopSaveThread()
+{
+	if (!saveThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(saveMutex);
+		saveThreadExit = true;
+		saveCondition.notify_one();
+	}
+
+	saveThread.join();
 }
 
 static void LoadAudioDevice(const char *name, int channel, obs_data_t *parent)
@@ -319,6 +387,9 @@ void OBSBasic::Load(const char *file)
 
 	obs_data_array_release(sources);
 	obs_data_release(data);
+
+	/* nothing to save until something actually changes */
+	lastSaveGeneration = obs_get_save_generation();
 }
 
 static inline bool HasAudioDevices(const char *source_id)
@@ -655,6 +726,8 @@ void OBSBasic::OBSInit()
 	TimedCheckForUpdates();
 	loaded = true;
 
+	saveThread = std::thread([this] () {SaveThread();});
+
 	saveTimer = new QTimer(this);
 	connect(saveTimer, SIGNAL(timeout()), this, SLOT(SaveProject()));
 	saveTimer->start(20000);
@@ -671,6 +744,8 @@ OBSBasic::~OBSBasic()
 	delete cpuUsageTimer;
 	os_cpu_usage_info_destroy(cpuUsageInfo);
 
+	StopSaveThread();
+
 	outputHandler.reset();
 
 	if (interaction)
@@ -1392,7 +1467,7 @@ void OBSBasic::RenderMain(void *data, uint32_t cx, uint32_t cy)
 
 	window->DrawBackdrop(float(ovi.base_width), float(ovi.base_height));
 
-	obs_render_main_view();
+	obs_render_main_texture();
 	gs_load_vertexbuffer(nullptr);
 
 	/* --------------------------------------- */
@@ -1541,6 +1616,9 @@ int OBSBasic::ResetVideo()
 	ovi.window_width  = size.width();
 	ovi.window_height = size.height();
 
+	obs_set_video_staging_depth((uint32_t)config_get_uint(basicConfig,
+				"Video", "StagingDepth"));
+
 	ret = AttemptToResetVideo(&ovi);
 	if (IS_WIN32 && ret != OBS_VIDEO_SUCCESS) {
 		/* Try OpenGL if DirectX fails on windows */
@@ -1685,6 +1763,7 @@ void OBSBasic::closeEvent(QCloseEvent *event)
 	 * the program data is being freed */
 	delete saveTimer;
 	SaveProject();
+	StopSaveThread();
 
 	/* Clear the list boxes in ::closeEvent to ensure that we can process
 	 * any ->deleteLater events in this window created by Qt in relation to
@@ -24,6 +24,10 @@
 #include <unordered_map>
 #include <vector>
 #include <memory>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 #include "window-main.hpp"
 #include "window-basic-interaction.hpp"
 #include "window-basic-properties.hpp"
@@ -64,6 +68,16 @@ private:
 
 	QPointer<QTimer> saveTimer;
 
+	/* scene collection snapshots are serialized and written on a separate
+	 * thread so that saving never stalls the UI */
+	std::thread             saveThread;
+	std::mutex              saveMutex;
+	std::condition_variable saveCondition;
+	OBSData                 pendingSaveData;
+	std::string             pendingSavePath;
+	bool                    saveThreadExit = false;
+	long                    lastSaveGeneration = -1;
+
 	QPointer<OBSBasicInteraction> interaction;
 	QPointer<OBSBasicProperties> properties;
 	QPointer<OBSBasicTransform> transformWindow;
@@ -101,6 +115,8 @@ private:
 	void          UploadLog(const char *file);
 
 	void          Save(const char *file);
+	void          SaveThread();
+	void          StopSaveThread();
 	void          Load(const char *file);
 
 	bool          InitService();
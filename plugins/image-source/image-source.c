@@ -52,6 +52,8 @@ static void image_source_load(struct image_source *context)
 	}
 
 	obs_leave_graphics();
+
+	obs_source_invalidate_cache(context->source);
 }
 
 static void image_source_unload(struct image_source *context)
@@ -63,6 +65,8 @@ static void image_source_unload(struct image_source *context)
 	context->tex = NULL;
 
 	obs_leave_graphics();
+
+	obs_source_invalidate_cache(context->source);
 }
 
 static void image_source_update(void *data, obs_data_t *settings)
@@ -175,7 +179,8 @@ static obs_properties_t *image_source_properties(void *unused)
 static struct obs_source_info image_source_info = {
 	.id             = "image_source",
 	.type           = OBS_SOURCE_TYPE_INPUT,
-	.output_flags   = OBS_SOURCE_VIDEO,
+	.output_flags   = OBS_SOURCE_VIDEO |
+	                  OBS_SOURCE_STATIC,
 	.get_name       = image_source_get_name,
 	.create         = image_source_create,
 	.destroy        = image_source_destroy,
@@ -18,12 +18,16 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <stdio.h>
 #include <stdlib.h>
 #include <inttypes.h>
+#include <pthread.h>
 #include <xcb/shm.h>
 #include <xcb/xfixes.h>
 #include <xcb/xinerama.h>
+#include <xcb/damage.h>
 
 #include <obs-module.h>
 #include <util/dstr.h>
+#include <util/threading.h>
+#include <util/platform.h>
 #include "xcursor-xcb.h"
 #include "xhelpers.h"
 
@@ -31,6 +35,18 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #define blog(level, msg, ...) blog(level, "xshm-input: " msg, ##__VA_ARGS__)
 
+#define MAX_DIRTY_RECTS 16
+
+/**
+ * List of changed regions, collapsed into their bounding box when there are
+ * too many of them
+ */
+struct xshm_dirty {
+	xcb_rectangle_t  rects[MAX_DIRTY_RECTS];
+	size_t           num;
+	bool             full;
+};
+
 struct xshm_data {
 	obs_source_t     *source;
 
@@ -47,12 +63,68 @@ struct xshm_data {
 	int_fast32_t     height;
 
 	gs_texture_t     *texture;
+	bool             texture_valid;
 
 	bool             show_cursor;
 	bool             use_xinerama;
 	bool             advanced;
+
+	/* damage tracking */
+	bool             use_damage;
+	uint8_t          damage_event;
+	xcb_damage_damage_t damage;
+	xcb_xfixes_region_t region;
+
+	/* capture thread, shared data is protected by the mutex */
+	pthread_t        thread;
+	os_event_t       *stop_event;
+	bool             thread_active;
+	pthread_mutex_t  mutex;
+	uint8_t          *frame;
+	struct xshm_dirty dirty;
+	xcb_xfixes_get_cursor_image_reply_t *cursor_reply;
 };
 
+/**
+ * Add a rectangle to the dirty list
+ */
+static void xshm_dirty_add(struct xshm_dirty *dirty,
+		const xcb_rectangle_t *rect)
+{
+	if (dirty->full)
+		return;
+
+	if (dirty->num < MAX_DIRTY_RECTS) {
+		dirty->rects[dirty->num++] = *rect;
+		return;
+	}
+
+	int_fast32_t x1 = rect->x;
+	int_fast32_t y1 = rect->y;
+	int_fast32_t x2 = rect->x + rect->width;
+	int_fast32_t y2 = rect->y + rect->height;
+
+	for (size_t i = 0; i < dirty->num; i++) {
+		const xcb_rectangle_t *r = &dirty->rects[i];
+		if (r->x < x1)               x1 = r->x;
+		if (r->y < y1)               y1 = r->y;
+		if (r->x + r->width  > x2)   x2 = r->x + r->width;
+		if (r->y + r->height > y2)   y2 = r->y + r->height;
+	}
+
+	dirty->rects[0].x      = x1;
+	dirty->rects[0].y      = y1;
+	dirty->rects[0].width  = x2 - x1;
+	dirty->rects[0].height = y2 - y1;
+	dirty->num = 1;
+}
+
+static inline void xshm_dirty_clear(struct xshm_dirty *dirty)
+{
+	dirty->num  = 0;
+	dirty->full = false;
+}
+
 /**
  * Resize the texture
  *
@@ -66,6 +138,7 @@ static inline void xshm_resize_texture(struct xshm_data *data)
 		gs_texture_destroy(data->texture);
 	data->texture = gs_texture_create(data->width, data->height,
 		GS_BGRA, 1, NULL, GS_DYNAMIC);
+	data->texture_valid = false;
 }
 
 /**
@@ -83,6 +156,10 @@ static bool xshm_check_extensions(xcb_connection_t *xcb)
 	if (!xcb_get_extension_data(xcb, &xcb_xinerama_id)->present)
 		blog(LOG_INFO, "Missing Xinerama extension !");
 
+	if (!xcb_get_extension_data(xcb, &xcb_damage_id)->present)
+		blog(LOG_INFO, "Missing Damage extension, "
+				"capturing full frames !");
+
 	return ok;
 }
 
@@ -137,16 +214,219 @@ static const char* xshm_getname(void)
 	return obs_module_text("X11SharedMemoryScreenInput");
 }
 
+/**
+ * Copy a region of the screen into the frame buffer
+ *
+ * @note the region has to be within the capture area
+ */
+static bool xshm_grab_rect(struct xshm_data *data,
+		const xcb_rectangle_t *rect)
+{
+	xcb_shm_get_image_cookie_t img_c;
+	xcb_shm_get_image_reply_t  *img_r;
+
+	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
+			data->x_org + rect->x, data->y_org + rect->y,
+			rect->width, rect->height,
+			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
+	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
+
+	if (!img_r)
+		return false;
+
+	const size_t src_linesize = rect->width * 4;
+	const size_t dst_linesize = data->width * 4;
+	uint8_t *dst = data->frame + rect->y * dst_linesize + rect->x * 4;
+
+	pthread_mutex_lock(&data->mutex);
+
+	for (uint_fast32_t y = 0; y < rect->height; ++y)
+		memcpy(dst + y * dst_linesize,
+		       data->xshm->data + y * src_linesize, src_linesize);
+	xshm_dirty_add(&data->dirty, rect);
+
+	pthread_mutex_unlock(&data->mutex);
+
+	free(img_r);
+	return true;
+}
+
+/**
+ * Get the damaged regions of the capture area since the last call
+ *
+ * @return false if nothing changed
+ */
+static bool xshm_get_damage(struct xshm_data *data, struct xshm_dirty *out)
+{
+	xcb_generic_event_t *ev;
+	bool damaged = false;
+
+	while ((ev = xcb_poll_for_event(data->xcb)) != NULL) {
+		if ((ev->response_type & ~0x80) ==
+				data->damage_event + XCB_DAMAGE_NOTIFY)
+			damaged = true;
+		free(ev);
+	}
+
+	if (!damaged)
+		return false;
+
+	xcb_xfixes_fetch_region_cookie_t reg_c;
+	xcb_xfixes_fetch_region_reply_t  *reg_r;
+
+	xcb_damage_subtract(data->xcb, data->damage, XCB_NONE, data->region);
+	reg_c = xcb_xfixes_fetch_region_unchecked(data->xcb, data->region);
+	reg_r = xcb_xfixes_fetch_region_reply(data->xcb, reg_c, NULL);
+
+	if (!reg_r) {
+		out->full = true;
+		return true;
+	}
+
+	xcb_rectangle_t *rects = xcb_xfixes_fetch_region_rectangles(reg_r);
+	int count = xcb_xfixes_fetch_region_rectangles_length(reg_r);
+
+	for (int i = 0; i < count; ++i) {
+		int_fast32_t x1 = rects[i].x - data->x_org;
+		int_fast32_t y1 = rects[i].y - data->y_org;
+		int_fast32_t x2 = x1 + rects[i].width;
+		int_fast32_t y2 = y1 + rects[i].height;
+
+		if (x1 < 0)            x1 = 0;
+		if (y1 < 0)            y1 = 0;
+		if (x2 > data->width)  x2 = data->width;
+		if (y2 > data->height) y2 = data->height;
+		if (x2 <= x1 || y2 <= y1)
+			continue;
+
+		xcb_rectangle_t rect = {x1, y1, x2 - x1, y2 - y1};
+		xshm_dirty_add(out, &rect);
+	}
+
+	free(reg_r);
+	return out->full || out->num;
+}
+
+/**
+ * Capture a single frame, only grabbing the damaged regions if possible
+ */
+static void xshm_capture_frame(struct xshm_data *data, bool full)
+{
+	xcb_xfixes_get_cursor_image_cookie_t cur_c = {0};
+	xcb_xfixes_get_cursor_image_reply_t  *cur_r = NULL;
+	struct xshm_dirty damage;
+
+	xshm_dirty_clear(&damage);
+	damage.full = full || !data->use_damage;
+
+	if (data->show_cursor)
+		cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+
+	if (damage.full || xshm_get_damage(data, &damage)) {
+		if (damage.full) {
+			xcb_rectangle_t rect = {0, 0, data->width,
+				data->height};
+			xshm_grab_rect(data, &rect);
+		} else {
+			for (size_t i = 0; i < damage.num; i++)
+				xshm_grab_rect(data, &damage.rects[i]);
+		}
+	}
+
+	if (data->show_cursor)
+		cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c,
+				NULL);
+
+	if (cur_r) {
+		pthread_mutex_lock(&data->mutex);
+		free(data->cursor_reply);
+		data->cursor_reply = cur_r;
+		pthread_mutex_unlock(&data->mutex);
+	}
+}
+
+/**
+ * Capture thread, grabs changes from the x server once per frame interval
+ */
+static void *xshm_thread(void *vptr)
+{
+	XSHM_DATA(vptr);
+	uint64_t interval = video_output_get_frame_time(obs_get_video());
+	uint64_t cur_time = os_gettime_ns();
+	bool full = true;
+
+	os_set_thread_name("xshm-input: capture thread");
+
+	while (os_event_try(data->stop_event) == EAGAIN) {
+		if (obs_source_showing(data->source)) {
+			xshm_capture_frame(data, full);
+			full = false;
+		}
+
+		cur_time += interval;
+		if (!os_sleepto_ns(cur_time))
+			cur_time = os_gettime_ns();
+	}
+
+	return NULL;
+}
+
+/**
+ * Enable damage tracking for the root window if the server supports it
+ */
+static void xshm_init_damage(struct xshm_data *data)
+{
+	const xcb_query_extension_reply_t *ext;
+	xcb_damage_query_version_cookie_t ver_c;
+
+	ext = xcb_get_extension_data(data->xcb, &xcb_damage_id);
+	if (!ext->present)
+		return;
+
+	ver_c = xcb_damage_query_version_unchecked(data->xcb,
+			XCB_DAMAGE_MAJOR_VERSION, XCB_DAMAGE_MINOR_VERSION);
+	free(xcb_damage_query_version_reply(data->xcb, ver_c, NULL));
+
+	data->damage_event = ext->first_event;
+	data->damage = xcb_generate_id(data->xcb);
+	data->region = xcb_generate_id(data->xcb);
+
+	xcb_damage_create(data->xcb, data->damage, data->xcb_screen->root,
+			XCB_DAMAGE_REPORT_LEVEL_NON_EMPTY);
+	xcb_xfixes_create_region(data->xcb, data->region, 0, NULL);
+	xcb_flush(data->xcb);
+
+	data->use_damage = true;
+}
+
 /**
  * Stop the capture
  */
 static void xshm_capture_stop(struct xshm_data *data)
 {
+	if (data->thread_active) {
+		os_event_signal(data->stop_event);
+		pthread_join(data->thread, NULL);
+		data->thread_active = false;
+	}
+
+	if (data->stop_event) {
+		os_event_destroy(data->stop_event);
+		data->stop_event = NULL;
+	}
+
+	if (data->use_damage) {
+		xcb_damage_destroy(data->xcb, data->damage);
+		xcb_xfixes_destroy_region(data->xcb, data->region);
+		data->use_damage = false;
+	}
+
 	obs_enter_graphics();
 
 	if (data->texture) {
 		gs_texture_destroy(data->texture);
 		data->texture = NULL;
+		data->texture_valid = false;
 	}
 	if (data->cursor) {
 		xcb_xcursor_destroy(data->cursor);
@@ -169,6 +449,13 @@ static void xshm_capture_stop(struct xshm_data *data)
 		bfree(data->server);
 		data->server = NULL;
 	}
+
+	bfree(data->frame);
+	data->frame = NULL;
+
+	free(data->cursor_reply);
+	data->cursor_reply = NULL;
+	xshm_dirty_clear(&data->dirty);
 }
 
 /**
@@ -204,12 +491,23 @@ static void xshm_capture_start(struct xshm_data *data)
 	data->cursor = xcb_xcursor_init(data->xcb);
 	xcb_xcursor_offset(data->cursor, data->x_org, data->y_org);
 
+	xshm_init_damage(data);
+	data->frame = bzalloc(data->width * data->height * 4);
+
 	obs_enter_graphics();
 
 	xshm_resize_texture(data);
 
 	obs_leave_graphics();
 
+	if (os_event_init(&data->stop_event, OS_EVENT_TYPE_MANUAL) != 0)
+		goto fail;
+	if (pthread_create(&data->thread, NULL, xshm_thread, data) != 0) {
+		blog(LOG_ERROR, "failed to create capture thread !");
+		goto fail;
+	}
+	data->thread_active = true;
+
 	return;
 fail:
 	xshm_capture_stop(data);
@@ -365,6 +663,7 @@ static void xshm_destroy(void *vptr)
 		return;
 
 	xshm_capture_stop(data);
+	pthread_mutex_destroy(&data->mutex);
 
 	bfree(data);
 }
@@ -376,6 +675,7 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 {
 	struct xshm_data *data = bzalloc(sizeof(struct xshm_data));
 	data->source = source;
+	pthread_mutex_init(&data->mutex, NULL);
 
 	xshm_update(data, settings);
 
@@ -383,7 +683,7 @@ static void *xshm_create(obs_data_t *settings, obs_source_t *source)
 }
 
 /**
- * Prepare the capture data
+ * Upload the regions changed by the capture thread
  */
 static void xshm_video_tick(void *vptr, float seconds)
 {
@@ -395,32 +695,41 @@ static void xshm_video_tick(void *vptr, float seconds)
 	if (!obs_source_showing(data->source))
 		return;
 
-	xcb_shm_get_image_cookie_t           img_c;
-	xcb_shm_get_image_reply_t            *img_r;
-	xcb_xfixes_get_cursor_image_cookie_t cur_c;
-	xcb_xfixes_get_cursor_image_reply_t  *cur_r;
+	pthread_mutex_lock(&data->mutex);
 
-	img_c = xcb_shm_get_image_unchecked(data->xcb, data->xcb_screen->root,
-			data->x_org, data->y_org, data->width, data->height,
-			~0, XCB_IMAGE_FORMAT_Z_PIXMAP, data->xshm->seg, 0);
-	cur_c = xcb_xfixes_get_cursor_image_unchecked(data->xcb);
+	xcb_xfixes_get_cursor_image_reply_t *cur_r = data->cursor_reply;
+	data->cursor_reply = NULL;
 
-	img_r = xcb_shm_get_image_reply(data->xcb, img_c, NULL);
-	cur_r = xcb_xfixes_get_cursor_image_reply(data->xcb, cur_c, NULL);
-
-	if (!img_r)
+	if (!cur_r && !data->dirty.full && !data->dirty.num)
 		goto exit;
 
+	const uint32_t linesize = data->width * 4;
+	bool full = data->dirty.full;
+
 	obs_enter_graphics();
 
-	gs_texture_set_image(data->texture, (void *) data->xshm->data,
-		data->width * 4, false);
+	for (size_t i = 0; !full && i < data->dirty.num; i++) {
+		const xcb_rectangle_t *r = &data->dirty.rects[i];
+		const uint8_t *ptr = data->frame + r->y * linesize + r->x * 4;
+
+		if (!gs_texture_update_region(data->texture, r->x, r->y,
+					r->width, r->height, ptr, linesize))
+			full = true;
+	}
+
+	if (full) {
+		gs_texture_set_image(data->texture, data->frame, linesize,
+				false);
+		data->texture_valid = true;
+	}
 	xcb_xcursor_update(data->cursor, cur_r);
 
 	obs_leave_graphics();
 
+	xshm_dirty_clear(&data->dirty);
+
 exit:
-	free(img_r);
+	pthread_mutex_unlock(&data->mutex);
 	free(cur_r);
 }
 
@@ -452,6 +761,16 @@ static void xshm_video_render(void *vptr, gs_effect_t *effect)
 	}
 }
 
+/**
+ * Only opaque once a whole frame has been captured, until then nothing (or
+ * undefined texture contents) would be drawn
+ */
+static bool xshm_is_opaque(void *vptr)
+{
+	XSHM_DATA(vptr);
+	return data->texture && data->texture_valid;
+}
+
 /**
  * Width of the captured data
  */
@@ -474,7 +793,8 @@ struct obs_source_info xshm_input = {
 	.id             = "xshm_input",
 	.type           = OBS_SOURCE_TYPE_INPUT,
 	.output_flags   = OBS_SOURCE_VIDEO |
-	                  OBS_SOURCE_CUSTOM_DRAW,
+	                  OBS_SOURCE_CUSTOM_DRAW |
+	                  OBS_SOURCE_OPAQUE,
 	.get_name       = xshm_getname,
 	.create         = xshm_create,
 	.destroy        = xshm_destroy,
@@ -484,5 +804,6 @@ struct obs_source_info xshm_input = {
 	.video_tick     = xshm_video_tick,
 	.video_render   = xshm_video_render,
 	.get_width      = xshm_getwidth,
-	.get_height     = xshm_getheight
+	.get_height     = xshm_getheight,
+	.is_opaque      = xshm_is_opaque
 };
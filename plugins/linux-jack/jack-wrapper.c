@@ -76,7 +76,7 @@ int jack_process_callback(jack_nframes_t nframes, void* arg)
 	out.timestamp = os_gettime_ns() -
 				jack_frames_to_time(data->jack_client, nframes);
 
-	obs_source_output_audio(data->source, &out);
+	obs_source_output_audio_async(data->source, &out);
 	pthread_mutex_unlock(&data->jack_mutex);
 	return 0;
 }
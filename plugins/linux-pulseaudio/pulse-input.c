@@ -102,6 +102,28 @@ static inline uint64_t get_sample_time(size_t frames, uint_fast32_t rate)
 	return os_gettime_ns() - samples_to_ns(frames, rate);
 }
 
+/**
+ * Get the capture time of the data at the current read index
+ *
+ * The stream latency reported by pulse covers everything between the
+ * recording of a sample and our read pointer, so this is independent of how
+ * late the read callback is scheduled.  Falls back to the callback time if no
+ * timing info is available yet.
+ */
+static uint64_t get_stream_time(struct pulse_data *data, size_t frames)
+{
+	pa_usec_t latency;
+	int negative;
+
+	if (pa_stream_get_latency(data->stream, &latency, &negative) < 0)
+		return get_sample_time(frames, data->samples_per_sec);
+
+	if (negative)
+		latency = 0;
+
+	return os_gettime_ns() - (uint64_t)latency * 1000ULL;
+}
+
 #define STARTUP_TIMEOUT_NS (500 * NSEC_PER_MSEC)
 
 /**
@@ -140,14 +162,13 @@ static void pulse_stream_read(pa_stream *p, size_t nbytes, void *userdata)
 	out.format          = pulse_to_obs_audio_format(data->format);
 	out.data[0]         = (uint8_t *) frames;
 	out.frames          = bytes / data->bytes_per_frame;
-	out.timestamp       = get_sample_time(out.frames,
-	                                      out.samples_per_sec);
+	out.timestamp       = get_stream_time(data, out.frames);
 
 	if (!data->first_ts)
 		data->first_ts = out.timestamp + STARTUP_TIMEOUT_NS;
 
 	if (out.timestamp > data->first_ts)
-		obs_source_output_audio(data->source, &out);
+		obs_source_output_audio_async(data->source, &out);
 
 	data->packets++;
 	data->frames += out.frames;
@@ -275,7 +296,9 @@ static int_fast32_t pulse_start_recording(struct pulse_data *data)
 	attr.prebuf    = (uint32_t) -1;
 	attr.tlength   = (uint32_t) -1;
 
-	pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY;
+	pa_stream_flags_t flags = PA_STREAM_ADJUST_LATENCY |
+		PA_STREAM_INTERPOLATE_TIMING |
+		PA_STREAM_AUTO_TIMING_UPDATE;
 
 	pulse_lock();
 	int_fast32_t ret = pa_stream_connect_record(data->stream, data->device,
@@ -88,7 +88,7 @@ struct ffmpeg_output {
 	os_sem_t           *write_sem;
 	os_event_t         *stop_event;
 
-	DARRAY(AVPacket)   packets;
+	struct circlebuf   packets;
 };
 
 /* ------------------------------------------------------------------------- */
@@ -550,7 +550,7 @@ static void receive_video(void *param, struct video_data *frame)
 		packet.size          = sizeof(AVPicture);
 
 		pthread_mutex_lock(&output->write_mutex);
-		da_push_back(output->packets, &packet);
+		circlebuf_push_back(&output->packets, &packet, sizeof(packet));
 		pthread_mutex_unlock(&output->write_mutex);
 		os_sem_post(output->write_sem);
 
@@ -574,7 +574,8 @@ static void receive_video(void *param, struct video_data *frame)
 					data->video->time_base);
 
 			pthread_mutex_lock(&output->write_mutex);
-			da_push_back(output->packets, &packet);
+			circlebuf_push_back(&output->packets, &packet,
+					sizeof(packet));
 			pthread_mutex_unlock(&output->write_mutex);
 			os_sem_post(output->write_sem);
 		} else {
@@ -633,7 +634,7 @@ static void encode_audio(struct ffmpeg_output *output,
 	packet.stream_index = data->audio->index;
 
 	pthread_mutex_lock(&output->write_mutex);
-	da_push_back(output->packets, &packet);
+	circlebuf_push_back(&output->packets, &packet, sizeof(packet));
 	pthread_mutex_unlock(&output->write_mutex);
 	os_sem_post(output->write_sem);
 }
@@ -700,9 +701,8 @@ static bool process_packet(struct ffmpeg_output *output)
 	int ret;
 
 	pthread_mutex_lock(&output->write_mutex);
-	if (output->packets.num) {
-		packet = output->packets.array[0];
-		da_erase(output->packets, 0);
+	if (output->packets.size) {
+		circlebuf_pop_front(&output->packets, &packet, sizeof(packet));
 		new_packet = true;
 	}
 	pthread_mutex_unlock(&output->write_mutex);
@@ -713,7 +713,8 @@ static bool process_packet(struct ffmpeg_output *output)
 	/*blog(LOG_DEBUG, "size = %d, flags = %lX, stream = %d, "
 			"packets queued: %lu",
 			packet.size, packet.flags,
-			packet.stream_index, output->packets.num);*/
+			packet.stream_index,
+			output->packets.size / sizeof(AVPacket));*/
 
 	ret = av_interleaved_write_frame(output->ff_data.output, &packet);
 	if (ret < 0) {
@@ -851,9 +852,13 @@ static void ffmpeg_output_stop(void *data)
 
 		pthread_mutex_lock(&output->write_mutex);
 
-		for (size_t i = 0; i < output->packets.num; i++)
-			av_free_packet(output->packets.array+i);
-		da_free(output->packets);
+		while (output->packets.size) {
+			AVPacket packet;
+			circlebuf_pop_front(&output->packets, &packet,
+					sizeof(packet));
+			av_free_packet(&packet);
+		}
+		circlebuf_free(&output->packets);
 
 		pthread_mutex_unlock(&output->write_mutex);
 
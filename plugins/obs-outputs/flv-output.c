@@ -21,6 +21,7 @@
 #include <util/platform.h>
 #include <util/dstr.h>
 #include <util/threading.h>
+#include <util/file-writer.h>
 #include <inttypes.h>
 #include "flv-mux.h"
 
@@ -32,12 +33,12 @@
 #define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
 
 struct flv_output {
-	obs_output_t *output;
-	struct dstr  path;
-	FILE         *file;
-	bool         active;
-	bool         sent_headers;
-	int64_t      last_packet_ts;
+	obs_output_t  *output;
+	struct dstr   path;
+	file_writer_t *file;
+	bool          active;
+	bool          sent_headers;
+	int64_t       last_packet_ts;
 };
 
 static const char *flv_output_getname(void)
@@ -72,12 +73,27 @@ static void flv_output_stop(void *data)
 	struct flv_output *stream = data;
 
 	if (stream->active) {
-		if (stream->file)
-			write_file_info(stream->file, stream->last_packet_ts,
-					os_ftelli64(stream->file));
-
-		fclose(stream->file);
+		/* ending data capture first lets the encoders drain their
+		 * delayed packets into the file before it's finalized */
 		obs_output_end_data_capture(stream->output);
+
+		if (stream->file) {
+			struct file_writer_stats stats;
+			int64_t size = file_writer_tell(stream->file);
+
+			file_writer_flush(stream->file);
+			write_file_info(file_writer_get_file(stream->file),
+					stream->last_packet_ts, size);
+
+			file_writer_get_stats(stream->file, &stats);
+			info("Max write backlog: %d KB, writes stalled: %d",
+					(int)(stats.max_backlog / 1024),
+					(int)stats.stalls);
+
+			file_writer_close(stream->file);
+			stream->file = NULL;
+		}
+
 		stream->active = false;
 		stream->sent_headers = false;
 
@@ -95,7 +111,7 @@ static int write_packet(struct flv_output *stream,
 	stream->last_packet_ts = get_ms_time(packet, packet->dts);
 
 	flv_packet_mux(packet, &data, &size, is_header);
-	fwrite(data, 1, size, stream->file);
+	file_writer_write(stream->file, data, size);
 	bfree(data);
 	obs_free_encoder_packet(packet);
 
@@ -108,7 +124,7 @@ static void write_meta_data(struct flv_output *stream)
 	size_t  meta_data_size;
 
 	flv_meta_data(stream->output, &meta_data, &meta_data_size, true, 0);
-	fwrite(meta_data, 1, meta_data_size, stream->file);
+	file_writer_write(stream->file, meta_data, meta_data_size);
 	bfree(meta_data);
 }
 
@@ -170,7 +186,7 @@ static bool flv_output_start(void *data)
 	dstr_copy(&stream->path, path);
 	obs_data_release(settings);
 
-	stream->file = os_fopen(stream->path.array, "wb");
+	stream->file = file_writer_open(stream->path.array, NULL);
 	if (!stream->file) {
 		warn("Unable to open FLV file '%s'", stream->path.array);
 		return false;
@@ -0,0 +1,570 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <obs.h>
+#include <obs-avc.h>
+#include <util/array-serializer.h>
+#include "mp4-mux.h"
+
+#define TRUN_DATA_OFFSET      0x000001
+#define TRUN_SAMPLE_DURATION  0x000100
+#define TRUN_SAMPLE_SIZE      0x000200
+#define TRUN_SAMPLE_FLAGS     0x000400
+#define TRUN_SAMPLE_CTS       0x000800
+
+#define TFHD_DEFAULT_BASE_IS_MOOF 0x020000
+
+#define SAMPLE_FLAGS_SYNC     0x02000000
+#define SAMPLE_FLAGS_NON_SYNC 0x01010000
+
+/* ------------------------------------------------------------------------- */
+/* box helpers */
+
+static inline size_t box_start(struct serializer *s, const char *type)
+{
+	size_t pos = (size_t)serializer_get_pos(s);
+	s_wb32(s, 0);
+	s_write(s, type, 4);
+	return pos;
+}
+
+static inline size_t full_box_start(struct serializer *s, const char *type,
+		uint8_t version, uint32_t flags)
+{
+	size_t pos = box_start(s, type);
+	s_w8(s, version);
+	s_wb24(s, flags);
+	return pos;
+}
+
+static inline void patch_wb32(struct serializer *s, size_t pos, uint32_t val)
+{
+	struct array_output_data *output = s->data;
+	uint8_t *p = output->bytes.array + pos;
+
+	p[0] = (uint8_t)(val >> 24);
+	p[1] = (uint8_t)(val >> 16);
+	p[2] = (uint8_t)(val >> 8);
+	p[3] = (uint8_t)val;
+}
+
+static inline void box_end(struct serializer *s, size_t pos)
+{
+	size_t end = (size_t)serializer_get_pos(s);
+	patch_wb32(s, pos, (uint32_t)(end - pos));
+}
+
+static inline void s_zero(struct serializer *s, size_t count)
+{
+	for (size_t i = 0; i < count; i++)
+		s_w8(s, 0);
+}
+
+static void s_matrix(struct serializer *s)
+{
+	static const uint32_t matrix[9] = {
+		0x00010000, 0, 0,
+		0, 0x00010000, 0,
+		0, 0, 0x40000000
+	};
+
+	for (size_t i = 0; i < 9; i++)
+		s_wb32(s, matrix[i]);
+}
+
+/* ------------------------------------------------------------------------- */
+/* tracks */
+
+void mp4_track_add_packet(struct mp4_track *track,
+		struct encoder_packet *packet)
+{
+	struct encoder_packet out;
+
+	if (!track->timescale) {
+		track->timescale = (uint32_t)packet->timebase_den;
+		track->ts_mul    = (uint32_t)packet->timebase_num;
+	}
+
+	if (packet->type == OBS_ENCODER_VIDEO)
+		obs_parse_avc_packet(&out, packet);
+	else
+		obs_duplicate_encoder_packet(&out, packet);
+
+	da_push_back(track->packets, &out);
+}
+
+void mp4_track_free(struct mp4_track *track)
+{
+	for (size_t i = 0; i < track->packets.num; i++)
+		obs_free_encoder_packet(track->packets.array+i);
+	da_free(track->packets);
+}
+
+int64_t mp4_track_start_usec(const struct mp4_track *track)
+{
+	const struct encoder_packet *first;
+
+	if (!track->packets.num)
+		return 0;
+
+	first = track->packets.array;
+	return first->dts * 1000000 * first->timebase_num /
+		first->timebase_den;
+}
+
+static inline int64_t track_ts(const struct mp4_track *track, int64_t ts)
+{
+	return ts * track->ts_mul;
+}
+
+/* ------------------------------------------------------------------------- */
+/* initialization segment */
+
+static void write_ftyp(struct serializer *s)
+{
+	size_t box = box_start(s, "ftyp");
+	s_write(s, "iso6", 4);
+	s_wb32(s, 1);
+	s_write(s, "iso6", 4);
+	s_write(s, "cmfc", 4);
+	s_write(s, "avc1", 4);
+	s_write(s, "mp41", 4);
+	box_end(s, box);
+}
+
+static void write_mvhd(struct serializer *s, uint32_t next_track_id)
+{
+	size_t box = full_box_start(s, "mvhd", 0, 0);
+	s_wb32(s, 0);          /* creation time */
+	s_wb32(s, 0);          /* modification time */
+	s_wb32(s, 1000);       /* timescale */
+	s_wb32(s, 0);          /* duration, unknown for fragmented files */
+	s_wb32(s, 0x00010000); /* rate */
+	s_wb16(s, 0x0100);     /* volume */
+	s_zero(s, 10);
+	s_matrix(s);
+	s_zero(s, 24);
+	s_wb32(s, next_track_id);
+	box_end(s, box);
+}
+
+static void write_tkhd(struct serializer *s, struct mp4_track *track,
+		uint32_t width, uint32_t height)
+{
+	bool audio = track->type == OBS_ENCODER_AUDIO;
+
+	/* audio tracks are alternatives of each other, only the first one is
+	 * enabled by default */
+	bool enabled = !audio || track->mix_idx == 0;
+	size_t box = full_box_start(s, "tkhd", 0, enabled ? 0x3 : 0x2);
+
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	s_wb32(s, track->id);
+	s_wb32(s, 0);
+	s_wb32(s, 0);          /* duration */
+	s_zero(s, 8);
+	s_wb16(s, 0);          /* layer */
+	s_wb16(s, audio ? 1 : 0); /* alternate group */
+	s_wb16(s, audio ? 0x0100 : 0);
+	s_wb16(s, 0);
+	s_matrix(s);
+	s_wb32(s, width << 16);
+	s_wb32(s, height << 16);
+	box_end(s, box);
+}
+
+static void write_mdhd(struct serializer *s, struct mp4_track *track)
+{
+	size_t box = full_box_start(s, "mdhd", 0, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	s_wb32(s, track->timescale);
+	s_wb32(s, 0);
+	s_wb16(s, 0x55c4);     /* 'und' */
+	s_wb16(s, 0);
+	box_end(s, box);
+}
+
+static void write_hdlr(struct serializer *s, struct mp4_track *track)
+{
+	bool audio = track->type == OBS_ENCODER_AUDIO;
+	const char *name = audio ? "SoundHandler" : "VideoHandler";
+	size_t box = full_box_start(s, "hdlr", 0, 0);
+
+	s_wb32(s, 0);
+	s_write(s, audio ? "soun" : "vide", 4);
+	s_zero(s, 12);
+	s_write(s, name, strlen(name) + 1);
+	box_end(s, box);
+}
+
+static void write_dinf(struct serializer *s)
+{
+	size_t dinf = box_start(s, "dinf");
+	size_t dref = full_box_start(s, "dref", 0, 0);
+	size_t url;
+
+	s_wb32(s, 1);
+	url = full_box_start(s, "url ", 0, 1);
+	box_end(s, url);
+	box_end(s, dref);
+	box_end(s, dinf);
+}
+
+static void write_avc1(struct serializer *s, obs_encoder_t *vencoder)
+{
+	uint8_t *extra_data;
+	uint8_t *header;
+	size_t  extra_size;
+	size_t  header_size;
+	size_t  box = box_start(s, "avc1");
+	size_t  avcc;
+
+	s_zero(s, 6);
+	s_wb16(s, 1);          /* data reference index */
+	s_zero(s, 16);
+	s_wb16(s, (uint16_t)obs_encoder_get_width(vencoder));
+	s_wb16(s, (uint16_t)obs_encoder_get_height(vencoder));
+	s_wb32(s, 0x00480000); /* 72 dpi */
+	s_wb32(s, 0x00480000);
+	s_wb32(s, 0);
+	s_wb16(s, 1);          /* frame count */
+	s_zero(s, 32);         /* compressor name */
+	s_wb16(s, 0x0018);     /* depth */
+	s_wb16(s, 0xffff);
+
+	obs_encoder_get_extra_data(vencoder, &extra_data, &extra_size);
+	header_size = obs_parse_avc_header(&header, extra_data, extra_size);
+
+	avcc = box_start(s, "avcC");
+	s_write(s, header, header_size);
+	box_end(s, avcc);
+	bfree(header);
+
+	box_end(s, box);
+}
+
+static inline void s_descriptor(struct serializer *s, uint8_t tag,
+		uint32_t size)
+{
+	s_w8(s, tag);
+	s_w8(s, 0x80 | ((size >> 21) & 0x7F));
+	s_w8(s, 0x80 | ((size >> 14) & 0x7F));
+	s_w8(s, 0x80 | ((size >> 7)  & 0x7F));
+	s_w8(s, size & 0x7F);
+}
+
+static void write_esds(struct serializer *s, obs_encoder_t *aencoder)
+{
+	obs_data_t *settings = obs_encoder_get_settings(aencoder);
+	uint32_t   bitrate = (uint32_t)obs_data_get_int(settings, "bitrate");
+	uint8_t    *asc;
+	size_t     asc_size = 0;
+	size_t     box;
+
+	obs_data_release(settings);
+	obs_encoder_get_extra_data(aencoder, &asc, &asc_size);
+	bitrate *= 1000;
+
+	box = full_box_start(s, "esds", 0, 0);
+
+	s_descriptor(s, 0x03, (uint32_t)(3 + 5 + 13 + 5 + asc_size + 5 + 1));
+	s_wb16(s, 0);          /* ES ID */
+	s_w8(s, 0);
+
+	s_descriptor(s, 0x04, (uint32_t)(13 + 5 + asc_size));
+	s_w8(s, 0x40);         /* AAC */
+	s_w8(s, 0x15);         /* audio stream */
+	s_wb24(s, 0);
+	s_wb32(s, bitrate);
+	s_wb32(s, bitrate);
+
+	s_descriptor(s, 0x05, (uint32_t)asc_size);
+	s_write(s, asc, asc_size);
+
+	s_descriptor(s, 0x06, 1);
+	s_w8(s, 0x02);
+
+	box_end(s, box);
+}
+
+static void write_mp4a(struct serializer *s, obs_encoder_t *aencoder,
+		struct mp4_track *track)
+{
+	audio_t *audio = obs_encoder_audio(aencoder);
+	size_t  box = box_start(s, "mp4a");
+
+	s_zero(s, 6);
+	s_wb16(s, 1);
+	s_zero(s, 8);
+	s_wb16(s, (uint16_t)audio_output_get_channels(audio));
+	s_wb16(s, 16);
+	s_wb16(s, 0);
+	s_wb16(s, 0);
+	s_wb32(s, track->timescale << 16);
+	write_esds(s, aencoder);
+	box_end(s, box);
+}
+
+static void write_empty_table(struct serializer *s, const char *type)
+{
+	size_t box = full_box_start(s, type, 0, 0);
+	s_wb32(s, 0);
+	box_end(s, box);
+}
+
+static void write_stbl(struct serializer *s, obs_output_t *context,
+		struct mp4_track *track)
+{
+	size_t stbl = box_start(s, "stbl");
+	size_t stsd = full_box_start(s, "stsd", 0, 0);
+	size_t stsz;
+
+	s_wb32(s, 1);
+	if (track->type == OBS_ENCODER_VIDEO)
+		write_avc1(s, obs_output_get_video_encoder(context));
+	else
+		write_mp4a(s, obs_output_get_audio_encoder(context,
+					track->mix_idx), track);
+	box_end(s, stsd);
+
+	write_empty_table(s, "stts");
+	write_empty_table(s, "stsc");
+
+	stsz = full_box_start(s, "stsz", 0, 0);
+	s_wb32(s, 0);
+	s_wb32(s, 0);
+	box_end(s, stsz);
+
+	write_empty_table(s, "stco");
+	box_end(s, stbl);
+}
+
+static void write_minf(struct serializer *s, obs_output_t *context,
+		struct mp4_track *track)
+{
+	size_t minf = box_start(s, "minf");
+	size_t header;
+
+	if (track->type == OBS_ENCODER_VIDEO) {
+		header = full_box_start(s, "vmhd", 0, 1);
+		s_zero(s, 8);
+	} else {
+		header = full_box_start(s, "smhd", 0, 0);
+		s_zero(s, 4);
+	}
+	box_end(s, header);
+
+	write_dinf(s);
+	write_stbl(s, context, track);
+	box_end(s, minf);
+}
+
+static void write_trak(struct serializer *s, obs_output_t *context,
+		struct mp4_track *track)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(context);
+	bool   video = track->type == OBS_ENCODER_VIDEO;
+	size_t trak = box_start(s, "trak");
+	size_t mdia;
+
+	write_tkhd(s, track,
+			video ? obs_encoder_get_width(vencoder) : 0,
+			video ? obs_encoder_get_height(vencoder) : 0);
+
+	mdia = box_start(s, "mdia");
+	write_mdhd(s, track);
+	write_hdlr(s, track);
+	write_minf(s, context, track);
+	box_end(s, mdia);
+
+	box_end(s, trak);
+}
+
+static void write_mvex(struct serializer *s, struct mp4_track *tracks,
+		size_t num_tracks)
+{
+	size_t mvex = box_start(s, "mvex");
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		size_t trex = full_box_start(s, "trex", 0, 0);
+		s_wb32(s, tracks[i].id);
+		s_wb32(s, 1);
+		s_wb32(s, 0);
+		s_wb32(s, 0);
+		s_wb32(s, 0);
+		box_end(s, trex);
+	}
+
+	box_end(s, mvex);
+}
+
+bool mp4_init_segment(obs_output_t *context, struct mp4_track *tracks,
+		size_t num_tracks, uint8_t **output, size_t *size)
+{
+	struct array_output_data data;
+	struct serializer s;
+	size_t moov;
+
+	for (size_t i = 0; i < num_tracks; i++)
+		if (!tracks[i].timescale)
+			return false;
+
+	array_output_serializer_init(&s, &data);
+
+	write_ftyp(&s);
+
+	moov = box_start(&s, "moov");
+	write_mvhd(&s, (uint32_t)num_tracks + 1);
+	for (size_t i = 0; i < num_tracks; i++)
+		write_trak(&s, context, tracks + i);
+	write_mvex(&s, tracks, num_tracks);
+	box_end(&s, moov);
+
+	*output = data.bytes.array;
+	*size   = data.bytes.num;
+	return true;
+}
+
+/* ------------------------------------------------------------------------- */
+/* fragments */
+
+static int64_t sample_duration(struct mp4_track *track, size_t idx,
+		int64_t next_dts)
+{
+	struct encoder_packet *packets = track->packets.array;
+	int64_t duration;
+
+	if (idx + 1 < track->packets.num)
+		duration = packets[idx + 1].dts - packets[idx].dts;
+	else if (next_dts >= 0)
+		duration = next_dts - packets[idx].dts;
+	else
+		return track->last_duration;
+
+	duration = track_ts(track, duration);
+	track->last_duration = duration;
+	return duration;
+}
+
+/* returns the position of the trun data offset field so it can be patched
+ * once the size of the moof is known */
+static size_t write_traf(struct serializer *s, struct mp4_track *track,
+		int64_t next_dts)
+{
+	struct encoder_packet *packets = track->packets.array;
+	size_t traf = box_start(s, "traf");
+	size_t box;
+	size_t data_offset_pos;
+
+	box = full_box_start(s, "tfhd", 0, TFHD_DEFAULT_BASE_IS_MOOF);
+	s_wb32(s, track->id);
+	box_end(s, box);
+
+	box = full_box_start(s, "tfdt", 1, 0);
+	s_wb64(s, (uint64_t)track_ts(track, packets[0].dts));
+	box_end(s, box);
+
+	box = full_box_start(s, "trun", 1, TRUN_DATA_OFFSET |
+			TRUN_SAMPLE_DURATION | TRUN_SAMPLE_SIZE |
+			TRUN_SAMPLE_FLAGS | TRUN_SAMPLE_CTS);
+	s_wb32(s, (uint32_t)track->packets.num);
+
+	data_offset_pos = (size_t)serializer_get_pos(s);
+	s_wb32(s, 0);
+
+	for (size_t i = 0; i < track->packets.num; i++) {
+		struct encoder_packet *packet = packets + i;
+		bool sync = packet->type == OBS_ENCODER_AUDIO ||
+			packet->keyframe;
+
+		s_wb32(s, (uint32_t)sample_duration(track, i, next_dts));
+		s_wb32(s, (uint32_t)packet->size);
+		s_wb32(s, sync ? SAMPLE_FLAGS_SYNC : SAMPLE_FLAGS_NON_SYNC);
+		s_wb32(s, (uint32_t)(int32_t)track_ts(track,
+					packet->pts - packet->dts));
+	}
+
+	box_end(s, box);
+	box_end(s, traf);
+	return data_offset_pos;
+}
+
+static inline size_t track_data_size(const struct mp4_track *track)
+{
+	size_t size = 0;
+	for (size_t i = 0; i < track->packets.num; i++)
+		size += track->packets.array[i].size;
+	return size;
+}
+
+void mp4_fragment(uint32_t sequence, struct mp4_track *tracks,
+		size_t num_tracks, const int64_t *next_dts,
+		uint8_t **output, size_t *size)
+{
+	struct array_output_data data;
+	struct serializer s;
+	size_t data_offset_pos[MAX_AUDIO_MIXES + 1];
+	size_t moof, mfhd, mdat;
+	size_t moof_size;
+	size_t offset;
+
+	array_output_serializer_init(&s, &data);
+
+	moof = box_start(&s, "moof");
+
+	mfhd = full_box_start(&s, "mfhd", 0, 0);
+	s_wb32(&s, sequence);
+	box_end(&s, mfhd);
+
+	for (size_t i = 0; i < num_tracks; i++) {
+		if (tracks[i].packets.num)
+			data_offset_pos[i] = write_traf(&s, tracks + i,
+					next_dts[i]);
+	}
+
+	box_end(&s, moof);
+	moof_size = (size_t)serializer_get_pos(&s) - moof;
+
+	/* sample data offsets are relative to the start of the moof */
+	offset = moof_size + 8;
+	for (size_t i = 0; i < num_tracks; i++) {
+		if (!tracks[i].packets.num)
+			continue;
+
+		patch_wb32(&s, data_offset_pos[i], (uint32_t)offset);
+		offset += track_data_size(tracks + i);
+	}
+
+	mdat = box_start(&s, "mdat");
+	for (size_t i = 0; i < num_tracks; i++) {
+		struct mp4_track *track = tracks + i;
+
+		for (size_t j = 0; j < track->packets.num; j++) {
+			struct encoder_packet *packet = track->packets.array+j;
+			s_write(&s, packet->data, packet->size);
+			obs_free_encoder_packet(packet);
+		}
+
+		da_resize(track->packets, 0);
+	}
+	box_end(&s, mdat);
+
+	*output = data.bytes.array;
+	*size   = data.bytes.num;
+}
@@ -0,0 +1,63 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#pragma once
+
+#include <obs.h>
+#include <util/darray.h>
+
+/* fragmented MP4 (ISO BMFF) muxing, hard-coded to h264 and aac just like the
+ * FLV muxer */
+
+struct mp4_track {
+	uint32_t                      id;
+	enum obs_encoder_type         type;
+
+	/* index of the output's audio encoder that feeds an audio track */
+	size_t                        mix_idx;
+
+	/* taken from the first packet: timestamps in the track's timescale
+	 * are the packet's timestamps multiplied by ts_mul */
+	uint32_t                      timescale;
+	uint32_t                      ts_mul;
+
+	int64_t                       last_duration;
+
+	/* samples of the fragment being built, video samples already
+	 * converted to length-prefixed NAL units */
+	DARRAY(struct encoder_packet) packets;
+};
+
+extern void mp4_track_add_packet(struct mp4_track *track,
+		struct encoder_packet *packet);
+extern void mp4_track_free(struct mp4_track *track);
+
+/** Returns the decode time of the first pending sample in microseconds */
+extern int64_t mp4_track_start_usec(const struct mp4_track *track);
+
+/** Writes the initialization segment (ftyp + moov) */
+extern bool mp4_init_segment(obs_output_t *context, struct mp4_track *tracks,
+		size_t num_tracks, uint8_t **output, size_t *size);
+
+/**
+ * Writes a moof + mdat fragment containing the pending samples of all tracks
+ * and clears them.  next_dts holds, for each track, the timestamp of the
+ * packet that follows the fragment (in packet timebase), or -1 if unknown.
+ */
+extern void mp4_fragment(uint32_t sequence, struct mp4_track *tracks,
+		size_t num_tracks, const int64_t *next_dts,
+		uint8_t **output, size_t *size);
@@ -0,0 +1,517 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <obs-module.h>
+#include <util/platform.h>
+#include <util/dstr.h>
+#include <util/darray.h>
+#include <util/threading.h>
+#include <util/file-writer.h>
+#include "mp4-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[mp4 output: '%s'] " format, \
+			obs_output_get_name(mp4->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* the video track comes first, followed by one track per audio encoder */
+#define TRACK_VIDEO 0
+#define MAX_TRACKS  (MAX_AUDIO_MIXES + 1)
+
+/* segment files are written (and the playlist rewritten) on a separate
+ * thread so the encoder callbacks never wait on the disk */
+struct segment_job {
+	struct dstr           path;
+	uint8_t               *data;
+	size_t                size;
+	double                duration;
+	bool                  end;
+};
+
+struct mp4_output {
+	obs_output_t          *output;
+	struct dstr           path;
+	bool                  segmented;
+	int64_t               fragment_usec;
+
+	struct mp4_track      tracks[MAX_TRACKS];
+	size_t                num_tracks;
+	uint32_t              sequence;
+	bool                  keyframe_received;
+	bool                  sent_init;
+
+	file_writer_t         *file;
+
+	pthread_t             segment_thread;
+	bool                  segment_thread_active;
+	pthread_mutex_t       segment_mutex;
+	os_sem_t              *segment_sem;
+	DARRAY(struct segment_job) segment_jobs;
+
+	bool                  active;
+};
+
+static const char *mp4_output_getname(void)
+{
+	return obs_module_text("MP4Output");
+}
+
+/* ------------------------------------------------------------------------- */
+/* segmented output */
+
+static bool write_whole_file(const char *path, const uint8_t *data,
+		size_t size)
+{
+	FILE *file = os_fopen(path, "wb");
+	bool success;
+
+	if (!file)
+		return false;
+
+	success = fwrite(data, 1, size, file) == size;
+	fclose(file);
+	return success;
+}
+
+static void write_playlist(struct mp4_output *mp4, struct dstr *segments,
+		double max_duration, bool end)
+{
+	struct dstr playlist = {0};
+	struct dstr path = {0};
+
+	dstr_printf(&playlist,
+			"#EXTM3U\n"
+			"#EXT-X-VERSION:7\n"
+			"#EXT-X-TARGETDURATION:%d\n"
+			"#EXT-X-MEDIA-SEQUENCE:0\n"
+			"#EXT-X-MAP:URI=\"init.mp4\"\n",
+			(int)(max_duration + 0.999));
+	dstr_cat_dstr(&playlist, segments);
+	if (end)
+		dstr_cat(&playlist, "#EXT-X-ENDLIST\n");
+
+	dstr_printf(&path, "%s/playlist.m3u8", mp4->path.array);
+	if (!os_quick_write_utf8_file(path.array, playlist.array, playlist.len,
+				false))
+		warn("Failed to write playlist '%s'", path.array);
+
+	dstr_free(&path);
+	dstr_free(&playlist);
+}
+
+static void *segment_thread(void *data)
+{
+	struct mp4_output *mp4 = data;
+	struct dstr segments = {0};
+	double max_duration = 0.0;
+	bool end = false;
+
+	os_set_thread_name("mp4 output: segment thread");
+
+	while (!end && os_sem_wait(mp4->segment_sem) == 0) {
+		struct segment_job job;
+
+		pthread_mutex_lock(&mp4->segment_mutex);
+		job = mp4->segment_jobs.array[0];
+		da_erase(mp4->segment_jobs, 0);
+		pthread_mutex_unlock(&mp4->segment_mutex);
+
+		end = job.end;
+
+		if (job.data) {
+			if (!write_whole_file(job.path.array, job.data,
+						job.size))
+				warn("Failed to write segment '%s'",
+						job.path.array);
+
+			if (job.duration > 0.0) {
+				const char *file = strrchr(job.path.array, '/');
+				file = file ? file + 1 : job.path.array;
+
+				dstr_catf(&segments, "#EXTINF:%.3f,\n%s\n",
+						job.duration, file);
+				if (job.duration > max_duration)
+					max_duration = job.duration;
+			}
+		}
+
+		if (job.duration > 0.0 || end)
+			write_playlist(mp4, &segments, max_duration, end);
+
+		dstr_free(&job.path);
+		bfree(job.data);
+	}
+
+	dstr_free(&segments);
+	return NULL;
+}
+
+static void push_segment_job(struct mp4_output *mp4, const char *file,
+		uint8_t *data, size_t size, double duration, bool end)
+{
+	struct segment_job job = {0};
+
+	if (file)
+		dstr_printf(&job.path, "%s/%s", mp4->path.array, file);
+	job.data     = data;
+	job.size     = size;
+	job.duration = duration;
+	job.end      = end;
+
+	pthread_mutex_lock(&mp4->segment_mutex);
+	da_push_back(mp4->segment_jobs, &job);
+	pthread_mutex_unlock(&mp4->segment_mutex);
+
+	os_sem_post(mp4->segment_sem);
+}
+
+static bool start_segment_thread(struct mp4_output *mp4)
+{
+	if (os_mkdir(mp4->path.array) == MKDIR_ERROR) {
+		warn("Unable to create directory '%s'", mp4->path.array);
+		return false;
+	}
+
+	if (os_sem_init(&mp4->segment_sem, 0) != 0)
+		return false;
+
+	if (pthread_create(&mp4->segment_thread, NULL, segment_thread,
+				mp4) != 0) {
+		os_sem_destroy(mp4->segment_sem);
+		mp4->segment_sem = NULL;
+		return false;
+	}
+
+	mp4->segment_thread_active = true;
+	return true;
+}
+
+static void stop_segment_thread(struct mp4_output *mp4)
+{
+	if (!mp4->segment_thread_active)
+		return;
+
+	push_segment_job(mp4, NULL, NULL, 0, 0.0, true);
+	pthread_join(mp4->segment_thread, NULL);
+	mp4->segment_thread_active = false;
+
+	for (size_t i = 0; i < mp4->segment_jobs.num; i++) {
+		dstr_free(&mp4->segment_jobs.array[i].path);
+		bfree(mp4->segment_jobs.array[i].data);
+	}
+	da_resize(mp4->segment_jobs, 0);
+
+	os_sem_destroy(mp4->segment_sem);
+	mp4->segment_sem = NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+/* fragments */
+
+static inline int64_t packet_usec(struct encoder_packet *packet)
+{
+	return packet->dts * 1000000 * packet->timebase_num /
+		packet->timebase_den;
+}
+
+static void write_init_segment(struct mp4_output *mp4)
+{
+	uint8_t *data;
+	size_t  size;
+
+	if (!mp4_init_segment(mp4->output, mp4->tracks, mp4->num_tracks,
+				&data, &size))
+		return;
+
+	if (mp4->segmented) {
+		push_segment_job(mp4, "init.mp4", data, size, 0.0, false);
+	} else {
+		file_writer_write(mp4->file, data, size);
+		bfree(data);
+	}
+
+	mp4->sent_init = true;
+}
+
+static void flush_fragment(struct mp4_output *mp4, int64_t next_video_dts,
+		int64_t next_video_usec)
+{
+	int64_t next_dts[MAX_TRACKS];
+	int64_t start_usec;
+	uint8_t *data;
+	size_t  size;
+
+	if (!mp4->tracks[TRACK_VIDEO].packets.num)
+		return;
+
+	next_dts[TRACK_VIDEO] = next_video_dts;
+	for (size_t i = 1; i < mp4->num_tracks; i++)
+		next_dts[i] = -1;
+
+	/* audio tracks need at least one packet to know their timescale */
+	if (!mp4->sent_init)
+		write_init_segment(mp4);
+	if (!mp4->sent_init)
+		return;
+
+	start_usec = mp4_track_start_usec(&mp4->tracks[TRACK_VIDEO]);
+	mp4_fragment(++mp4->sequence, mp4->tracks, mp4->num_tracks, next_dts,
+			&data, &size);
+
+	if (mp4->segmented) {
+		struct dstr file = {0};
+		double duration = (double)(next_video_usec - start_usec) /
+			1000000.0;
+
+		dstr_printf(&file, "segment_%05u.m4s", mp4->sequence);
+		push_segment_job(mp4, file.array, data, size, duration, false);
+		dstr_free(&file);
+	} else {
+		file_writer_write(mp4->file, data, size);
+		bfree(data);
+	}
+}
+
+static void free_tracks(struct mp4_output *mp4)
+{
+	for (size_t i = 0; i < mp4->num_tracks; i++)
+		mp4_track_free(&mp4->tracks[i]);
+
+	memset(mp4->tracks, 0, sizeof(mp4->tracks));
+	mp4->num_tracks = 0;
+}
+
+static inline void add_track(struct mp4_output *mp4,
+		enum obs_encoder_type type, size_t mix_idx)
+{
+	struct mp4_track *track = &mp4->tracks[mp4->num_tracks++];
+
+	track->id      = (uint32_t)mp4->num_tracks;
+	track->type    = type;
+	track->mix_idx = mix_idx;
+}
+
+/* audio encoders are assigned without gaps, so every audio encoder up to the
+ * first empty slot gets its own track */
+static void init_tracks(struct mp4_output *mp4)
+{
+	free_tracks(mp4);
+	add_track(mp4, OBS_ENCODER_VIDEO, 0);
+
+	for (size_t i = 0; i < MAX_AUDIO_MIXES; i++) {
+		if (!obs_output_get_audio_encoder(mp4->output, i))
+			break;
+		add_track(mp4, OBS_ENCODER_AUDIO, i);
+	}
+}
+
+static struct mp4_track *get_track(struct mp4_output *mp4,
+		struct encoder_packet *packet)
+{
+	if (packet->type == OBS_ENCODER_VIDEO)
+		return &mp4->tracks[TRACK_VIDEO];
+
+	for (size_t i = 1; i < mp4->num_tracks; i++) {
+		if (mp4->tracks[i].mix_idx == packet->track_idx)
+			return &mp4->tracks[i];
+	}
+
+	return NULL;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void mp4_output_update(void *data, obs_data_t *settings)
+{
+	struct mp4_output *mp4 = data;
+
+	dstr_copy(&mp4->path, obs_data_get_string(settings, "path"));
+	mp4->segmented     = obs_data_get_bool(settings, "segmented");
+	mp4->fragment_usec = obs_data_get_int(settings, "fragment_ms") * 1000;
+}
+
+static void *mp4_output_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct mp4_output *mp4 = bzalloc(sizeof(struct mp4_output));
+	mp4->output = output;
+
+	pthread_mutex_init_value(&mp4->segment_mutex);
+	if (pthread_mutex_init(&mp4->segment_mutex, NULL) != 0) {
+		bfree(mp4);
+		return NULL;
+	}
+
+	mp4_output_update(mp4, settings);
+	return mp4;
+}
+
+static void mp4_output_stop(void *data);
+
+static void mp4_output_destroy(void *data)
+{
+	struct mp4_output *mp4 = data;
+
+	if (mp4->active)
+		mp4_output_stop(data);
+
+	free_tracks(mp4);
+	da_free(mp4->segment_jobs);
+	pthread_mutex_destroy(&mp4->segment_mutex);
+	dstr_free(&mp4->path);
+	bfree(mp4);
+}
+
+static bool mp4_output_start(void *data)
+{
+	struct mp4_output *mp4 = data;
+
+	if (!obs_output_can_begin_data_capture(mp4->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(mp4->output, 0))
+		return false;
+
+	if (dstr_is_empty(&mp4->path)) {
+		warn("No path specified");
+		return false;
+	}
+
+	init_tracks(mp4);
+	mp4->sequence          = 0;
+	mp4->keyframe_received = false;
+	mp4->sent_init         = false;
+
+	if (mp4->segmented) {
+		if (!start_segment_thread(mp4))
+			return false;
+	} else {
+		mp4->file = file_writer_open(mp4->path.array, NULL);
+		if (!mp4->file) {
+			warn("Unable to open MP4 file '%s'", mp4->path.array);
+			return false;
+		}
+	}
+
+	mp4->active = true;
+	obs_output_begin_data_capture(mp4->output, 0);
+
+	info("Writing %s '%s'...",
+			mp4->segmented ? "MP4 segments to" : "MP4 file",
+			mp4->path.array);
+	return true;
+}
+
+static void mp4_output_stop(void *data)
+{
+	struct mp4_output *mp4 = data;
+	struct mp4_track *video = &mp4->tracks[TRACK_VIDEO];
+
+	if (!mp4->active)
+		return;
+
+	/* ending data capture first lets the encoders drain their delayed
+	 * packets into the last fragment */
+	obs_output_end_data_capture(mp4->output);
+
+	if (video->packets.num) {
+		struct encoder_packet *last =
+			video->packets.array + video->packets.num - 1;
+		flush_fragment(mp4, -1, packet_usec(last) +
+				(video->last_duration * 1000000 /
+				 (video->timescale ? video->timescale : 1)));
+	}
+
+	if (mp4->segmented) {
+		stop_segment_thread(mp4);
+	} else {
+		file_writer_close(mp4->file);
+		mp4->file = NULL;
+	}
+
+	free_tracks(mp4);
+	mp4->active = false;
+
+	info("MP4 output complete, %u fragments", mp4->sequence);
+}
+
+static void mp4_output_data(void *data, struct encoder_packet *packet)
+{
+	struct mp4_output *mp4 = data;
+	struct mp4_track *track;
+	bool keyframe = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+
+	/* fragments always have to start on a keyframe */
+	if (!mp4->keyframe_received) {
+		if (!keyframe)
+			return;
+		mp4->keyframe_received = true;
+	}
+
+	track = get_track(mp4, packet);
+	if (!track)
+		return;
+
+	if (keyframe) {
+		struct mp4_track *video = &mp4->tracks[TRACK_VIDEO];
+		int64_t usec = packet_usec(packet);
+
+		if (video->packets.num &&
+		    usec - mp4_track_start_usec(video) >= mp4->fragment_usec)
+			flush_fragment(mp4, packet->dts, usec);
+	}
+
+	mp4_track_add_packet(track, packet);
+}
+
+static void mp4_output_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, "fragment_ms", 2000);
+}
+
+static obs_properties_t *mp4_output_properties(void *unused)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_text(props, "path",
+			obs_module_text("MP4Output.FilePath"),
+			OBS_TEXT_DEFAULT);
+	obs_properties_add_bool(props, "segmented",
+			obs_module_text("MP4Output.Segmented"));
+	obs_properties_add_int(props, "fragment_ms",
+			obs_module_text("MP4Output.FragmentDuration"),
+			500, 30000, 100);
+
+	UNUSED_PARAMETER(unused);
+	return props;
+}
+
+struct obs_output_info mp4_output_info = {
+	.id             = "mp4_output",
+	.flags          = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED |
+	                  OBS_OUTPUT_MULTI_TRACK,
+	.get_name       = mp4_output_getname,
+	.create         = mp4_output_create,
+	.destroy        = mp4_output_destroy,
+	.start          = mp4_output_start,
+	.stop           = mp4_output_stop,
+	.encoded_packet = mp4_output_data,
+	.update         = mp4_output_update,
+	.get_defaults   = mp4_output_defaults,
+	.get_properties = mp4_output_properties
+};
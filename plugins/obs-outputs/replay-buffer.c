@@ -0,0 +1,521 @@
+/******************************************************************************
+    Copyright (C) 2014 by Hugh Bailey <obs.jim@gmail.com>
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 2 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+******************************************************************************/
+
+#include <stdio.h>
+#include <time.h>
+#include <obs-module.h>
+#include <obs-avc.h>
+#include <util/platform.h>
+#include <util/circlebuf.h>
+#include <util/dstr.h>
+#include <util/threading.h>
+#include "flv-mux.h"
+
+#define do_log(level, format, ...) \
+	blog(level, "[replay buffer: '%s'] " format, \
+			obs_output_get_name(rb->output), ##__VA_ARGS__)
+
+#define warn(format, ...)  do_log(LOG_WARNING, format, ##__VA_ARGS__)
+#define info(format, ...)  do_log(LOG_INFO,    format, ##__VA_ARGS__)
+
+/* packets are shared between the ring and any save in progress, so a save
+ * never has to copy packet data or hold the lock while writing */
+struct replay_packet {
+	struct encoder_packet packet;
+	volatile long         refs;
+};
+
+struct replay_gop {
+	size_t                num_packets;
+	size_t                size;
+};
+
+struct replay_save {
+	struct replay_buffer  *rb;
+	struct replay_packet  **packets;
+	size_t                num_packets;
+	struct dstr           path;
+};
+
+struct replay_buffer {
+	obs_output_t          *output;
+
+	pthread_mutex_t       mutex;
+	struct circlebuf      packets;   /* struct replay_packet * */
+	struct circlebuf      gops;      /* completed GOPs, oldest first */
+	struct replay_gop     cur_gop;
+	size_t                total_size;
+	int64_t               last_dts_usec;
+	bool                  keyframe_received;
+
+	int64_t               max_time_usec;
+	size_t                max_size;
+	struct dstr           directory;
+
+	bool                  active;
+
+	pthread_t             save_thread;
+	bool                  save_thread_active;
+	volatile bool         saving;
+};
+
+static const char *replay_buffer_getname(void)
+{
+	return obs_module_text("ReplayBuffer");
+}
+
+static inline void replay_packet_release(struct replay_packet *rp)
+{
+	if (os_atomic_dec_long(&rp->refs) == 0) {
+		obs_free_encoder_packet(&rp->packet);
+		bfree(rp);
+	}
+}
+
+static void pop_gop(struct replay_buffer *rb)
+{
+	struct replay_gop gop;
+
+	circlebuf_pop_front(&rb->gops, &gop, sizeof(gop));
+
+	for (size_t i = 0; i < gop.num_packets; i++) {
+		struct replay_packet *rp;
+		circlebuf_pop_front(&rb->packets, &rp, sizeof(rp));
+		replay_packet_release(rp);
+	}
+
+	rb->total_size -= gop.size;
+}
+
+static void free_packets(struct replay_buffer *rb)
+{
+	pthread_mutex_lock(&rb->mutex);
+
+	while (rb->packets.size) {
+		struct replay_packet *rp;
+		circlebuf_pop_front(&rb->packets, &rp, sizeof(rp));
+		replay_packet_release(rp);
+	}
+
+	circlebuf_free(&rb->packets);
+	circlebuf_free(&rb->gops);
+	memset(&rb->cur_gop, 0, sizeof(rb->cur_gop));
+	rb->total_size        = 0;
+	rb->last_dts_usec     = 0;
+	rb->keyframe_received = false;
+
+	pthread_mutex_unlock(&rb->mutex);
+}
+
+static void replay_buffer_update(void *data, obs_data_t *settings)
+{
+	struct replay_buffer *rb = data;
+
+	rb->max_time_usec =
+		obs_data_get_int(settings, "max_time_sec") * 1000000LL;
+	rb->max_size = (size_t)obs_data_get_int(settings, "max_size_mb") *
+		1024 * 1024;
+	dstr_copy(&rb->directory, obs_data_get_string(settings, "directory"));
+}
+
+static void replay_buffer_save_proc(void *data, calldata_t *cd);
+
+static void *replay_buffer_create(obs_data_t *settings, obs_output_t *output)
+{
+	struct replay_buffer *rb = bzalloc(sizeof(struct replay_buffer));
+	proc_handler_t *ph = obs_output_get_proc_handler(output);
+	signal_handler_t *sh = obs_output_get_signal_handler(output);
+
+	rb->output = output;
+	pthread_mutex_init_value(&rb->mutex);
+	if (pthread_mutex_init(&rb->mutex, NULL) != 0) {
+		bfree(rb);
+		return NULL;
+	}
+
+	replay_buffer_update(rb, settings);
+
+	proc_handler_add(ph, "void save()", replay_buffer_save_proc, rb);
+	signal_handler_add(sh, "void saved(ptr output, string path)");
+	return rb;
+}
+
+static void replay_buffer_stop(void *data);
+
+static void replay_buffer_destroy(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (rb->active)
+		replay_buffer_stop(data);
+	if (rb->save_thread_active)
+		pthread_join(rb->save_thread, NULL);
+
+	free_packets(rb);
+	dstr_free(&rb->directory);
+	pthread_mutex_destroy(&rb->mutex);
+	bfree(rb);
+}
+
+static bool replay_buffer_start(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (!obs_output_can_begin_data_capture(rb->output, 0))
+		return false;
+	if (!obs_output_initialize_encoders(rb->output, 0))
+		return false;
+
+	free_packets(rb);
+
+	rb->active = true;
+	obs_output_begin_data_capture(rb->output, 0);
+
+	info("Started, keeping up to %d seconds / %d MB",
+			(int)(rb->max_time_usec / 1000000),
+			(int)(rb->max_size / (1024 * 1024)));
+	return true;
+}
+
+static void replay_buffer_stop(void *data)
+{
+	struct replay_buffer *rb = data;
+
+	if (rb->active) {
+		obs_output_end_data_capture(rb->output);
+		rb->active = false;
+
+		/* any save in progress holds its own references */
+		free_packets(rb);
+		info("Stopped");
+	}
+}
+
+static inline int64_t buffered_time(struct replay_buffer *rb)
+{
+	struct replay_packet *first;
+
+	if (!rb->packets.size)
+		return 0;
+
+	circlebuf_peek_front(&rb->packets, &first, sizeof(first));
+	return rb->last_dts_usec - first->packet.dts_usec;
+}
+
+/* always keeps the GOP currently being received */
+static void evict_gops(struct replay_buffer *rb)
+{
+	while (rb->gops.size) {
+		if (buffered_time(rb) <= rb->max_time_usec &&
+		    rb->total_size <= rb->max_size)
+			break;
+
+		pop_gop(rb);
+	}
+}
+
+static void replay_buffer_data(void *data, struct encoder_packet *packet)
+{
+	struct replay_buffer *rb = data;
+	struct replay_packet *rp;
+	bool new_gop = packet->type == OBS_ENCODER_VIDEO && packet->keyframe;
+
+	/* the buffered window always has to start on a keyframe */
+	if (!rb->keyframe_received && !new_gop)
+		return;
+
+	rp = bmalloc(sizeof(struct replay_packet));
+	obs_duplicate_encoder_packet(&rp->packet, packet);
+	rp->refs = 1;
+
+	pthread_mutex_lock(&rb->mutex);
+
+	if (new_gop) {
+		if (rb->keyframe_received)
+			circlebuf_push_back(&rb->gops, &rb->cur_gop,
+					sizeof(rb->cur_gop));
+
+		memset(&rb->cur_gop, 0, sizeof(rb->cur_gop));
+		rb->keyframe_received = true;
+	}
+
+	circlebuf_push_back(&rb->packets, &rp, sizeof(rp));
+	rb->cur_gop.num_packets++;
+	rb->cur_gop.size += rp->packet.size;
+	rb->total_size   += rp->packet.size;
+
+	if (rp->packet.dts_usec > rb->last_dts_usec)
+		rb->last_dts_usec = rp->packet.dts_usec;
+
+	evict_gops(rb);
+
+	pthread_mutex_unlock(&rb->mutex);
+}
+
+/* ------------------------------------------------------------------------- */
+/* saving */
+
+static void write_flv_packet(FILE *file, struct encoder_packet *packet,
+		bool is_header)
+{
+	uint8_t *data;
+	size_t  size;
+
+	flv_packet_mux(packet, &data, &size, is_header);
+	fwrite(data, 1, size, file);
+	bfree(data);
+}
+
+static void write_flv_headers(struct replay_buffer *rb, FILE *file)
+{
+	obs_encoder_t *vencoder = obs_output_get_video_encoder(rb->output);
+	obs_encoder_t *aencoder = obs_output_get_audio_encoder(rb->output, 0);
+	uint8_t *meta_data;
+	size_t  meta_data_size;
+	uint8_t *header;
+	size_t  size;
+
+	struct encoder_packet audio = {
+		.type         = OBS_ENCODER_AUDIO,
+		.timebase_den = 1
+	};
+	struct encoder_packet video = {
+		.type         = OBS_ENCODER_VIDEO,
+		.timebase_den = 1,
+		.keyframe     = true
+	};
+
+	flv_meta_data(rb->output, &meta_data, &meta_data_size, true, 0);
+	fwrite(meta_data, 1, meta_data_size, file);
+	bfree(meta_data);
+
+	obs_encoder_get_extra_data(aencoder, &audio.data, &audio.size);
+	write_flv_packet(file, &audio, true);
+
+	obs_encoder_get_extra_data(vencoder, &header, &size);
+	video.size = obs_parse_avc_header(&video.data, header, size);
+	write_flv_packet(file, &video, true);
+	bfree(video.data);
+}
+
+/* the saved window starts on this keyframe, audio and video are both timed
+ * from it so they stay in sync */
+static int64_t get_base_dts_usec(struct replay_save *save)
+{
+	for (size_t i = 0; i < save->num_packets; i++) {
+		struct encoder_packet *packet = &save->packets[i]->packet;
+		if (packet->type == OBS_ENCODER_VIDEO && packet->keyframe)
+			return packet->dts_usec;
+	}
+
+	return 0;
+}
+
+static inline int64_t usec_to_packet_ts(const struct encoder_packet *packet,
+		int64_t usec)
+{
+	return usec * packet->timebase_den /
+		((int64_t)packet->timebase_num * 1000000LL);
+}
+
+static bool write_replay(struct replay_save *save)
+{
+	struct replay_buffer *rb = save->rb;
+	int64_t base_usec = get_base_dts_usec(save);
+	int64_t last_ts = 0;
+	FILE    *file;
+
+	file = os_fopen(save->path.array, "wb");
+	if (!file) {
+		warn("Unable to open replay file '%s'", save->path.array);
+		return false;
+	}
+
+	write_flv_headers(rb, file);
+
+	for (size_t i = 0; i < save->num_packets; i++) {
+		struct encoder_packet packet = save->packets[i]->packet;
+		int64_t offset = packet.pts - packet.dts;
+
+		/* start the saved window at timestamp 0 */
+		packet.dts = usec_to_packet_ts(&packet,
+				packet.dts_usec - base_usec);
+		packet.pts = packet.dts + offset;
+		last_ts = get_ms_time(&packet, packet.dts);
+
+		if (packet.type == OBS_ENCODER_VIDEO) {
+			struct encoder_packet parsed;
+			obs_parse_avc_packet(&parsed, &packet);
+			write_flv_packet(file, &parsed, false);
+			obs_free_encoder_packet(&parsed);
+		} else {
+			write_flv_packet(file, &packet, false);
+		}
+	}
+
+	write_file_info(file, last_ts, os_ftelli64(file));
+	fclose(file);
+	return true;
+}
+
+static void signal_saved(struct replay_buffer *rb, const char *path)
+{
+	struct calldata params = {0};
+	calldata_set_ptr(&params, "output", rb->output);
+	calldata_set_string(&params, "path", path);
+	signal_handler_signal(obs_output_get_signal_handler(rb->output),
+			"saved", &params);
+	calldata_free(&params);
+}
+
+static void *save_thread(void *data)
+{
+	struct replay_save *save = data;
+	struct replay_buffer *rb = save->rb;
+
+	os_set_thread_name("replay buffer: save");
+
+	if (write_replay(save)) {
+		info("Saved %d packets to '%s'", (int)save->num_packets,
+				save->path.array);
+		signal_saved(rb, save->path.array);
+	}
+
+	for (size_t i = 0; i < save->num_packets; i++)
+		replay_packet_release(save->packets[i]);
+
+	bfree(save->packets);
+	dstr_free(&save->path);
+	bfree(save);
+
+	rb->saving = false;
+	return NULL;
+}
+
+static void make_replay_path(struct replay_buffer *rb, struct dstr *path)
+{
+	char      name[64];
+	time_t    now = time(NULL);
+	struct tm *cur_time = localtime(&now);
+
+	strftime(name, sizeof(name), "Replay %Y-%m-%d %H-%M-%S.flv",
+			cur_time);
+
+	dstr_copy_dstr(path, &rb->directory);
+	dstr_replace(path, "\\", "/");
+	if (path->len && dstr_end(path) != '/')
+		dstr_cat_ch(path, '/');
+	dstr_cat(path, name);
+}
+
+/* takes a reference to every buffered packet, which is cheap enough to do
+ * under the lock, and writes the file on its own thread */
+static void replay_buffer_save(struct replay_buffer *rb)
+{
+	struct replay_save *save;
+	size_t num;
+
+	if (rb->saving) {
+		warn("A replay is already being saved");
+		return;
+	}
+
+	pthread_mutex_lock(&rb->mutex);
+
+	num = rb->packets.size / sizeof(struct replay_packet*);
+	if (!num) {
+		pthread_mutex_unlock(&rb->mutex);
+		warn("Nothing buffered to save");
+		return;
+	}
+
+	save = bzalloc(sizeof(struct replay_save));
+	save->rb          = rb;
+	save->num_packets = num;
+	save->packets     = bmalloc(num * sizeof(struct replay_packet*));
+
+	circlebuf_peek_front(&rb->packets, save->packets,
+			num * sizeof(struct replay_packet*));
+	for (size_t i = 0; i < num; i++)
+		os_atomic_inc_long(&save->packets[i]->refs);
+
+	pthread_mutex_unlock(&rb->mutex);
+
+	make_replay_path(rb, &save->path);
+
+	if (rb->save_thread_active)
+		pthread_join(rb->save_thread, NULL);
+
+	rb->saving = true;
+	rb->save_thread_active = pthread_create(&rb->save_thread, NULL,
+			save_thread, save) == 0;
+
+	if (!rb->save_thread_active) {
+		warn("Failed to create save thread");
+		rb->saving = false;
+
+		for (size_t i = 0; i < num; i++)
+			replay_packet_release(save->packets[i]);
+		bfree(save->packets);
+		dstr_free(&save->path);
+		bfree(save);
+	}
+}
+
+static void replay_buffer_save_proc(void *data, calldata_t *cd)
+{
+	replay_buffer_save(data);
+	UNUSED_PARAMETER(cd);
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void replay_buffer_defaults(obs_data_t *defaults)
+{
+	obs_data_set_default_int(defaults, "max_time_sec", 20);
+	obs_data_set_default_int(defaults, "max_size_mb",  512);
+}
+
+static obs_properties_t *replay_buffer_properties(void *unused)
+{
+	obs_properties_t *props = obs_properties_create();
+
+	obs_properties_add_path(props, "directory",
+			obs_module_text("ReplayBuffer.Directory"),
+			OBS_PATH_DIRECTORY, NULL, NULL);
+	obs_properties_add_int(props, "max_time_sec",
+			obs_module_text("ReplayBuffer.MaxTime"), 1, 21600, 1);
+	obs_properties_add_int(props, "max_size_mb",
+			obs_module_text("ReplayBuffer.MaxSize"), 1, 65536, 1);
+
+	UNUSED_PARAMETER(unused);
+	return props;
+}
+
+struct obs_output_info replay_buffer_info = {
+	.id             = "replay_buffer",
+	.flags          = OBS_OUTPUT_AV | OBS_OUTPUT_ENCODED,
+	.get_name       = replay_buffer_getname,
+	.create         = replay_buffer_create,
+	.destroy        = replay_buffer_destroy,
+	.start          = replay_buffer_start,
+	.stop           = replay_buffer_stop,
+	.encoded_packet = replay_buffer_data,
+	.update         = replay_buffer_update,
+	.get_defaults   = replay_buffer_defaults,
+	.get_properties = replay_buffer_properties
+};
@@ -143,13 +143,17 @@ static void rtmp_stream_stop(void *data)
 	struct rtmp_stream *stream = data;
 	void *ret;
 
-	os_event_signal(stream->stop_event);
-
-	if (stream->connecting)
+	if (stream->connecting) {
+		os_event_signal(stream->stop_event);
 		pthread_join(stream->connect_thread, &ret);
+	}
 
 	if (stream->active) {
+		/* the send thread stops sending once the stop event is set,
+		 * so end data capture first to let the packets drained out of
+		 * the encoders be queued before it's told to stop */
 		obs_output_end_data_capture(stream->output);
+		os_event_signal(stream->stop_event);
 		os_sem_post(stream->send_sem);
 		pthread_join(stream->send_thread, &ret);
 		RTMP_Close(&stream->rtmp);
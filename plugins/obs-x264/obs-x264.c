@@ -43,7 +43,7 @@ struct obs_x264 {
 	x264_param_t           params;
 	x264_t                 *context;
 
-	DARRAY(uint8_t)        packet_data;
+	DARRAY(struct encoder_packet_nal) nal_list;
 
 	uint8_t                *extra_data;
 	uint8_t                *sei;
@@ -83,7 +83,7 @@ static void obs_x264_destroy(void *data)
 	if (obsx264) {
 		os_end_high_performance(obsx264->performance_token);
 		clear_data(obsx264);
-		da_free(obsx264->packet_data);
+		da_free(obsx264->nal_list);
 		bfree(obsx264);
 	}
 }
@@ -545,22 +545,44 @@ static void *obs_x264_create(obs_data_t *settings, obs_encoder_t *encoder)
 	return obsx264;
 }
 
+static inline size_t get_startcode_size(const uint8_t *payload)
+{
+	return payload[2] == 1 ? 3 : 4;
+}
+
+/* x264 guarantees that the payloads of all output NALs are sequential in
+ * memory, so the packet can point straight into x264's own buffer (valid until
+ * the next encode call) instead of concatenating them into a new one */
 static void parse_packet(struct obs_x264 *obsx264,
 		struct encoder_packet *packet, x264_nal_t *nals,
 		int nal_count, x264_picture_t *pic_out)
 {
+	x264_nal_t *last;
+	uint8_t    *start;
+
 	if (!nal_count) return;
 
-	da_resize(obsx264->packet_data, 0);
+	start = nals[0].p_payload;
+	last  = nals + nal_count - 1;
+
+	da_resize(obsx264->nal_list, 0);
 
 	for (int i = 0; i < nal_count; i++) {
 		x264_nal_t *nal = nals+i;
-		da_push_back_array(obsx264->packet_data, nal->p_payload,
-				nal->i_payload);
+		size_t sc_size = get_startcode_size(nal->p_payload);
+		struct encoder_packet_nal *out =
+			da_push_back_new(obsx264->nal_list);
+
+		out->offset   = (uint32_t)(nal->p_payload - start + sc_size);
+		out->size     = (uint32_t)(nal->i_payload - sc_size);
+		out->type     = nal->i_type;
+		out->priority = nal->i_ref_idc;
 	}
 
-	packet->data          = obsx264->packet_data.array;
-	packet->size          = obsx264->packet_data.num;
+	packet->data          = start;
+	packet->size          = last->p_payload + last->i_payload - start;
+	packet->nals          = obsx264->nal_list.array;
+	packet->num_nals      = obsx264->nal_list.num;
 	packet->type          = OBS_ENCODER_VIDEO;
 	packet->pts           = pic_out->i_pts;
 	packet->dts           = pic_out->i_dts;
@@ -595,9 +617,16 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	int             ret;
 	x264_picture_t  pic, pic_out;
 
-	if (!frame || !packet || !received_packet)
+	if (!packet || !received_packet)
 		return false;
 
+	/* a NULL frame drains the frames still held in the lookahead and
+	 * B-frame queues */
+	if (!frame && x264_encoder_delayed_frames(obsx264->context) <= 0) {
+		*received_packet = false;
+		return true;
+	}
+
 	if (frame)
 		init_pic_data(obsx264, &pic, frame);
 
@@ -614,6 +643,16 @@ static bool obs_x264_encode(void *data, struct encoder_frame *frame,
 	return true;
 }
 
+static int obs_x264_delayed_frames(void *data)
+{
+	struct obs_x264 *obsx264 = data;
+
+	if (!obsx264->context)
+		return 0;
+
+	return x264_encoder_delayed_frames(obsx264->context);
+}
+
 static bool obs_x264_extra_data(void *data, uint8_t **extra_data, size_t *size)
 {
 	struct obs_x264 *obsx264 = data;
@@ -670,5 +709,7 @@ struct obs_encoder_info obs_x264_encoder = {
 	.get_defaults   = obs_x264_defaults,
 	.get_extra_data = obs_x264_extra_data,
 	.get_sei_data   = obs_x264_sei,
-	.get_video_info = obs_x264_video_info
+	.get_video_info = obs_x264_video_info,
+	.caps           = OBS_ENCODER_CAP_DRAIN,
+	.get_delayed_frames = obs_x264_delayed_frames
 };
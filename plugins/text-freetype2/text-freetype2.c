@@ -169,13 +169,17 @@ static void ft2_source_destroy(void *data)
 	obs_enter_graphics();
 
 	if (srcdata->tex != NULL) {
-		gs_texture_destroy(srcdata->tex);
+		gs_texture_pool_release(srcdata->tex);
 		srcdata->tex = NULL;
 	}
 	if (srcdata->vbuf != NULL) {
 		gs_vertexbuffer_destroy(srcdata->vbuf);
 		srcdata->vbuf = NULL;
 	}
+	if (srcdata->outline_vbuf != NULL) {
+		gs_vertexbuffer_destroy(srcdata->outline_vbuf);
+		srcdata->outline_vbuf = NULL;
+	}
 	if (srcdata->draw_effect != NULL) {
 		gs_effect_destroy(srcdata->draw_effect);
 		srcdata->draw_effect = NULL;
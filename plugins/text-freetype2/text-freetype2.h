@@ -55,6 +55,7 @@ struct ft2_source {
 
 	uint32_t *texbuf;
 	gs_vertbuffer_t *vbuf;
+	gs_vertbuffer_t *outline_vbuf;
 
 	gs_effect_t *draw_effect;
 	bool outline_text, drop_shadow;
@@ -31,28 +31,51 @@ extern uint32_t texbuf_w, texbuf_h;
 void draw_outlines(struct ft2_source *srcdata)
 {
 	// Horrible (hopefully temporary) solution for outlines.
-	uint32_t *tmp;
-
 	struct gs_vb_data *vdata = gs_vertexbuffer_get_data(srcdata->vbuf);
+	struct gs_vb_data *odata;
+	struct vec3 offset;
+	uint32_t num_verts;
 
 	if (!srcdata->text)
 		return;
 
-	tmp = vdata->colors;
-	vdata->colors = srcdata->colorbuf;
+	num_verts = (uint32_t)wcslen(srcdata->text) * 6;
 
-	gs_matrix_push();
-	for (int32_t i = 0; i < 8; i++) {
-		gs_matrix_translate3f(offsets[i * 2], offsets[(i * 2) + 1],
-			0.0f);
-		draw_uv_vbuffer(srcdata->vbuf, srcdata->tex,
-			srcdata->draw_effect,
-			(uint32_t)wcslen(srcdata->text) * 6);
+	if (srcdata->outline_vbuf != NULL) {
+		odata = gs_vertexbuffer_get_data(srcdata->outline_vbuf);
+		if (odata->num != num_verts * 8) {
+			gs_vertexbuffer_destroy(srcdata->outline_vbuf);
+			srcdata->outline_vbuf = NULL;
+		}
 	}
-	gs_matrix_identity();
-	gs_matrix_pop();
+	if (srcdata->outline_vbuf == NULL)
+		srcdata->outline_vbuf = create_uv_vbuffer(num_verts * 8, true);
+	if (srcdata->outline_vbuf == NULL)
+		return;
 
-	vdata->colors = tmp;
+	// All eight offset copies go into one buffer and one draw.
+	odata = gs_vertexbuffer_get_data(srcdata->outline_vbuf);
+	vec3_zero(&offset);
+
+	for (uint32_t i = 0; i < 8; i++) {
+		struct vec3 *points = odata->points + i * num_verts;
+		struct vec2 *tvarray =
+			(struct vec2 *)odata->tvarray[0].array + i * num_verts;
+
+		offset.x += offsets[i * 2];
+		offset.y += offsets[(i * 2) + 1];
+
+		for (uint32_t j = 0; j < num_verts; j++)
+			vec3_add(points + j, vdata->points + j, &offset);
+
+		memcpy(tvarray, vdata->tvarray[0].array,
+			sizeof(struct vec2) * num_verts);
+		memcpy(odata->colors + i * num_verts, srcdata->colorbuf,
+			sizeof(uint32_t) * num_verts);
+	}
+
+	draw_uv_vbuffer(srcdata->outline_vbuf, srcdata->tex,
+		srcdata->draw_effect, num_verts * 8);
 }
 
 void draw_drop_shadow(struct ft2_source *srcdata)
@@ -306,11 +329,15 @@ void cache_glyphs(struct ft2_source *srcdata, wchar_t *cache_glyphs)
 			gs_texture_t *tmp_texture = NULL;
 			tmp_texture = srcdata->tex;
 			srcdata->tex = NULL;
-			gs_texture_destroy(tmp_texture);
+			gs_texture_pool_release(tmp_texture);
 		}
 
-		srcdata->tex = gs_texture_create(texbuf_w, texbuf_h,
-			GS_RGBA, 1, (const uint8_t **)&srcdata->texbuf, 0);
+		srcdata->tex = gs_texture_pool_acquire(texbuf_w, texbuf_h,
+			GS_RGBA, GS_DYNAMIC);
+		if (srcdata->tex != NULL)
+			gs_texture_set_image(srcdata->tex,
+				(const uint8_t *)srcdata->texbuf,
+				texbuf_w * 4, false);
 
 		obs_leave_graphics();
 	}